@@ -1,8 +1,13 @@
 #pragma once
 
 #include "ecs_lab/ecs_types.hpp"
+#include "ecs_lab/idx_table.hpp"
 #include "ecs_lab/signature.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <memory_resource>
 #include <new>
@@ -14,164 +19,375 @@ namespace ecs_lab {
 
 class EntityProxy;
 
-struct EntityMeta {
-  explicit EntityMeta(std::pmr::memory_resource* resource)
-      : idx(resource) {}
-  EntityMeta(std::pmr::memory_resource* resource, const EntityMeta& other)
-      : entity_id(other.entity_id),
-        entity_idx(other.entity_idx),
-        gen(other.gen),
-        sig(other.sig),
-        idx(resource) {
-    idx = other.idx;
-  }
-
-  std::uint64_t entity_id = 0;
-  std::uint32_t entity_idx = 0;
-  std::uint32_t gen = 1;
-  Signature<kMaxComponents> sig{};
-  std::pmr::vector<DenseIndex> idx;
-  // Cached pointer to a World-owned proxy object. Not serialized in snapshots.
-  EntityProxy* proxy = nullptr;
+using IdxTable = InlineIdxTable<kIdxInlineSlots>;
+
+// One entity's metadata, as references into LinearArena's per-block columns (see below). A
+// view is as short-lived as a reference into the arena: it dangles once the slot's block is
+// copied or released. EntityMeta converts to ConstEntityMeta.
+template <bool Const>
+struct BasicEntityMeta {
+  template <typename U>
+  using Ref = std::conditional_t<Const, const U&, U&>;
+
+  Ref<std::uint64_t> entity_id;
+  std::uint32_t entity_idx;
+  Ref<std::uint32_t> gen;
+  Ref<Signature<kMaxComponents>> sig;
+  Ref<IdxTable> idx;
+  // Cached pointer to a World-owned proxy object. Snapshots share it with the World;
+  // restore() clears the copies it brings back.
+  Ref<EntityProxy*> proxy;
+
+  operator BasicEntityMeta<true>() const
+    requires(!Const)
+  {
+    return {entity_id, entity_idx, gen, sig, idx, proxy};
+  }
 };
 
+using EntityMeta = BasicEntityMeta<false>;
+using ConstEntityMeta = BasicEntityMeta<true>;
+
+// Block-chunked entity metadata with a free list. Each block stores its slots as parallel
+// columns (gen, signature, idx table, entity_id, proxy), so liveness and signature tests touch
+// dense 4- and 16-byte arrays; at() assembles an EntityMeta view of one slot. Like DenseArray,
+// blocks are reference counted and copy-on-write: copies share blocks, and the first mutable
+// access to a shared block copies it. Each block keeps the memory resource its idx tables
+// allocate from alive, so a block can outlive the arena (or World) that created it.
 class LinearArena {
+  struct Block;
+
 public:
-  explicit LinearArena(std::pmr::memory_resource* resource)
-      : resource_(resource) {}
+  // Owned copy of one slot (delta rows).
+  struct Record {
+    std::uint64_t entity_id = 0;
+    std::uint32_t gen = 1;
+    Signature<kMaxComponents> sig{};
+    IdxTable idx;
+    EntityProxy* proxy = nullptr;
+  };
+
+  // Blocks that differ from a base arena (see diff/patch).
+  struct Delta {
+    // Changed slots of one block, applied on top of the base block.
+    struct Rows {
+      std::size_t block = 0;
+      std::uint32_t count = 0; // constructed slots in the block
+      std::vector<std::uint32_t> offset;
+      std::vector<Record> value;
+    };
+
+    std::uint32_t bump = 0;
+    std::uint32_t free_head = kInvalidIndex;
+    std::size_t block_total = 0;
+    // Blocks carried whole, shared copy-on-write.
+    std::vector<std::size_t> index;
+    std::vector<std::shared_ptr<Block>> blocks;
+    std::vector<Rows> rows;
+    // Backs the idx tables of the records in `rows`.
+    std::shared_ptr<std::pmr::memory_resource> resource;
+  };
+
+  // Bytes of block storage per slot (idx table contents excluded).
+  static constexpr std::size_t kSlotBytes = sizeof(std::uint32_t) + sizeof(Signature<kMaxComponents>) +
+                                            sizeof(IdxTable) + sizeof(std::uint64_t) + sizeof(EntityProxy*);
+
+  explicit LinearArena(std::shared_ptr<std::pmr::memory_resource> resource)
+      : resource_(std::move(resource)) {}
 
   LinearArena(LinearArena&& other) noexcept
       : blocks_(std::move(other.blocks_)),
         bump_(other.bump_),
         free_head_(other.free_head_),
-        resource_(other.resource_) {
+        resource_(std::move(other.resource_)) {
     other.bump_ = 0;
     other.free_head_ = kInvalidIndex;
-    other.resource_ = nullptr;
   }
 
-  LinearArena(const LinearArena& other)
-      : resource_(other.resource_) {
-    copy_from(other);
-  }
-  LinearArena& operator=(const LinearArena& other) {
-    if (this == &other) {
-      return *this;
-    }
-    clear_storage();
-    resource_ = other.resource_;
-    copy_from(other);
-    return *this;
-  }
+  LinearArena(const LinearArena& other) = default;
+  LinearArena& operator=(const LinearArena& other) = default;
 
   LinearArena& operator=(LinearArena&& other) noexcept {
     if (this == &other) {
       return *this;
     }
-    destroy_all();
-    blocks_.clear();
     blocks_ = std::move(other.blocks_);
     bump_ = other.bump_;
     free_head_ = other.free_head_;
-    resource_ = other.resource_;
+    resource_ = std::move(other.resource_);
     other.bump_ = 0;
     other.free_head_ = kInvalidIndex;
-    other.resource_ = nullptr;
     return *this;
   }
 
-  LinearArena clone_with_resource(std::pmr::memory_resource* resource) const {
-    LinearArena out(resource);
-    out.copy_from(*this);
+  // Shares every block with *this (O(blocks)); blocks copied on write allocate from `resource`.
+  LinearArena clone_with_resource(std::shared_ptr<std::pmr::memory_resource> resource) const {
+    LinearArena out(std::move(resource));
+    out.blocks_ = blocks_;
+    out.bump_ = bump_;
+    out.free_head_ = free_head_;
     return out;
   }
 
-  ~LinearArena() {
-    destroy_all();
+  // What changed relative to `base`: entities created, destroyed or whose signature/idx changed.
+  // As in DenseArray::diff, a block still shared with `base` is clean; dirty blocks that kept at
+  // least 3/4 of their slots are carried as changed records, the rest are shared whole.
+  Delta diff(const LinearArena& base) const {
+    Delta out;
+    out.bump = bump_;
+    out.free_head = free_head_;
+    out.block_total = blocks_.size();
+    out.resource = resource_;
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      if (b < base.blocks_.size() && blocks_[b] == base.blocks_[b]) {
+        continue;
+      }
+      if (b < base.blocks_.size() && diff_rows(*blocks_[b], *base.blocks_[b], b, out)) {
+        continue;
+      }
+      out.index.push_back(b);
+      out.blocks.push_back(blocks_[b]);
+    }
+    return out;
+  }
+
+  // Becomes the arena `delta` was taken from: `base` with the delta's blocks and records applied.
+  // Keeps this arena's resource.
+  void patch(const LinearArena& base, const Delta& delta) {
+    blocks_.assign(base.blocks_.begin(),
+                   base.blocks_.begin() + static_cast<std::ptrdiff_t>(std::min(base.blocks_.size(), delta.block_total)));
+    blocks_.resize(delta.block_total);
+    for (std::size_t i = 0; i < delta.index.size(); ++i) {
+      blocks_[delta.index[i]] = delta.blocks[i];
+    }
+    for (const auto& rows : delta.rows) {
+      const Block& from = *base.blocks_[rows.block];
+      auto block = std::make_shared<Block>(resource_);
+      std::size_t next = 0;
+      for (std::uint32_t i = 0; i < rows.count; ++i) {
+        if (next < rows.offset.size() && rows.offset[next] == i) {
+          const Record& r = rows.value[next++];
+          block->construct(i, r.entity_id, r.gen, r.sig, r.idx, r.proxy);
+        } else {
+          block->construct_copy(i, from, i);
+        }
+      }
+      blocks_[rows.block] = std::move(block);
+    }
+    bump_ = delta.bump;
+    free_head_ = delta.free_head;
+  }
+
+  // Bytes of entity metadata held by `delta` beyond what its base holds (idx contents excluded).
+  static std::size_t delta_bytes(const Delta& delta) {
+    std::size_t bytes = delta.blocks.size() * sizeof(Block);
+    for (const auto& rows : delta.rows) {
+      bytes += rows.offset.size() * (sizeof(std::uint32_t) + sizeof(Record));
+    }
+    return bytes;
+  }
+
+  static std::size_t delta_blocks(const Delta& delta) {
+    return delta.blocks.size() + delta.rows.size();
   }
 
   std::uint32_t alloc() {
     if (free_head_ != kInvalidIndex) {
       const std::uint32_t idx = free_head_;
-      auto& meta = *ptr(idx);
-      free_head_ = static_cast<std::uint32_t>(meta.entity_id);
+      free_head_ = static_cast<std::uint32_t>(at(idx).entity_id);
       return idx;
     }
 
     const std::uint32_t idx = bump_;
     ensure_block_for(idx);
-    std::construct_at(ptr(idx), resource_);
+    Block& block = writable_block(idx / kBlockSize);
+    block.construct(idx % kBlockSize, 0, 1, Signature<kMaxComponents>{}, IdxTable{}, nullptr);
     ++bump_;
     return idx;
   }
 
   void free(std::uint32_t idx) {
-    auto& meta = *ptr(idx);
-    meta.entity_id = static_cast<std::uint64_t>(free_head_);
+    at(idx).entity_id = static_cast<std::uint64_t>(free_head_);
     free_head_ = idx;
   }
 
-  EntityMeta& at(std::uint32_t idx) {
-    return *ptr(idx);
+  EntityMeta at(std::uint32_t idx) {
+    return writable_block(idx / kBlockSize).meta(idx);
+  }
+
+  ConstEntityMeta at(std::uint32_t idx) const {
+    return std::as_const(*blocks_[idx / kBlockSize]).meta(idx);
+  }
+
+  // Single columns, for lookups that need only a field or two.
+  std::uint32_t gen(std::uint32_t idx) const {
+    return blocks_[idx / kBlockSize]->gen[idx % kBlockSize];
+  }
+
+  const Signature<kMaxComponents>& sig(std::uint32_t idx) const {
+    return blocks_[idx / kBlockSize]->sig[idx % kBlockSize];
+  }
+
+  std::uint64_t entity_id(std::uint32_t idx) const {
+    return blocks_[idx / kBlockSize]->entity_id[idx % kBlockSize];
   }
 
-  const EntityMeta& at(std::uint32_t idx) const {
-    return *ptr(idx);
+  const IdxTable& idx(std::uint32_t idx) const {
+    return *blocks_[idx / kBlockSize]->idx_slot(idx % kBlockSize);
   }
 
   std::size_t size() const { return bump_; }
 
-private:
-  void clear_storage() {
-    destroy_all();
-    free_head_ = kInvalidIndex;
+  // Bytes of blocks no other arena references (see DenseArray::exclusive_bytes); idx table
+  // contents are not counted.
+  std::size_t exclusive_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& block : blocks_) {
+      bytes += block.use_count() == 1 ? sizeof(Block) : 0;
+    }
+    return bytes;
   }
 
-  void copy_from(const LinearArena& other) {
-    free_head_ = other.free_head_;
-    bump_ = 0;
-    if (other.bump_ > 0) {
-      ensure_block_for(other.bump_ - 1);
+  // Head of the free list (kInvalidIndex if empty).
+  std::uint32_t free_head() const { return free_head_; }
+
+  // Replaces the contents with `bump` slots built block by block from a flat layout (loaders):
+  // fill(meta, i) initializes slot i, free slots included (their entity_id links the free list).
+  template <typename Fill>
+  void rehydrate(std::uint32_t bump, std::uint32_t free_head, Fill&& fill) {
+    blocks_.clear();
+    blocks_.reserve((bump + kBlockSize - 1) / kBlockSize);
+    for (std::uint32_t i = 0; i < bump; ++i) {
+      if (i % kBlockSize == 0) {
+        blocks_.push_back(std::make_shared<Block>(resource_));
+      }
+      Block& block = *blocks_.back();
+      block.construct(i % kBlockSize, 0, 1, Signature<kMaxComponents>{}, IdxTable{}, nullptr);
+      fill(block.meta(i), i);
     }
-    for (std::uint32_t i = 0; i < other.bump_; ++i) {
-      std::construct_at(ptr(i), resource_, *other.ptr(i));
-      ++bump_;
+    bump_ = bump;
+    free_head_ = free_head;
+  }
+
+  // Pre-allocates blocks for `count` more slots beyond the bump pointer (free slots are reused first).
+  void reserve(std::size_t count) {
+    if (count > 0) {
+      ensure_block_for(static_cast<std::uint32_t>(bump_ + count - 1));
     }
   }
 
-  void destroy_all() {
-    for (std::uint32_t i = 0; i < bump_; ++i) {
-      std::destroy_at(ptr(i));
+private:
+  static constexpr std::size_t kBlockSize = 4096;
+
+  struct Block {
+    explicit Block(std::shared_ptr<std::pmr::memory_resource> r)
+        : resource(std::move(r)) {}
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+    ~Block() {
+      for (std::uint32_t i = 0; i < count; ++i) {
+        std::destroy_at(idx_slot(i));
+      }
     }
+
+    IdxTable* idx_slot(std::size_t offset) {
+      return std::launder(reinterpret_cast<IdxTable*>(&idx[offset]));
+    }
+
+    const IdxTable* idx_slot(std::size_t offset) const {
+      return std::launder(reinterpret_cast<const IdxTable*>(&idx[offset]));
+    }
+
+    // Constructs slot `offset`, which must be the next one ([0, count) are constructed).
+    void construct(std::uint32_t offset, std::uint64_t id, std::uint32_t g, const Signature<kMaxComponents>& s,
+                   const IdxTable& table, EntityProxy* p) {
+      assert(offset == count);
+      entity_id[offset] = id;
+      gen[offset] = g;
+      sig[offset] = s;
+      proxy[offset] = p;
+      std::construct_at(idx_slot(offset), table, resource.get());
+      ++count;
+    }
+
+    void construct_copy(std::uint32_t offset, const Block& from, std::uint32_t from_offset) {
+      construct(offset, from.entity_id[from_offset], from.gen[from_offset], from.sig[from_offset],
+                *from.idx_slot(from_offset), from.proxy[from_offset]);
+    }
+
+    EntityMeta meta(std::uint32_t idx) {
+      const std::size_t o = idx % kBlockSize;
+      return {entity_id[o], idx, gen[o], sig[o], *idx_slot(o), proxy[o]};
+    }
+
+    ConstEntityMeta meta(std::uint32_t idx) const {
+      const std::size_t o = idx % kBlockSize;
+      return {entity_id[o], idx, gen[o], sig[o], *idx_slot(o), proxy[o]};
+    }
+
+    // Outlives the idx tables below: they allocate from it.
+    std::shared_ptr<std::pmr::memory_resource> resource;
+    // Constructed slots are always the prefix [0, count).
+    std::uint32_t count = 0;
+    std::uint32_t gen[kBlockSize];
+    Signature<kMaxComponents> sig[kBlockSize];
+    std::aligned_storage_t<sizeof(IdxTable), alignof(IdxTable)> idx[kBlockSize];
+    std::uint64_t entity_id[kBlockSize];
+    EntityProxy* proxy[kBlockSize];
+  };
+
+  static bool same_slot(const Block& a, const Block& b, std::uint32_t i) {
+    return a.entity_id[i] == b.entity_id[i] && a.gen[i] == b.gen[i] && a.sig[i] == b.sig[i] &&
+           *a.idx_slot(i) == *b.idx_slot(i) && a.proxy[i] == b.proxy[i];
   }
 
-  void ensure_block_for(std::uint32_t idx) {
-    const std::size_t block_idx = idx / kBlockSize;
-    while (block_idx >= blocks_.size()) {
-      blocks_.push_back(std::make_unique<Storage[]>(kBlockSize));
+  // Appends the slots of `block` that differ from `base`; false if too many did.
+  bool diff_rows(const Block& block, const Block& base, std::size_t block_idx, Delta& out) const {
+    typename Delta::Rows rows;
+    rows.block = block_idx;
+    rows.count = block.count;
+    const std::size_t limit = kBlockSize / 4;
+    for (std::uint32_t i = 0; i < block.count; ++i) {
+      if (i < base.count && same_slot(block, base, i)) {
+        continue;
+      }
+      if (rows.offset.size() == limit) {
+        return false;
+      }
+      rows.offset.push_back(i);
+      rows.value.push_back(Record{block.entity_id[i], block.gen[i], block.sig[i],
+                                  IdxTable(*block.idx_slot(i), resource_.get()), block.proxy[i]});
+    }
+    if (!rows.offset.empty() || block.count != base.count) {
+      out.rows.push_back(std::move(rows));
     }
+    return true;
   }
 
-  EntityMeta* ptr(std::uint32_t idx) {
-    const std::size_t block_idx = idx / kBlockSize;
-    const std::size_t offset = idx % kBlockSize;
-    Storage* block = blocks_[block_idx].get();
-    return std::launder(reinterpret_cast<EntityMeta*>(&block[offset]));
+  // Returns block `block_idx`, copying it into resource_ first if another arena still references it.
+  Block& writable_block(std::size_t block_idx) {
+    auto& block = blocks_[block_idx];
+    if (block.use_count() > 1) {
+      auto copy = std::make_shared<Block>(resource_);
+      for (std::uint32_t i = 0; i < block->count; ++i) {
+        copy->construct_copy(i, *block, i);
+      }
+      block = std::move(copy);
+    }
+    return *block;
   }
 
-  const EntityMeta* ptr(std::uint32_t idx) const {
+  void ensure_block_for(std::uint32_t idx) {
     const std::size_t block_idx = idx / kBlockSize;
-    const std::size_t offset = idx % kBlockSize;
-    const Storage* block = blocks_[block_idx].get();
-    return std::launder(reinterpret_cast<const EntityMeta*>(&block[offset]));
+    while (block_idx >= blocks_.size()) {
+      blocks_.push_back(std::make_shared<Block>(resource_));
+    }
   }
 
-  using Storage = std::aligned_storage_t<sizeof(EntityMeta), alignof(EntityMeta)>;
-  static constexpr std::size_t kBlockSize = 4096;
-  std::vector<std::unique_ptr<Storage[]>> blocks_;
+  std::vector<std::shared_ptr<Block>> blocks_;
   std::uint32_t bump_ = 0;
   std::uint32_t free_head_ = kInvalidIndex;
-  std::pmr::memory_resource* resource_ = nullptr;
+  std::shared_ptr<std::pmr::memory_resource> resource_;
 };
 
 } // namespace ecs_lab
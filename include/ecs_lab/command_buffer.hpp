@@ -0,0 +1,180 @@
+#pragma once
+
+#include "ecs_lab/component.hpp"
+#include "ecs_lab/ecs_types.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+class World;
+
+// Records structural changes for later replay through World::flush(buffer).
+// Safe to fill while iterating (each/query/par_each/groups) since recording
+// never touches the World. A buffer is not thread-safe: use one per thread.
+//
+// Replay order: create/instantiate (recording order) -> add/remove (stably
+// sorted by component id, so each pool is visited in one run) -> destroy.
+// Per (entity, component) the recorded order is kept; destroy always wins.
+class CommandBuffer {
+public:
+  // entity_id of handles returned by create()/instantiate() until flushed.
+  static constexpr std::uint64_t kPendingId = ~static_cast<std::uint64_t>(0);
+
+  CommandBuffer() = default;
+  CommandBuffer(const CommandBuffer&) = delete;
+  CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+  ~CommandBuffer() {
+    clear();
+  }
+
+  static bool is_pending(Entity e) {
+    return e.entity_id == kPendingId && e.gen == 0;
+  }
+
+  // Returns a placeholder handle usable as target of later commands in this buffer.
+  Entity create() {
+    begin_recording();
+    spawns_.push_back(Spawn{});
+    return pending(spawns_.size() - 1);
+  }
+
+  template <typename... Ts>
+  Entity instantiate(const Prefab<Ts...>& prefab) {
+    begin_recording();
+    Spawn spawn;
+    spawn.payload = make_payload<Prefab<Ts...>>(prefab);
+    spawn.apply = &instantiate_payload<Ts...>;
+    spawn.drop = &drop_payload<Prefab<Ts...>>;
+    spawns_.push_back(spawn);
+    return pending(spawns_.size() - 1);
+  }
+
+  void destroy(Entity e) {
+    begin_recording();
+    destroys_.push_back(e);
+  }
+
+  // The component value is constructed now and moved into the world on flush.
+  template <typename T, typename... Args>
+  void add(Entity e, Args&&... args) {
+    begin_recording();
+    Command cmd;
+    cmd.target = e;
+    cmd.cid = component_id<T>();
+    cmd.payload = make_payload<T>(std::forward<Args>(args)...);
+    cmd.apply = &add_payload<T>;
+    cmd.drop = &drop_payload<T>;
+    commands_.push_back(cmd);
+  }
+
+  template <typename T>
+  void remove(Entity e) {
+    begin_recording();
+    Command cmd;
+    cmd.target = e;
+    cmd.cid = component_id<T>();
+    cmd.apply = &remove_payload<T>;
+    commands_.push_back(cmd);
+  }
+
+  bool empty() const { return spawns_.empty() && commands_.empty() && destroys_.empty(); }
+  std::size_t size() const { return spawns_.size() + commands_.size() + destroys_.size(); }
+
+  // Maps a placeholder from the last flushed batch to the real entity (Entity{} if unknown).
+  Entity resolve(Entity e) const {
+    if (!is_pending(e)) {
+      return e;
+    }
+    return e.entity_idx < resolved_.size() ? resolved_[e.entity_idx] : Entity{};
+  }
+
+  // Drops recorded commands (and the results of the last flush) without applying them.
+  void clear() {
+    discard();
+    resolved_.clear();
+  }
+
+  // Applies every recorded command to `world`; called by World::flush.
+  void replay(World& world);
+
+private:
+  struct Spawn {
+    void* payload = nullptr;
+    Entity (*apply)(World& world, void* payload) = nullptr; // nullptr: plain create()
+    void (*drop)(void* payload) = nullptr;
+  };
+
+  struct Command {
+    Entity target{};
+    ComponentId cid = 0;
+    void* payload = nullptr;
+    void (*apply)(World& world, Entity target, void* payload) = nullptr;
+    void (*drop)(void* payload) = nullptr;
+  };
+
+  static Entity pending(std::size_t spawn_index) {
+    return Entity{kPendingId, static_cast<std::uint32_t>(spawn_index), 0};
+  }
+
+  void begin_recording() {
+    if (!resolved_.empty() && empty()) {
+      resolved_.clear();
+    }
+  }
+
+  template <typename T, typename... Args>
+  void* make_payload(Args&&... args) {
+    void* mem = payload_resource_.allocate(sizeof(T), alignof(T));
+    return ::new (mem) T(std::forward<Args>(args)...);
+  }
+
+  template <typename T>
+  static void drop_payload(void* payload) {
+    std::destroy_at(static_cast<T*>(payload));
+  }
+
+  template <typename T>
+  static void add_payload(World& world, Entity target, void* payload);
+
+  template <typename T>
+  static void remove_payload(World& world, Entity target, void* payload);
+
+  template <typename... Ts>
+  static Entity instantiate_payload(World& world, void* payload);
+
+  // Destroys pending payloads and releases their memory in one go.
+  void discard() {
+    for (auto& spawn : spawns_) {
+      if (spawn.drop) {
+        spawn.drop(spawn.payload);
+      }
+    }
+    for (auto& cmd : commands_) {
+      if (cmd.drop) {
+        cmd.drop(cmd.payload);
+      }
+    }
+    spawns_.clear();
+    commands_.clear();
+    destroys_.clear();
+    payload_resource_.release();
+  }
+
+  std::vector<Spawn> spawns_;
+  std::vector<Command> commands_;
+  std::vector<Entity> destroys_;
+  std::vector<Entity> resolved_;
+  std::pmr::monotonic_buffer_resource payload_resource_{};
+};
+
+} // namespace ecs_lab
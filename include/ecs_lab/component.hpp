@@ -3,6 +3,7 @@
 #include "ecs_lab/ecs_types.hpp"
 
 #include <cassert>
+#include <type_traits>
 #include <utility>
 
 namespace ecs_lab {
@@ -19,10 +20,26 @@ ComponentId component_id() {
   return id;
 }
 
+// Change-tracking policy selector. Specialize to std::true_type to give every row of T the
+// World ticks at which it was added and last changed (add, mutable get, mark_changed and
+// iteration with ecs_lab::stamp_changed stamp them), so Changed<T>/Added<T> query terms can skip
+// rows, and whole pool blocks, that no system touched since a given tick.
+template <typename T>
+struct change_ticks : std::false_type {};
+
+struct RowTicks {
+  Tick added = 0;
+  Tick changed = 0;
+};
+
+struct NoRowTicks {};
+
 template <typename T>
 struct Component {
   std::uint32_t entity_idx = 0;
   std::uint32_t gen = 0;
+  // change_ticks<T> pools only; takes no space otherwise.
+  [[no_unique_address]] std::conditional_t<change_ticks<T>::value, RowTicks, NoRowTicks> ticks;
   T data;
 
   Component() = default;
@@ -1,44 +1,96 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <new>
+#include <span>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 namespace ecs_lab {
 
+// Block-chunked array. Blocks are reference counted and copy-on-write: copying a DenseArray
+// shares every block (O(blocks)), and the first mutable access to a shared block copies it.
+// Const access never copies, so a copy is a cheap read-only snapshot of the original.
+// Blocks of trivially copyable T can also live in external memory (e.g. a mapped file, see
+// adopt_block); those are copied on first write as well.
 template <typename T, std::size_t BlockSize = 4096>
 class DenseArray {
+  struct Block;
+
 public:
+  static constexpr std::size_t kBlockSize = BlockSize;
+
+  // Blocks that differ from a base array (see diff/patch).
+  struct Delta {
+    // Changed rows of one block, applied on top of the base block.
+    struct Rows {
+      std::size_t block = 0;
+      std::size_t count = 0; // constructed elements in the block
+      std::vector<std::uint32_t> offset;
+      std::vector<T> value;
+    };
+
+    std::size_t size = 0;
+    std::size_t block_total = 0;
+    // Blocks carried whole, shared copy-on-write.
+    std::vector<std::size_t> index;
+    std::vector<std::shared_ptr<Block>> blocks;
+    std::vector<Rows> rows;
+  };
+
   DenseArray() = default;
 
-  DenseArray(const DenseArray& other) {
-    reserve_blocks(other.blocks_.size());
-    for (std::size_t i = 0; i < other.size_; ++i) {
-      emplace_back(other[i]);
-    }
-  }
+  DenseArray(const DenseArray& other)
+      : blocks_(other.blocks_), size_(other.size_) {}
 
   DenseArray& operator=(const DenseArray& other) {
     if (this == &other) {
       return *this;
     }
-    clear();
-    reserve_blocks(other.blocks_.size());
-    for (std::size_t i = 0; i < other.size_; ++i) {
-      emplace_back(other[i]);
-    }
+    blocks_ = other.blocks_;
+    size_ = other.size_;
     return *this;
   }
 
-  ~DenseArray() {
-    clear();
+  DenseArray(DenseArray&& other) noexcept
+      : blocks_(std::move(other.blocks_)), size_(other.size_) {
+    other.size_ = 0;
+  }
+
+  DenseArray& operator=(DenseArray&& other) noexcept {
+    if (this == &other) {
+      return *this;
+    }
+    blocks_ = std::move(other.blocks_);
+    size_ = other.size_;
+    other.size_ = 0;
+    return *this;
   }
 
   std::size_t size() const { return size_; }
   bool empty() const { return size_ == 0; }
+  // Number of blocks covering [0, size()); the last one may be partially filled.
+  std::size_t block_count() const { return (size_ + BlockSize - 1) / BlockSize; }
+
+  std::size_t block_rows(std::size_t block_idx) const {
+    return std::min(BlockSize, size_ - block_idx * BlockSize);
+  }
+
+  // Rows [b * kBlockSize, b * kBlockSize + block_rows(b)) as one contiguous span. The mutable
+  // overload copies the block first if it is shared, like operator[].
+  std::span<T> block_span(std::size_t block_idx) {
+    return {slot(writable_block(block_idx), 0), block_rows(block_idx)};
+  }
+
+  std::span<const T> block_span(std::size_t block_idx) const {
+    return {slot(*blocks_[block_idx], 0), block_rows(block_idx)};
+  }
 
   T& operator[](std::size_t idx) {
     return *ptr(idx);
@@ -52,7 +104,9 @@ public:
   std::size_t emplace_back(Args&&... args) {
     const std::size_t idx = size_;
     ensure_capacity(idx);
-    new (ptr(idx)) T(std::forward<Args>(args)...);
+    Block& block = writable_block(idx / BlockSize);
+    new (&block.slots[idx % BlockSize]) T(std::forward<Args>(args)...);
+    ++block.count;
     ++size_;
     return idx;
   }
@@ -62,18 +116,250 @@ public:
       return;
     }
     --size_;
-    ptr(size_)->~T();
+    Block& block = writable_block(size_ / BlockSize);
+    std::destroy_at(slot(block, size_ % BlockSize));
+    --block.count;
   }
 
+  // Drops every element. Shared blocks are released rather than copied.
   void clear() {
-    while (size_ > 0) {
-      pop_back();
+    blocks_.clear();
+    size_ = 0;
+  }
+
+  // Allocates blocks so that the first `count` elements need no further allocation.
+  void reserve(std::size_t count) {
+    const std::size_t blocks = (count + BlockSize - 1) / BlockSize;
+    reserve_blocks(blocks);
+    while (blocks_.size() < blocks) {
+      blocks_.push_back(std::make_shared<Block>());
+    }
+  }
+
+  std::size_t capacity() const { return blocks_.size() * BlockSize; }
+
+  // What changed relative to `base`. A block still shared with `base` has not been written since
+  // (any mutable access would have copied it), so block identity is the dirty bit. Dirty blocks
+  // of trivially copyable T that kept at least 3/4 of their rows are carried as changed rows;
+  // the rest are shared whole.
+  Delta diff(const DenseArray& base) const {
+    Delta out;
+    out.size = size_;
+    out.block_total = blocks_.size();
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      if (b < base.blocks_.size() && blocks_[b] == base.blocks_[b]) {
+        continue;
+      }
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        if (b < base.blocks_.size() && diff_rows(*blocks_[b], *base.blocks_[b], b, out)) {
+          continue;
+        }
+      }
+      out.index.push_back(b);
+      out.blocks.push_back(blocks_[b]);
+    }
+    return out;
+  }
+
+  // Becomes the array `delta` was taken from: `base` with the delta's blocks and rows applied.
+  void patch(const DenseArray& base, const Delta& delta) {
+    blocks_.assign(base.blocks_.begin(),
+                   base.blocks_.begin() + static_cast<std::ptrdiff_t>(std::min(base.blocks_.size(), delta.block_total)));
+    blocks_.resize(delta.block_total);
+    for (std::size_t i = 0; i < delta.index.size(); ++i) {
+      blocks_[delta.index[i]] = delta.blocks[i];
+    }
+    for (const auto& rows : delta.rows) {
+      const Block& from = *base.blocks_[rows.block];
+      auto block = std::make_shared<Block>();
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        // Only trivially copyable blocks are diffed by row.
+        std::memcpy(&block->slots[0], &from.slots[0], std::min(from.count, rows.count) * sizeof(T));
+        for (std::size_t i = 0; i < rows.offset.size(); ++i) {
+          std::memcpy(&block->slots[rows.offset[i]], &rows.value[i], sizeof(T));
+        }
+        block->count = rows.count;
+      }
+      blocks_[rows.block] = std::move(block);
+    }
+    size_ = delta.size;
+  }
+
+  // Bytes of element storage held by `delta` beyond what its base holds.
+  static std::size_t delta_bytes(const Delta& delta) {
+    std::size_t bytes = delta.blocks.size() * sizeof(Block);
+    for (const auto& rows : delta.rows) {
+      bytes += rows.offset.size() * (sizeof(std::uint32_t) + sizeof(T));
+    }
+    return bytes;
+  }
+
+  static std::size_t delta_blocks(const Delta& delta) {
+    return delta.blocks.size() + delta.rows.size();
+  }
+
+  // Raw rows of block `block_idx` (trivially copyable T): block_rows(b) elements starting at the pointer.
+  const T* block_data(std::size_t block_idx) const {
+    static_assert(std::is_trivially_copyable_v<T>, "Raw block access needs trivially copyable elements.");
+    return slot(*blocks_[block_idx], 0);
+  }
+
+  // Appends a fresh block of `count` rows for the caller to fill bytewise (loaders). Requires a
+  // block-aligned size() and trivially copyable T.
+  T* append_block(std::size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "Raw block access needs trivially copyable elements.");
+    assert(size_ % BlockSize == 0 && count <= BlockSize);
+    blocks_.resize(size_ / BlockSize);
+    auto block = std::make_shared<Block>();
+    block->count = count;
+    T* out = slot(*block, 0);
+    blocks_.push_back(std::move(block));
+    size_ += count;
+    return out;
+  }
+
+  // Block images: the in-memory layout of one block, written to files that are later mapped
+  // and adopted without copying. An image is block_image_bytes() long, with the rows starting
+  // at block_image_offset(); it only means something to a build with the same layout.
+  static constexpr std::size_t block_image_bytes() { return sizeof(Block); }
+  static constexpr std::size_t block_image_offset() { return offsetof(Block, slots); }
+  static constexpr std::size_t block_image_align() { return alignof(Block); }
+
+  // Writes the block_image_offset() header bytes of block `block_idx`'s image to `out`.
+  void block_image_header(std::size_t block_idx, void* out) const {
+    static_assert(std::is_trivially_copyable_v<T>, "Raw block access needs trivially copyable elements.");
+    std::memset(out, 0, block_image_offset());
+    const std::size_t count = block_rows(block_idx);
+    const bool external = true;
+    std::memcpy(static_cast<char*>(out) + offsetof(Block, count), &count, sizeof(count));
+    std::memcpy(static_cast<char*>(out) + offsetof(Block, external), &external, sizeof(external));
+  }
+
+  // Rows recorded in a block image header.
+  static std::size_t block_image_rows(const void* image) {
+    std::size_t count = 0;
+    std::memcpy(&count, static_cast<const char*>(image) + offsetof(Block, count), sizeof(count));
+    return count;
+  }
+
+  // Whether a block image header carries the external flag block_image_header writes. Only such
+  // images may be adopted: the flag is what makes the first mutable access copy the block
+  // instead of writing into the (read-only) image.
+  static bool block_image_external(const void* image) {
+    bool external = false;
+    std::memcpy(&external, static_cast<const char*>(image) + offsetof(Block, external), sizeof(external));
+    return external;
+  }
+
+  // Appends the block image at `image` without copying it; `owner` keeps that memory alive and
+  // is released with the last array sharing the block. Requires a block-aligned size(), a
+  // suitably aligned image written by block_image_header, and trivially copyable T. The image
+  // is never written: the first mutable access copies the block.
+  void adopt_block(std::shared_ptr<const void> owner, const void* image) {
+    static_assert(std::is_trivially_copyable_v<T>, "Raw block access needs trivially copyable elements.");
+    assert(size_ % BlockSize == 0 && reinterpret_cast<std::uintptr_t>(image) % alignof(Block) == 0);
+    blocks_.resize(size_ / BlockSize);
+    // Aliasing pointer: shares owner's reference count and never runs ~Block on the image.
+    std::shared_ptr<Block> block(std::move(owner), static_cast<Block*>(const_cast<void*>(image)));
+    assert(block->external && block->count <= BlockSize);
+    size_ += block->count;
+    blocks_.push_back(std::move(block));
+  }
+
+  // True if block `block_idx` is currently shared with another DenseArray (e.g. a snapshot) or
+  // lives in external memory.
+  bool is_shared(std::size_t block_idx) const {
+    return blocks_[block_idx].use_count() > 1 || blocks_[block_idx]->external;
+  }
+
+  // Bytes of blocks no other array references. On a snapshot, these are blocks its source has
+  // since copied or dropped: the memory the snapshot alone keeps alive.
+  std::size_t exclusive_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& block : blocks_) {
+      bytes += block.use_count() == 1 && !block->external ? sizeof(Block) : 0;
+    }
+    return bytes;
+  }
+
+  // Copies every shared block now, so later mutable access does not have to. Call before
+  // handing mutable references to several threads, which would otherwise race on the copy.
+  void unshare() {
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      writable_block(b);
     }
   }
 
 private:
   using Storage = std::aligned_storage_t<sizeof(T), alignof(T)>;
 
+  struct Block {
+    Block() {}
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+    ~Block() {
+      for (std::size_t i = 0; i < count; ++i) {
+        std::destroy_at(slot(*this, i));
+      }
+    }
+
+    // Constructed elements are always the prefix [0, count).
+    std::size_t count = 0;
+    // Set in block images: the rows live in memory this array does not own (see adopt_block).
+    bool external = false;
+    Storage slots[BlockSize];
+  };
+
+  static T* slot(Block& block, std::size_t offset) {
+    return std::launder(reinterpret_cast<T*>(&block.slots[offset]));
+  }
+
+  static const T* slot(const Block& block, std::size_t offset) {
+    return std::launder(reinterpret_cast<const T*>(&block.slots[offset]));
+  }
+
+  // Appends the rows of `block` that differ bytewise from `base`; false if too many did.
+  static bool diff_rows(const Block& block, const Block& base, std::size_t block_idx, Delta& out) {
+    typename Delta::Rows rows;
+    rows.block = block_idx;
+    rows.count = block.count;
+    const std::size_t limit = BlockSize / 4;
+    for (std::size_t i = 0; i < block.count; ++i) {
+      if (i < base.count && std::memcmp(&block.slots[i], &base.slots[i], sizeof(T)) == 0) {
+        continue;
+      }
+      if (rows.offset.size() == limit) {
+        return false;
+      }
+      rows.offset.push_back(static_cast<std::uint32_t>(i));
+      rows.value.push_back(*slot(block, i));
+    }
+    if (!rows.offset.empty() || block.count != base.count) {
+      out.rows.push_back(std::move(rows));
+    }
+    return true;
+  }
+
+  // Returns block `block_idx`, copying it first if another array still references it or it is
+  // an adopted image.
+  Block& writable_block(std::size_t block_idx) {
+    auto& block = blocks_[block_idx];
+    if (block.use_count() > 1 || block->external) {
+      auto copy = std::make_shared<Block>();
+      if constexpr (std::is_trivially_copyable_v<T>) {
+        std::memcpy(&copy->slots[0], &block->slots[0], block->count * sizeof(T));
+        copy->count = block->count;
+      } else {
+        for (std::size_t i = 0; i < block->count; ++i) {
+          new (&copy->slots[i]) T(*slot(*block, i));
+          ++copy->count;
+        }
+      }
+      block = std::move(copy);
+    }
+    return *block;
+  }
+
   void reserve_blocks(std::size_t count) {
     blocks_.reserve(count);
   }
@@ -81,25 +367,19 @@ private:
   void ensure_capacity(std::size_t idx) {
     const std::size_t block_idx = idx / BlockSize;
     if (block_idx >= blocks_.size()) {
-      blocks_.push_back(std::make_unique<Storage[]>(BlockSize));
+      blocks_.push_back(std::make_shared<Block>());
     }
   }
 
   T* ptr(std::size_t idx) {
-    const std::size_t block_idx = idx / BlockSize;
-    const std::size_t offset = idx % BlockSize;
-    Storage* block = blocks_[block_idx].get();
-    return std::launder(reinterpret_cast<T*>(&block[offset]));
+    return slot(writable_block(idx / BlockSize), idx % BlockSize);
   }
 
   const T* ptr(std::size_t idx) const {
-    const std::size_t block_idx = idx / BlockSize;
-    const std::size_t offset = idx % BlockSize;
-    const Storage* block = blocks_[block_idx].get();
-    return std::launder(reinterpret_cast<const T*>(&block[offset]));
+    return slot(*blocks_[idx / BlockSize], idx % BlockSize);
   }
 
-  std::vector<std::unique_ptr<Storage[]>> blocks_;
+  std::vector<std::shared_ptr<Block>> blocks_;
   std::size_t size_ = 0;
 };
 
@@ -1,9 +1,21 @@
 #pragma once
 
 #include "ecs_lab/arena.hpp"
+#include "ecs_lab/command_buffer.hpp"
 #include "ecs_lab/component.hpp"
 #include "ecs_lab/dense_array.hpp"
 #include "ecs_lab/ecs_types.hpp"
+#include "ecs_lab/event_stream.hpp"
+#include "ecs_lab/group.hpp"
+#include "ecs_lab/hierarchy.hpp"
+#include "ecs_lab/idx_table.hpp"
 #include "ecs_lab/pool.hpp"
+#include "ecs_lab/query_filter.hpp"
+#include "ecs_lab/scheduler.hpp"
+#include "ecs_lab/serialize.hpp"
 #include "ecs_lab/signature.hpp"
+#include "ecs_lab/signature_match.hpp"
+#include "ecs_lab/soa_array.hpp"
+#include "ecs_lab/sparse_index.hpp"
+#include "ecs_lab/thread_pool.hpp"
 #include "ecs_lab/world.hpp"
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <type_traits>
@@ -9,8 +10,12 @@ namespace ecs_lab {
 
 using ComponentId = std::uint16_t;
 using DenseIndex = std::uint32_t;
+// World change tick (see World::advance_tick); 0 is older than every stamp.
+using Tick = std::uint32_t;
 
 constexpr ComponentId kMaxComponents = 128;
+// Dense indices an entity's idx table holds inline before spilling to the heap.
+constexpr std::size_t kIdxInlineSlots = 8;
 constexpr std::uint32_t kInvalidIndex = 0xFFFFFFFFu;
 constexpr std::uint32_t kGenAliveBit = 0x80000000u;
 constexpr std::uint32_t kGenMask = 0x7FFFFFFFu;
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "ecs_lab/ecs_types.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+// Value event of World::on_remove_value<T>: the entity (its handle while it still had T) and the
+// component, moved out of the pool just before its row was erased.
+template <typename T>
+struct Removed {
+  Entity entity{};
+  T value{};
+};
+
+// A reader's position in an EventStream. Each consumer owns one; streams never track readers.
+struct EventCursor {
+  // Sequence number of the next event to read.
+  std::uint64_t next = 0;
+  // Events overwritten before this reader got to them (it fell more than capacity() behind).
+  std::uint64_t missed = 0;
+};
+
+// Bounded ring of events with one writer and any number of readers. The writer appends and
+// overwrites the oldest event once the ring is full; readers are const and keep their own
+// EventCursor, so any number of systems can read one stream at the same time without locks or
+// shared counters. Writing must not overlap reading: a push may destroy the event a reader is
+// looking at (the World writes during structural changes, which never overlap iteration).
+// Slots start empty, so E needs no default constructor and an event lives until it is
+// overwritten or the stream is destroyed.
+template <typename E>
+class EventStream {
+public:
+  // `capacity` is rounded up to a power of two; slot memory is allocated once, here.
+  explicit EventStream(std::size_t capacity)
+      : slots_(std::bit_ceil(std::max<std::size_t>(capacity, 1))), mask_(slots_.size() - 1) {}
+
+  void push(E event) {
+    const std::uint64_t seq = head_.load(std::memory_order_relaxed);
+    slots_[seq & mask_].emplace(std::move(event));
+    head_.store(seq + 1, std::memory_order_release);
+  }
+
+  // Calls fn(const E&) for every event the cursor has not seen, oldest first, and returns how
+  // many it delivered. Events already overwritten are skipped and added to cursor.missed.
+  template <typename Fn>
+  std::size_t read(EventCursor& cursor, Fn&& fn) const {
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    const std::uint64_t oldest = head > slots_.size() ? head - slots_.size() : 0;
+    if (cursor.next < oldest) {
+      cursor.missed += oldest - cursor.next;
+      cursor.next = oldest;
+    }
+    const std::uint64_t first = cursor.next;
+    for (; cursor.next < head; ++cursor.next) {
+      fn(*slots_[cursor.next & mask_]);
+    }
+    return static_cast<std::size_t>(head - first);
+  }
+
+  // A cursor that only sees events pushed from now on.
+  EventCursor cursor() const {
+    return EventCursor{head_.load(std::memory_order_acquire), 0};
+  }
+
+  // Events pushed but not yet read through `cursor`, including ones already overwritten.
+  std::uint64_t pending(const EventCursor& cursor) const {
+    return head_.load(std::memory_order_acquire) - cursor.next;
+  }
+
+  // Total events ever pushed (the sequence number of the next one).
+  std::uint64_t head() const {
+    return head_.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const {
+    return slots_.size();
+  }
+
+private:
+  std::vector<std::optional<E>> slots_;
+  std::uint64_t mask_ = 0;
+  std::atomic<std::uint64_t> head_{0};
+};
+
+} // namespace ecs_lab
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "ecs_lab/arena.hpp"
+#include "ecs_lab/pool.hpp"
+#include "ecs_lab/signature.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+class World;
+
+// Type-erased interface the World uses to keep registered groups in sync with structural changes.
+struct IGroup {
+  virtual ~IGroup() = default;
+  // Entity now has every component in `required` (meta.sig already updated).
+  virtual void on_enter(ConstEntityMeta meta) = 0;
+  // Entity is about to lose one of the components in `required`.
+  virtual void on_leave(std::uint32_t entity_idx) = 0;
+  // A component of the entity was moved to a new dense slot (swap-erase).
+  virtual void on_moved(std::uint32_t entity_idx, ComponentId cid, DenseIndex di) = 0;
+  virtual void rebuild(World& world) = 0;
+
+  Signature<kMaxComponents> required{};
+  // Set by restore(); the group ignores hooks and rebuilds itself on next use.
+  bool stale = true;
+};
+
+// Persistent, incrementally maintained set of entities that have all of Ts.
+// Each row caches the owner handle and the DenseIndex of every component, so
+// iteration is a linear walk with no arena access and no signature tests.
+template <typename... Ts>
+class QueryGroup final : public IGroup {
+public:
+  static_assert(sizeof...(Ts) > 0, "QueryGroup needs at least one component type.");
+  static_assert((!Pool<Ts>::kSoa && ...), "Groups hand out T&; SoA components use World::each_block.");
+  static constexpr std::size_t kCount = sizeof...(Ts);
+
+  struct Row {
+    std::uint64_t entity_id = 0;
+    std::uint32_t entity_idx = 0;
+    std::uint32_t gen = 0;
+    std::array<DenseIndex, kCount> di{};
+  };
+
+  explicit QueryGroup(World& world)
+      : world_(&world), cids_{component_id<Ts>()...} {
+    required.clear();
+    (required.set(component_id<Ts>()), ...);
+  }
+
+  std::size_t size() {
+    refresh();
+    return rows_.size();
+  }
+
+  // fn(Entity, Ts&...). Same rules as query: no structural changes of Ts during iteration.
+  template <typename Fn>
+  void each(Fn&& fn) {
+    refresh();
+    each_impl(fn, std::index_sequence_for<Ts...>{});
+  }
+
+  void on_enter(ConstEntityMeta meta) override {
+    if (meta.entity_idx >= slot_.size()) {
+      slot_.resize(static_cast<std::size_t>(meta.entity_idx) + 1, kInvalidIndex);
+    }
+    assert(slot_[meta.entity_idx] == kInvalidIndex);
+    Row row;
+    row.entity_id = meta.entity_id;
+    row.entity_idx = meta.entity_idx;
+    row.gen = meta.gen;
+    for (std::size_t i = 0; i < kCount; ++i) {
+      row.di[i] = meta.idx[meta.sig.rank(cids_[i])];
+    }
+    slot_[meta.entity_idx] = static_cast<std::uint32_t>(rows_.size());
+    rows_.push_back(row);
+  }
+
+  void on_leave(std::uint32_t entity_idx) override {
+    if (entity_idx >= slot_.size() || slot_[entity_idx] == kInvalidIndex) {
+      return;
+    }
+    const std::uint32_t pos = slot_[entity_idx];
+    const std::uint32_t last = static_cast<std::uint32_t>(rows_.size() - 1);
+    if (pos != last) {
+      rows_[pos] = rows_[last];
+      slot_[rows_[pos].entity_idx] = pos;
+    }
+    rows_.pop_back();
+    slot_[entity_idx] = kInvalidIndex;
+  }
+
+  void on_moved(std::uint32_t entity_idx, ComponentId cid, DenseIndex di) override {
+    if (entity_idx >= slot_.size() || slot_[entity_idx] == kInvalidIndex) {
+      return;
+    }
+    auto& row = rows_[slot_[entity_idx]];
+    for (std::size_t i = 0; i < kCount; ++i) {
+      if (cids_[i] == cid) {
+        row.di[i] = di;
+        return;
+      }
+    }
+  }
+
+  void rebuild(World& world) override;
+
+private:
+  void refresh() {
+    if (stale) {
+      rebuild(*world_);
+    }
+  }
+
+  template <typename Fn, std::size_t... I>
+  void each_impl(Fn& fn, std::index_sequence<I...>) {
+    const std::size_t count = rows_.size();
+    for (std::size_t r = 0; r < count; ++r) {
+      const Row& row = rows_[r];
+      Entity e{row.entity_id, row.entity_idx, row.gen};
+      fn(e, std::get<I>(pools_)->items[row.di[I]].data...);
+    }
+  }
+
+  World* world_ = nullptr;
+  std::array<ComponentId, kCount> cids_{};
+  std::tuple<Pool<Ts>*...> pools_{};
+  std::vector<Row> rows_;
+  // entity_idx -> position in rows_ (kInvalidIndex if not a member).
+  std::vector<std::uint32_t> slot_;
+};
+
+// Owning ("packed") group: takes ownership of the pools of Ts and keeps every
+// matching entity in the first size() rows of each pool, in the same order.
+// Row i of every owned pool therefore belongs to the same entity, so iteration
+// is a purely sequential walk over the pools' DenseArrays. Joining or leaving
+// the group costs one swap (plus idx patch) per owned pool.
+template <typename... Ts>
+class PackedGroup final : public IGroup {
+public:
+  static_assert(sizeof...(Ts) > 0, "PackedGroup needs at least one component type.");
+  static_assert((!Pool<Ts>::kStable && ...), "PackedGroup cannot own handle-stable pools.");
+  static_assert((!Pool<Ts>::kSoa && ...), "Groups hand out T&; SoA components use World::each_block.");
+  static constexpr std::size_t kCount = sizeof...(Ts);
+
+  explicit PackedGroup(World& world)
+      : world_(&world), cids_{component_id<Ts>()...} {
+    required.clear();
+    (required.set(component_id<Ts>()), ...);
+  }
+
+  std::size_t size() {
+    refresh();
+    return packed_;
+  }
+
+  // fn(Ts&...) never touches the entity arena; fn(Entity, Ts&...) looks up entity_id per row.
+  // Same rules as query: no structural changes of Ts during iteration.
+  template <typename Fn>
+  void each(Fn&& fn) {
+    refresh();
+    each_impl(fn, std::index_sequence_for<Ts...>{});
+  }
+
+  void on_enter(ConstEntityMeta meta) override;
+  void on_leave(std::uint32_t entity_idx) override;
+  void on_moved(std::uint32_t, ComponentId, DenseIndex) override {}
+  void rebuild(World& world) override;
+
+private:
+  void refresh() {
+    if (stale) {
+      rebuild(*world_);
+    }
+  }
+
+  template <typename Fn, std::size_t... I>
+  void each_impl(Fn& fn, std::index_sequence<I...>);
+
+  World* world_ = nullptr;
+  std::array<ComponentId, kCount> cids_{};
+  std::tuple<Pool<Ts>*...> pools_{};
+  // Rows [0, packed_) of every owned pool are group members, aligned by row.
+  std::size_t packed_ = 0;
+};
+
+} // namespace ecs_lab
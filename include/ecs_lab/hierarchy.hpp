@@ -0,0 +1,147 @@
+#pragma once
+
+#include "ecs_lab/arena.hpp"
+#include "ecs_lab/group.hpp"
+#include "ecs_lab/pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ecs_lab {
+
+class World;
+
+// Compact (entity_idx, gen) handle, as taken by World::try_get_idx_gen and resolve_idx_gen.
+struct EntityLink {
+  std::uint32_t entity_idx = kInvalidIndex;
+  std::uint32_t gen = 0;
+
+  explicit operator bool() const {
+    return entity_idx != kInvalidIndex;
+  }
+};
+
+// An entity's place in a parent/child tree: parent, first-child and next-sibling links (plus a
+// previous-sibling link for O(1) unlinking) and the depth below its root. Maintained by
+// World::set_parent / clear_parent and unlinked by remove / destroy; a Relationship added,
+// instantiated or copied any other way starts out as an unlinked root.
+class Relationship {
+public:
+  EntityLink parent() const {
+    return parent_;
+  }
+
+  EntityLink first_child() const {
+    return first_child_;
+  }
+
+  EntityLink next_sibling() const {
+    return next_sibling_;
+  }
+
+  // 0 for roots.
+  std::uint32_t depth() const {
+    return depth_;
+  }
+
+private:
+  friend class World;
+
+  EntityLink parent_{};
+  EntityLink first_child_{};
+  EntityLink next_sibling_{};
+  EntityLink prev_sibling_{};
+  std::uint32_t depth_ = 0;
+};
+
+// The part of a HierarchyOrder the World calls on reparenting.
+struct IHierarchyOrder : IGroup {
+  // `child` was just attached to `parent` (nullptr: it became a root).
+  virtual void on_reparent(ConstEntityMeta child, const ConstEntityMeta* parent) = 0;
+};
+
+// Depth-ordered storage for one component of a hierarchy: owns the pool of T and keeps the rows
+// of hierarchy members (entities with a Relationship and a T) at its front, parents before
+// children, each with the row of its parent's T. Propagation is then one forward pass over the
+// pool with no handle lookups.
+// Reparenting only patches the cached parent row; if the new parent's row comes after the
+// child's, the next use re-sorts the rows by depth from those cached rows (no arena access).
+// Joining and leaving mark the order stale and the next use rebuilds it from the arena. Either
+// way a frame's changes are paid for once, however many there were.
+template <typename T>
+class HierarchyOrder final : public IHierarchyOrder {
+public:
+  static_assert(!Pool<T>::kStable, "HierarchyOrder cannot own handle-stable pools.");
+  static_assert(!Pool<T>::kSoa, "HierarchyOrder hands out T&; SoA components use World::each_block.");
+
+  explicit HierarchyOrder(World& world);
+
+  std::size_t size() {
+    refresh();
+    return count_;
+  }
+
+  // fn(T& node, const T* parent) or fn(Entity, T& node, const T* parent), parents first. `parent`
+  // is nullptr for roots and for nodes whose parent has no T. Same rules as query: no structural
+  // changes of T or Relationship during iteration.
+  template <typename Fn>
+  void each(Fn&& fn);
+
+  // Whether the next use re-sorts (a reparent put a parent after its child).
+  bool needs_sort() const {
+    return reorder_;
+  }
+
+  void on_enter(ConstEntityMeta) override {
+    stale = true;
+  }
+
+  void on_leave(std::uint32_t) override {
+    stale = true;
+  }
+
+  // Rows past the members only move among themselves (swap-erase of non-members).
+  void on_moved(std::uint32_t, ComponentId cid, DenseIndex di) override {
+    if (cid == cid_ && di < count_) {
+      stale = true;
+    }
+  }
+
+  void on_reparent(ConstEntityMeta child, const ConstEntityMeta* parent) override;
+  void rebuild(World& world) override;
+
+private:
+  void refresh() {
+    if (stale) {
+      rebuild(*world_);
+    } else if (reorder_) {
+      up_.assign(parent_row_.begin(), parent_row_.end());
+      sort_rows(*world_, count_);
+    }
+  }
+
+  // Sorts rows [0, rows) of the pool by depth along up_ (kNotMember rows go last) and rebuilds
+  // parent_row_.
+  void sort_rows(World& world, std::size_t rows);
+
+  static constexpr DenseIndex kNotMember = kInvalidIndex - 1;
+
+  World* world_ = nullptr;
+  ComponentId cid_ = 0;
+  ComponentId rel_cid_ = 0;
+  Pool<T>* pool_ = nullptr;
+  // Rows [0, count_) of the pool are members; parent_row_[r] is the row of the parent's T
+  // (kInvalidIndex if none), < r unless reorder_ is set.
+  std::size_t count_ = 0;
+  std::vector<DenseIndex> parent_row_;
+  bool reorder_ = false;
+  // sort_rows scratch.
+  std::vector<DenseIndex> up_;
+  std::vector<DenseIndex> dest_;
+  std::vector<DenseIndex> walk_;
+  std::vector<std::uint32_t> depth_;
+  std::vector<std::size_t> depth_start_;
+};
+
+} // namespace ecs_lab
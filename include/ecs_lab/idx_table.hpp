@@ -0,0 +1,183 @@
+#pragma once
+
+#include "ecs_lab/ecs_types.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <utility>
+
+namespace ecs_lab {
+
+// An entity's dense indices in signature-rank order (the EntityMeta::idx table). The first N
+// entries live inline, so lookups on entities with up to N components read no memory beyond the
+// arena slot; a larger table spills to a buffer from its memory resource and, like a vector,
+// keeps that buffer when it shrinks again. Covers the subset of std::pmr::vector the World uses.
+template <std::size_t N>
+class InlineIdxTable {
+  static_assert(N >= 2, "the inline slots also hold the spilled buffer pointer");
+
+public:
+  using value_type = DenseIndex;
+  using iterator = DenseIndex*;
+  using const_iterator = const DenseIndex*;
+
+  static constexpr std::size_t kInline = N;
+
+  InlineIdxTable() noexcept : InlineIdxTable(std::pmr::get_default_resource()) {}
+
+  explicit InlineIdxTable(std::pmr::memory_resource* resource) noexcept : resource_(resource) {}
+
+  InlineIdxTable(const InlineIdxTable& other, std::pmr::memory_resource* resource) : resource_(resource) {
+    assign(other);
+  }
+
+  // As for pmr containers, a copy does not inherit the source's resource.
+  InlineIdxTable(const InlineIdxTable& other) : InlineIdxTable(other, std::pmr::get_default_resource()) {}
+
+  InlineIdxTable(InlineIdxTable&& other) noexcept : resource_(other.resource_) {
+    steal(other);
+  }
+
+  InlineIdxTable& operator=(const InlineIdxTable& other) {
+    if (this != &other) {
+      assign(other);
+    }
+    return *this;
+  }
+
+  InlineIdxTable& operator=(InlineIdxTable&& other) noexcept {
+    if (this == &other) {
+      return *this;
+    }
+    if (*resource_ == *other.resource_) {
+      release();
+      steal(other);
+    } else {
+      assign(other);
+    }
+    return *this;
+  }
+
+  ~InlineIdxTable() { release(); }
+
+  DenseIndex* data() { return spilled() ? heap_ : inline_; }
+  const DenseIndex* data() const { return spilled() ? heap_ : inline_; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  std::size_t capacity() const { return capacity_; }
+
+  // Bytes held outside the table (0 while the entries fit inline).
+  std::size_t heap_bytes() const { return spilled() ? capacity_ * sizeof(DenseIndex) : 0; }
+
+  DenseIndex& operator[](std::size_t pos) {
+    assert(pos < size_);
+    return data()[pos];
+  }
+
+  DenseIndex operator[](std::size_t pos) const {
+    assert(pos < size_);
+    return data()[pos];
+  }
+
+  void clear() { size_ = 0; }
+
+  void reserve(std::size_t count) {
+    if (count <= capacity_) {
+      return;
+    }
+    const std::size_t cap = std::max<std::size_t>(count, std::size_t{capacity_} * 2);
+    auto* buf = static_cast<DenseIndex*>(resource_->allocate(cap * sizeof(DenseIndex), alignof(DenseIndex)));
+    std::memcpy(buf, data(), size_ * sizeof(DenseIndex));
+    release();
+    heap_ = buf;
+    capacity_ = static_cast<std::uint32_t>(cap);
+  }
+
+  // New entries are zero.
+  void resize(std::size_t count) {
+    reserve(count);
+    if (count > size_) {
+      std::fill(data() + size_, data() + count, DenseIndex{0});
+    }
+    size_ = static_cast<std::uint32_t>(count);
+  }
+
+  void push_back(DenseIndex value) {
+    reserve(size_ + 1);
+    data()[size_++] = value;
+  }
+
+  iterator insert(const_iterator pos, DenseIndex value) {
+    const std::size_t at = static_cast<std::size_t>(pos - data());
+    assert(at <= size_);
+    reserve(size_ + 1);
+    DenseIndex* p = data();
+    std::memmove(p + at + 1, p + at, (size_ - at) * sizeof(DenseIndex));
+    p[at] = value;
+    ++size_;
+    return p + at;
+  }
+
+  iterator erase(const_iterator pos) {
+    const std::size_t at = static_cast<std::size_t>(pos - data());
+    assert(at < size_);
+    DenseIndex* p = data();
+    std::memmove(p + at, p + at + 1, (size_ - at - 1) * sizeof(DenseIndex));
+    --size_;
+    return p + at;
+  }
+
+  friend bool operator==(const InlineIdxTable& a, const InlineIdxTable& b) {
+    return a.size_ == b.size_ && std::equal(a.begin(), a.end(), b.begin());
+  }
+
+private:
+  bool spilled() const { return capacity_ != N; }
+
+  void assign(const InlineIdxTable& other) {
+    size_ = 0;
+    reserve(other.size_);
+    std::memcpy(data(), other.data(), other.size_ * sizeof(DenseIndex));
+    size_ = other.size_;
+  }
+
+  // Takes other's entries; other must share this table's resource and is left empty inline.
+  void steal(InlineIdxTable& other) noexcept {
+    size_ = other.size_;
+    capacity_ = other.capacity_;
+    if (other.spilled()) {
+      heap_ = other.heap_;
+    } else {
+      std::memcpy(inline_, other.inline_, size_ * sizeof(DenseIndex));
+    }
+    other.size_ = 0;
+    other.capacity_ = N;
+  }
+
+  void release() {
+    if (spilled()) {
+      resource_->deallocate(heap_, capacity_ * sizeof(DenseIndex), alignof(DenseIndex));
+      capacity_ = N;
+    }
+  }
+
+  std::uint32_t size_ = 0;
+  std::uint32_t capacity_ = N; // N while inline
+  union {
+    DenseIndex inline_[N];
+    DenseIndex* heap_;
+  };
+  std::pmr::memory_resource* resource_;
+};
+
+} // namespace ecs_lab
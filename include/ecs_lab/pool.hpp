@@ -2,44 +2,543 @@
 
 #include "ecs_lab/component.hpp"
 #include "ecs_lab/dense_array.hpp"
+#include "ecs_lab/soa_array.hpp"
+#include "ecs_lab/sparse_index.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace ecs_lab {
 
 class World;
+struct IPool;
+
+// Type-erased per-pool part of a World::Delta.
+struct IPoolDelta {
+  virtual ~IPoolDelta() = default;
+  // Rebuilds the pool the delta was taken from out of `base` (nullptr if the base had no such pool).
+  virtual std::unique_ptr<IPool> apply(const IPool* base) const = 0;
+  virtual std::size_t dirty_blocks() const = 0;
+  virtual std::size_t dirty_bytes() const = 0;
+};
 
 struct IPool {
   virtual ~IPool() = default;
   virtual void erase_dense(DenseIndex di, World& world) = 0;
-  virtual DenseIndex clone_dense(std::uint32_t dst_entity_idx, std::uint32_t dst_gen, DenseIndex src_di) = 0;
+  // Erases several distinct rows (any order) with one dispatch.
+  virtual void erase_dense_batch(const DenseIndex* rows, std::size_t count, World& world) = 0;
+  // Copies row src_di for a new owner; change-tracked pools stamp the copy added at `tick`.
+  virtual DenseIndex clone_dense(std::uint32_t dst_entity_idx, std::uint32_t dst_gen, DenseIndex src_di, Tick tick) = 0;
   virtual void* component_ptr(DenseIndex di) = 0;
   virtual std::unique_ptr<IPool> clone() const = 0;
+  // Closes tombstone holes (handle-stable pools only; no-op otherwise).
+  virtual void compact(World& world) = 0;
+  // Copies the blocks still shared with a snapshot (see DenseArray::unshare).
+  virtual void unshare() = 0;
+  // Blocks that changed since `base` (same component type, or nullptr); nullptr if none did.
+  virtual std::unique_ptr<IPoolDelta> diff(const IPool* base) const = 0;
+  // Bytes of blocks referenced by this pool only (see DenseArray::exclusive_bytes).
+  virtual std::size_t exclusive_bytes() const = 0;
+  // For World::verify_pools: the owner of row `di` (false if there is no live row there), and
+  // the number of live rows.
+  virtual bool row_owner(DenseIndex di, std::uint32_t& entity_idx, std::uint32_t& gen) const = 0;
+  virtual std::size_t live_rows() const = 0;
+  // For World::verify_pools: false if the pool's sparse index (if any) disagrees with its rows.
+  virtual bool index_consistent() const = 0;
+  // Newest tick stamped into the pool (0 unless change-tracked); restore keeps the World's
+  // tick at or above it.
+  virtual Tick max_tick() const = 0;
 };
 
+// Storage policy selector. Specialize to std::true_type for components whose address must not
+// change while they exist ("handle-stable"): erasure leaves a tombstone instead of moving the
+// last row into the hole, later emplaces reuse holes, iteration skips them via a per-block
+// occupancy bitmap, and World::compact() closes them on demand.
+template <typename T>
+struct stable_storage : std::false_type {};
+
+// Lookup policy selector. Specialize to std::true_type for components fetched by handle far
+// more often than they are added or removed: the pool then also keeps a SparseIndex from
+// entity_idx to row, and World::try_get/get/has go through it instead of the entity's
+// signature rank and idx table. The idx table is still maintained (groups, snapshots and
+// verify_pools read it).
+template <typename T>
+struct sparse_lookup : std::false_type {};
+
+template <typename T>
+struct PoolDelta;
+template <typename T>
+struct PoolCodec;
+
 template <typename T>
 class Pool final : public IPool {
 public:
+  static constexpr bool kStable = stable_storage<T>::value;
+  static constexpr bool kSoa = false;
+  static constexpr bool kSparse = sparse_lookup<T>::value;
+  static constexpr bool kTracked = change_ticks<T>::value;
+  static constexpr std::size_t kBlockSize = DenseArray<Component<T>>::kBlockSize;
+  static_assert(kBlockSize % 64 == 0, "Occupancy words must not straddle blocks.");
+
   DenseArray<Component<T>> items;
 
+  // Live rows. Stable pools may hold tombstones, so this can be less than items.size().
+  std::size_t size() const {
+    return items.size() - free_rows_.size();
+  }
+
+  bool is_live(DenseIndex di) const {
+    if constexpr (kStable) {
+      return di < items.size() && ((occupied_[di >> 6] >> (di & 63)) & 1ULL) != 0;
+    } else {
+      return di < items.size();
+    }
+  }
+
+  // True if block `block_idx` of items holds only tombstones (stable pools only).
+  bool block_empty(std::size_t block_idx) const {
+    if constexpr (kStable) {
+      return block_live_[block_idx] == 0;
+    } else {
+      (void)block_idx;
+      return false;
+    }
+  }
+
+  // Row owned by entity_idx, or kInvalidIndex (sparse-lookup pools only). The caller checks
+  // the row's gen against its handle.
+  DenseIndex sparse_row(std::uint32_t entity_idx) const {
+    static_assert(kSparse, "Only sparse_lookup<T> pools keep a sparse index.");
+    return sparse_.get(entity_idx);
+  }
+
+  // Change-tracked pools only (no-ops otherwise): stamp row di as added (which also counts as
+  // changed) or changed at `tick`.
+  void stamp_added(DenseIndex di, Tick tick) {
+    if constexpr (kTracked) {
+      items[di].ticks = RowTicks{tick, tick};
+      ticks_note(di);
+    } else {
+      (void)di;
+      (void)tick;
+    }
+  }
+
+  void stamp_changed(DenseIndex di, Tick tick) {
+    if constexpr (kTracked) {
+      items[di].ticks.changed = tick;
+      ticks_note(di);
+    } else {
+      (void)di;
+      (void)tick;
+    }
+  }
+
+  // Upper bound of the ticks in block `block_idx` of items (change-tracked pools only): rows
+  // leaving a block do not lower it, so a block whose bound is <= t has nothing newer than t.
+  RowTicks block_ticks(std::size_t block_idx) const {
+    static_assert(kTracked, "Only change_ticks<T> pools keep ticks.");
+    return block_idx < block_ticks_.size() ? block_ticks_[block_idx] : RowTicks{};
+  }
+
   template <typename... Args>
   DenseIndex emplace(std::uint32_t entity_idx, std::uint32_t gen, Args&&... args) {
-    return static_cast<DenseIndex>(items.emplace_back(entity_idx, gen, std::forward<Args>(args)...));
+    if constexpr (kStable) {
+      DenseIndex di = 0;
+      if (!free_rows_.empty()) {
+        Component<T> comp(entity_idx, gen, std::forward<Args>(args)...);
+        di = free_rows_.back();
+        free_rows_.pop_back();
+        items[di] = std::move(comp);
+      } else {
+        di = static_cast<DenseIndex>(items.emplace_back(entity_idx, gen, std::forward<Args>(args)...));
+        occupied_.resize((items.size() + 63) / 64, 0);
+        block_live_.resize(items.block_count(), 0);
+      }
+      occupied_[di >> 6] |= 1ULL << (di & 63);
+      ++block_live_[di / kBlockSize];
+      sparse_note(di);
+      return di;
+    } else {
+      const auto di = static_cast<DenseIndex>(items.emplace_back(entity_idx, gen, std::forward<Args>(args)...));
+      sparse_note(di);
+      return di;
+    }
+  }
+
+  // Calls fn(row) for every live row in [begin, end). Stable pools skip empty blocks
+  // and walk the occupancy bitmap a word at a time.
+  template <typename Fn>
+  void for_each_row(std::size_t begin, std::size_t end, Fn&& fn) {
+    if constexpr (kStable) {
+      std::size_t i = begin;
+      while (i < end) {
+        const std::size_t block_end = std::min(end, (i / kBlockSize + 1) * kBlockSize);
+        if (block_live_[i / kBlockSize] == 0) {
+          i = block_end;
+          continue;
+        }
+        while (i < block_end) {
+          const std::size_t word_end = std::min(block_end, ((i >> 6) + 1) << 6);
+          std::uint64_t bits = occupied_[i >> 6] >> (i & 63);
+          while (bits != 0) {
+            const std::size_t row = i + static_cast<std::size_t>(std::countr_zero(bits));
+            if (row >= word_end) {
+              break;
+            }
+            fn(row);
+            bits &= bits - 1ULL;
+          }
+          i = word_end;
+        }
+      }
+    } else {
+      for (std::size_t i = begin; i < end; ++i) {
+        fn(i);
+      }
+    }
   }
 
   void erase_dense(DenseIndex di, World& world) override;
-  DenseIndex clone_dense(std::uint32_t dst_entity_idx, std::uint32_t dst_gen, DenseIndex src_di) override {
-    const auto& src = items[src_di];
-    return static_cast<DenseIndex>(items.emplace_back(dst_entity_idx, dst_gen, src.data));
+  void erase_dense_batch(const DenseIndex* rows, std::size_t count, World& world) override;
+  // Exchanges two rows; the caller patches the owners' idx entries.
+  void swap_dense(DenseIndex a, DenseIndex b) {
+    static_assert(!kStable, "Rows of a handle-stable pool never move.");
+    using std::swap;
+    swap(items[a], items[b]);
+    sparse_note(a);
+    sparse_note(b);
+    ticks_note(a);
+    ticks_note(b);
+  }
+  // Moves row r to row dest[r] for every r < dest.size() (a permutation of those rows) in one
+  // gather pass; the caller patches the owners' idx entries.
+  void permute(std::span<const DenseIndex> dest) {
+    static_assert(!kStable, "Rows of a handle-stable pool never move.");
+    const std::size_t count = dest.size();
+    std::vector<DenseIndex> src(count);
+    for (std::size_t r = 0; r < count; ++r) {
+      src[dest[r]] = static_cast<DenseIndex>(r);
+    }
+    std::vector<Component<T>> gathered;
+    gathered.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      gathered.push_back(std::move(items[src[i]]));
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto di = static_cast<DenseIndex>(i);
+      items[di] = std::move(gathered[i]);
+      sparse_note(di);
+      ticks_note(di);
+    }
+  }
+  DenseIndex clone_dense(std::uint32_t dst_entity_idx, std::uint32_t dst_gen, DenseIndex src_di, Tick tick) override {
+    // DenseArray blocks never move, so the source reference survives a growing emplace.
+    const DenseIndex di = emplace(dst_entity_idx, dst_gen, items[src_di].data);
+    stamp_added(di, tick);
+    return di;
   }
   void* component_ptr(DenseIndex di) override {
     return &items[di];
   }
+  // Shares the DenseArray blocks (copy-on-write); only the bookkeeping vectors are copied.
   std::unique_ptr<IPool> clone() const override {
     auto out = std::make_unique<Pool<T>>();
     out->items = items;
+    out->occupied_ = occupied_;
+    out->block_live_ = block_live_;
+    out->free_rows_ = free_rows_;
+    out->sparse_ = sparse_;
+    out->block_ticks_ = block_ticks_;
     return out;
   }
+  void compact(World& world) override;
+  void unshare() override {
+    items.unshare();
+  }
+  std::unique_ptr<IPoolDelta> diff(const IPool* base) const override;
+  std::size_t exclusive_bytes() const override {
+    return items.exclusive_bytes() + sparse_.exclusive_bytes();
+  }
+  bool row_owner(DenseIndex di, std::uint32_t& entity_idx, std::uint32_t& gen) const override {
+    if (!is_live(di)) {
+      return false;
+    }
+    entity_idx = items[di].entity_idx;
+    gen = items[di].gen;
+    return true;
+  }
+  std::size_t live_rows() const override {
+    return size();
+  }
+  bool index_consistent() const override {
+    if constexpr (kSparse) {
+      for (DenseIndex row = 0; row < items.size(); ++row) {
+        if (is_live(row) && sparse_.get(items[row].entity_idx) != row) {
+          return false;
+        }
+      }
+      return sparse_.count() == size();
+    } else {
+      return true;
+    }
+  }
+  Tick max_tick() const override {
+    Tick tick = 0;
+    for (const RowTicks& block : block_ticks_) {
+      tick = std::max(tick, block.changed);
+    }
+    return tick;
+  }
+
+private:
+  // Sparse-lookup pools only: row `di` now holds its owner's component (note), or is about to
+  // stop holding it (drop). Both read the row through the const path, so keeping the index
+  // never copies a block shared with a snapshot or a mapped file.
+  void sparse_note(DenseIndex di) {
+    if constexpr (kSparse) {
+      sparse_.set(std::as_const(items)[di].entity_idx, di);
+    } else {
+      (void)di;
+    }
+  }
+
+  void sparse_drop(DenseIndex di) {
+    if constexpr (kSparse) {
+      sparse_.reset(std::as_const(items)[di].entity_idx);
+    } else {
+      (void)di;
+    }
+  }
+
+  // Loaders fill items directly; this derives the index from them.
+  void rebuild_sparse() {
+    sparse_.clear();
+    for_each_row(0, items.size(), [&](std::size_t row) { sparse_note(static_cast<DenseIndex>(row)); });
+  }
+
+  // Change-tracked pools only: row `di` now holds the ticks its block bound must cover.
+  void ticks_note(DenseIndex di) {
+    if constexpr (kTracked) {
+      const std::size_t block = di / kBlockSize;
+      if (block >= block_ticks_.size()) {
+        block_ticks_.resize(block + 1);
+      }
+      const RowTicks& row = std::as_const(items)[di].ticks;
+      block_ticks_[block].added = std::max(block_ticks_[block].added, row.added);
+      block_ticks_[block].changed = std::max(block_ticks_[block].changed, row.changed);
+    } else {
+      (void)di;
+    }
+  }
+
+  // Loaders: derives the block bounds from the rows' ticks.
+  void rebuild_ticks() {
+    block_ticks_.clear();
+    for_each_row(0, items.size(), [&](std::size_t row) { ticks_note(static_cast<DenseIndex>(row)); });
+  }
+
+  // Stable pools only: turns a live row into a reusable tombstone.
+  void bury(DenseIndex di) {
+    sparse_drop(di);
+    auto& comp = items[di];
+    // gen 0 never matches a live entity, so code that checks owners skips tombstones too.
+    comp.gen = 0;
+    if constexpr (std::is_default_constructible_v<T> && !std::is_trivially_destructible_v<T>) {
+      comp.data = T{}; // release resources now rather than on reuse
+    }
+    occupied_[di >> 6] &= ~(1ULL << (di & 63));
+    --block_live_[di / kBlockSize];
+    free_rows_.push_back(di);
+  }
+
+  // Stable pools only: bit per row of items (set = live), live rows per block, tombstone rows.
+  std::vector<std::uint64_t> occupied_;
+  std::vector<std::uint32_t> block_live_;
+  std::vector<DenseIndex> free_rows_;
+  // Sparse-lookup pools only.
+  SparseIndex sparse_;
+  // Change-tracked pools only: per block of items, the newest added/changed tick of its rows.
+  std::vector<RowTicks> block_ticks_;
+
+  friend struct PoolDelta<T>;
+  friend struct PoolCodec<T>;
 };
 
+template <typename T>
+struct PoolDelta final : IPoolDelta {
+  typename DenseArray<Component<T>>::Delta items;
+  // Stable pools only: the bookkeeping is small, so it travels whole.
+  std::vector<std::uint64_t> occupied;
+  std::vector<std::uint32_t> block_live;
+  std::vector<DenseIndex> free_rows;
+  // Sparse-lookup pools only: travels whole, its pages shared with the pool it came from.
+  SparseIndex sparse;
+  std::size_t sparse_bytes = 0;
+  // Change-tracked pools only: block tick bounds, small enough to travel whole.
+  std::vector<RowTicks> block_ticks;
+
+  std::unique_ptr<IPool> apply(const IPool* base) const override {
+    auto out = std::make_unique<Pool<T>>();
+    if (base) {
+      out->items.patch(static_cast<const Pool<T>*>(base)->items, items);
+    } else {
+      out->items.patch(DenseArray<Component<T>>{}, items);
+    }
+    out->occupied_ = occupied;
+    out->block_live_ = block_live;
+    out->free_rows_ = free_rows;
+    out->sparse_ = sparse;
+    out->block_ticks_ = block_ticks;
+    return out;
+  }
+
+  std::size_t dirty_blocks() const override {
+    return DenseArray<Component<T>>::delta_blocks(items);
+  }
+
+  std::size_t dirty_bytes() const override {
+    return DenseArray<Component<T>>::delta_bytes(items) + occupied.size() * sizeof(std::uint64_t) +
+           block_live.size() * sizeof(std::uint32_t) + free_rows.size() * sizeof(DenseIndex) + sparse_bytes +
+           block_ticks.size() * sizeof(RowTicks);
+  }
+};
+
+template <typename T>
+std::unique_ptr<IPoolDelta> Pool<T>::diff(const IPool* base) const {
+  auto out = std::make_unique<PoolDelta<T>>();
+  if (base) {
+    out->items = items.diff(static_cast<const Pool<T>*>(base)->items);
+  } else {
+    out->items = items.diff(DenseArray<Component<T>>{});
+  }
+  if (DenseArray<Component<T>>::delta_blocks(out->items) == 0 && base && out->items.size == static_cast<const Pool<T>*>(base)->items.size()) {
+    return nullptr;
+  }
+  out->occupied = occupied_;
+  out->block_live = block_live_;
+  out->free_rows = free_rows_;
+  out->block_ticks = block_ticks_;
+  if constexpr (kSparse) {
+    out->sparse = sparse_;
+    out->sparse_bytes = base ? sparse_.bytes_not_in(static_cast<const Pool<T>*>(base)->sparse_) : sparse_.bytes_not_in(SparseIndex{});
+  }
+  return out;
+}
+
+// Pools of components with a soa_fields<T> specialization: one column per field plus the
+// owners' entity_idx/gen. Rows have no T address, so component_ptr is nullptr and World hands
+// out SoaRef<T> instead of T&.
+template <soa_component T>
+class Pool<T> final : public IPool {
+public:
+  static constexpr bool kStable = false;
+  static constexpr bool kSoa = true;
+  static constexpr bool kSparse = false;
+  static constexpr bool kTracked = false;
+  static constexpr std::size_t kBlockSize = SoaArray<T>::kBlockSize;
+  static_assert(!stable_storage<T>::value, "SoA pools swap-erase; they cannot be handle-stable.");
+  static_assert(!sparse_lookup<T>::value, "SoA pools have no sparse index; SoaRef lookups go through the idx table.");
+  static_assert(!change_ticks<T>::value, "SoA pools have no per-row ticks.");
+
+  SoaArray<T> items;
+
+  std::size_t size() const {
+    return items.size();
+  }
+
+  bool is_live(DenseIndex di) const {
+    return di < items.size();
+  }
+
+  template <typename... Args>
+  DenseIndex emplace(std::uint32_t entity_idx, std::uint32_t gen, Args&&... args) {
+    return static_cast<DenseIndex>(items.emplace_back(entity_idx, gen, T{std::forward<Args>(args)...}));
+  }
+
+  template <typename Fn>
+  void for_each_row(std::size_t begin, std::size_t end, Fn&& fn) {
+    for (std::size_t i = begin; i < end; ++i) {
+      fn(i);
+    }
+  }
+
+  void erase_dense(DenseIndex di, World& world) override;
+  void erase_dense_batch(const DenseIndex* rows, std::size_t count, World& world) override;
+  DenseIndex clone_dense(std::uint32_t dst_entity_idx, std::uint32_t dst_gen, DenseIndex src_di, Tick) override {
+    return emplace(dst_entity_idx, dst_gen, items.load(src_di));
+  }
+  void* component_ptr(DenseIndex) override {
+    return nullptr;
+  }
+  std::unique_ptr<IPool> clone() const override {
+    auto out = std::make_unique<Pool<T>>();
+    out->items = items;
+    return out;
+  }
+  void compact(World&) override {}
+  void unshare() override {
+    items.unshare();
+  }
+  std::unique_ptr<IPoolDelta> diff(const IPool* base) const override;
+  std::size_t exclusive_bytes() const override {
+    return items.exclusive_bytes();
+  }
+  bool row_owner(DenseIndex di, std::uint32_t& entity_idx, std::uint32_t& gen) const override {
+    if (!is_live(di)) {
+      return false;
+    }
+    entity_idx = items.entity_idx(di);
+    gen = items.gen(di);
+    return true;
+  }
+  std::size_t live_rows() const override {
+    return size();
+  }
+  bool index_consistent() const override {
+    return true;
+  }
+  Tick max_tick() const override {
+    return 0;
+  }
+};
+
+template <soa_component T>
+struct SoaPoolDelta final : IPoolDelta {
+  typename SoaArray<T>::Delta items;
+
+  std::unique_ptr<IPool> apply(const IPool* base) const override {
+    auto out = std::make_unique<Pool<T>>();
+    out->items.patch(base ? static_cast<const Pool<T>*>(base)->items : SoaArray<T>{}, items);
+    return out;
+  }
+
+  std::size_t dirty_blocks() const override {
+    return SoaArray<T>::delta_blocks(items);
+  }
+
+  std::size_t dirty_bytes() const override {
+    return SoaArray<T>::delta_bytes(items);
+  }
+};
+
+template <soa_component T>
+std::unique_ptr<IPoolDelta> Pool<T>::diff(const IPool* base) const {
+  auto out = std::make_unique<SoaPoolDelta<T>>();
+  const SoaArray<T> empty;
+  const SoaArray<T>& base_items = base ? static_cast<const Pool<T>*>(base)->items : empty;
+  out->items = items.diff(base_items);
+  if (SoaArray<T>::delta_blocks(out->items) == 0 && base && out->items.size == base_items.size()) {
+    return nullptr;
+  }
+  return out;
+}
+
 } // namespace ecs_lab
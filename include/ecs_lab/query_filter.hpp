@@ -0,0 +1,140 @@
+#pragma once
+
+#include "ecs_lab/component.hpp"
+#include "ecs_lab/ecs_types.hpp"
+#include "ecs_lab/signature.hpp"
+
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ecs_lab {
+
+// Query terms for QueryFilter: entities must have every With component (handed out as T&),
+// must have no Without component, and get each Optional component as T* (nullptr if absent).
+template <typename... Ts>
+struct With {};
+
+template <typename... Ts>
+struct Without {};
+
+template <typename... Ts>
+struct Optional {};
+
+// Change terms (change_ticks<T> components only): the entity must have T, and T's row must have
+// been changed (Changed) or added (Added) after the filter's `since` tick. T is not handed to
+// the callback unless it is also a With term.
+template <typename... Ts>
+struct Changed {};
+
+template <typename... Ts>
+struct Added {};
+
+// Tag for World::each/query overloads that stamp the rows they hand out as changed.
+struct StampChanged {};
+inline constexpr StampChanged stamp_changed{};
+
+namespace detail {
+
+template <template <typename...> class Term, typename T>
+struct term_types {
+  using type = std::tuple<>;
+};
+
+template <template <typename...> class Term, typename... Ts>
+struct term_types<Term, Term<Ts...>> {
+  using type = std::tuple<Ts...>;
+};
+
+// The component types of every Term<...> in Terms, in order, as a std::tuple type.
+template <template <typename...> class Term, typename... Terms>
+using term_types_t = decltype(std::tuple_cat(std::declval<typename term_types<Term, Terms>::type>()...));
+
+template <typename T>
+inline constexpr bool is_query_term_v = false;
+
+template <typename... Ts>
+inline constexpr bool is_query_term_v<With<Ts...>> = true;
+
+template <typename... Ts>
+inline constexpr bool is_query_term_v<Without<Ts...>> = true;
+
+template <typename... Ts>
+inline constexpr bool is_query_term_v<Optional<Ts...>> = true;
+
+template <typename... Ts>
+inline constexpr bool is_query_term_v<Changed<Ts...>> = true;
+
+template <typename... Ts>
+inline constexpr bool is_query_term_v<Added<Ts...>> = true;
+
+template <typename Tuple>
+struct tuple_are_unique;
+
+template <typename... Ts>
+struct tuple_are_unique<std::tuple<Ts...>> : are_unique<Ts...> {};
+
+template <typename Tuple>
+struct tuple_all_tracked;
+
+template <typename... Ts>
+struct tuple_all_tracked<std::tuple<Ts...>> : std::bool_constant<(change_ticks<Ts>::value && ...)> {};
+
+template <typename Tuple>
+struct tuple_signature;
+
+template <typename... Ts>
+struct tuple_signature<std::tuple<Ts...>> {
+  static Signature<kMaxComponents> make() {
+    Signature<kMaxComponents> sig{};
+    sig.clear();
+    (sig.set(component_id<Ts>()), ...);
+    return sig;
+  }
+};
+
+} // namespace detail
+
+// A query compiled once into signature masks, e.g.
+//   QueryFilter<With<Position, Velocity>, Without<Dead>, Optional<Buff>> filter;
+//   world.query(filter, [](Entity, Position&, Velocity&, Buff*) { ... });
+// Terms may come in any order and repeat; each component may appear in one With, Without or
+// Optional term only (Changed/Added may repeat a With component). The smallest With pool, or
+// with change terms the smallest Changed/Added pool, drives the scan, and every candidate row
+// costs one pass over the owner's signature. The filter holds no World state beyond `since`
+// and can be reused across worlds and frames.
+template <typename... Terms>
+class QueryFilter {
+public:
+  static_assert((detail::is_query_term_v<Terms> && ...),
+                "QueryFilter takes With<>, Without<>, Optional<>, Changed<> and Added<> terms.");
+
+  using WithTypes = detail::term_types_t<With, Terms...>;
+  using WithoutTypes = detail::term_types_t<Without, Terms...>;
+  using OptionalTypes = detail::term_types_t<Optional, Terms...>;
+  using ChangedTypes = detail::term_types_t<Changed, Terms...>;
+  using AddedTypes = detail::term_types_t<Added, Terms...>;
+  static constexpr bool kChangeTerms = std::tuple_size_v<ChangedTypes> + std::tuple_size_v<AddedTypes> > 0;
+
+  static_assert(std::tuple_size_v<WithTypes> > 0 || kChangeTerms,
+                "QueryFilter needs a With<>, Changed<> or Added<> component to drive the scan.");
+  static_assert(detail::tuple_all_tracked<decltype(std::tuple_cat(std::declval<ChangedTypes>(),
+                                                                  std::declval<AddedTypes>()))>::value,
+                "Changed<T>/Added<T> need a change_ticks<T> specialization.");
+  static_assert(detail::tuple_are_unique<decltype(std::tuple_cat(std::declval<WithTypes>(), std::declval<WithoutTypes>(),
+                                                                 std::declval<OptionalTypes>()))>::value,
+                "Each component may appear in one QueryFilter term only.");
+
+  QueryFilter()
+      : required(detail::tuple_signature<decltype(std::tuple_cat(std::declval<WithTypes>(), std::declval<ChangedTypes>(),
+                                                                 std::declval<AddedTypes>()))>::make()),
+        excluded(detail::tuple_signature<WithoutTypes>::make()) {}
+
+  Signature<kMaxComponents> required;
+  Signature<kMaxComponents> excluded;
+  // Change terms match rows stamped after this tick; a system sets it to the tick of its
+  // previous run (see World::advance_tick). 0 matches every stamped row.
+  Tick since = 0;
+};
+
+} // namespace ecs_lab
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "ecs_lab/component.hpp"
+#include "ecs_lab/signature.hpp"
+#include "ecs_lab/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+class World;
+
+// Component access declarations for Scheduler::add_system.
+template <typename... Ts>
+struct Reads {
+  static Signature<kMaxComponents> mask() {
+    Signature<kMaxComponents> sig{};
+    (sig.set(component_id<Ts>()), ...);
+    return sig;
+  }
+};
+
+template <typename... Ts>
+struct Writes {
+  static Signature<kMaxComponents> mask() {
+    Signature<kMaxComponents> sig{};
+    (sig.set(component_id<Ts>()), ...);
+    return sig;
+  }
+};
+
+// Runs a fixed list of systems once per run() call. Systems are ordered by
+// registration; a system depends on every earlier system whose declared
+// component accesses conflict with its own (write/write or read/write), and
+// non-conflicting systems run concurrently on a work-stealing ThreadPool.
+//
+// Contract: a system may only touch the component types it declared and must
+// not structurally modify the World (record structural changes and apply them
+// after run() returns).
+class Scheduler {
+public:
+  struct SystemStats {
+    std::string name;
+    double start_ms = 0.0; // relative to the start of the last run()
+    double duration_ms = 0.0;
+  };
+
+  explicit Scheduler(ThreadPool& threads = ThreadPool::shared())
+      : threads_(&threads) {}
+
+  // fn(World&). Returns the system index used in stats() and critical_path().
+  template <typename ReadList, typename WriteList, typename Fn>
+  std::size_t add_system(std::string name, Fn&& fn) {
+    System sys;
+    sys.name = std::move(name);
+    sys.reads = ReadList::mask();
+    sys.writes = WriteList::mask();
+    sys.fn = std::forward<Fn>(fn);
+
+    const std::size_t self = systems_.size();
+    for (std::size_t i = 0; i < self; ++i) {
+      if (conflicts(systems_[i], sys)) {
+        systems_[i].successors.push_back(self);
+        sys.predecessors.push_back(i);
+      }
+    }
+    sys.reads.for_each_set_bit([&](ComponentId cid) { touched_.set(cid); });
+    sys.writes.for_each_set_bit([&](ComponentId cid) { touched_.set(cid); });
+    systems_.push_back(std::move(sys));
+    return self;
+  }
+
+  std::size_t system_count() const { return systems_.size(); }
+
+  // True if system `b` waits for system `a` (their declared accesses conflict and `a` came first).
+  bool depends_on(std::size_t b, std::size_t a) const {
+    const auto& preds = systems_[b].predecessors;
+    return std::find(preds.begin(), preds.end(), a) != preds.end();
+  }
+
+  void run(World& world) {
+    const std::size_t n = systems_.size();
+    if (n == 0) {
+      return;
+    }
+    waiting_ = std::make_unique<std::atomic<std::size_t>[]>(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      waiting_[i].store(systems_[i].predecessors.size(), std::memory_order_relaxed);
+    }
+    remaining_.store(n, std::memory_order_relaxed);
+    unshare(world);
+    run_start_ = Clock::now();
+
+    for (std::size_t i = 0; i < n; ++i) {
+      if (systems_[i].predecessors.empty()) {
+        threads_->submit([this, &world, i] { execute(world, i); });
+      }
+    }
+    threads_->wait_until([this] { return remaining_.load(std::memory_order_acquire) == 0; });
+    frame_ms_ = ms_since(run_start_, Clock::now());
+  }
+
+  // Timings of the last run(), indexed by system.
+  std::vector<SystemStats> stats() const {
+    std::vector<SystemStats> out;
+    out.reserve(systems_.size());
+    for (const auto& sys : systems_) {
+      out.push_back(SystemStats{sys.name, sys.start_ms, sys.duration_ms});
+    }
+    return out;
+  }
+
+  double frame_ms() const { return frame_ms_; }
+
+  // Longest dependency chain of the last run() weighted by system duration.
+  std::vector<std::size_t> critical_path() const {
+    const std::size_t n = systems_.size();
+    std::vector<double> cost(n, 0.0);
+    std::vector<std::size_t> prev(n, static_cast<std::size_t>(-1));
+    std::size_t tail = 0;
+    // Registration order is a topological order (edges always point forward).
+    for (std::size_t i = 0; i < n; ++i) {
+      double best = 0.0;
+      for (const std::size_t p : systems_[i].predecessors) {
+        if (prev[i] == static_cast<std::size_t>(-1) || cost[p] > best) {
+          best = cost[p];
+          prev[i] = p;
+        }
+      }
+      cost[i] = best + systems_[i].duration_ms;
+      if (cost[i] > cost[tail]) {
+        tail = i;
+      }
+    }
+    std::vector<std::size_t> path;
+    for (std::size_t i = tail; n > 0 && i != static_cast<std::size_t>(-1); i = prev[i]) {
+      path.push_back(i);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+  }
+
+  double critical_path_ms() const {
+    double total = 0.0;
+    for (const std::size_t i : critical_path()) {
+      total += systems_[i].duration_ms;
+    }
+    return total;
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  struct System {
+    std::string name;
+    Signature<kMaxComponents> reads{};
+    Signature<kMaxComponents> writes{};
+    std::function<void(World&)> fn;
+    std::vector<std::size_t> predecessors;
+    std::vector<std::size_t> successors;
+    double start_ms = 0.0;
+    double duration_ms = 0.0;
+  };
+
+  // Copies pool blocks still shared with a snapshot before systems run concurrently (defined in world.hpp).
+  void unshare(World& world) const;
+
+  static bool conflicts(const System& a, const System& b) {
+    return a.writes.intersects(b.writes) || a.writes.intersects(b.reads) || a.reads.intersects(b.writes);
+  }
+
+  static double ms_since(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  }
+
+  void execute(World& world, std::size_t i) {
+    System& sys = systems_[i];
+    const auto begin = Clock::now();
+    sys.fn(world);
+    const auto end = Clock::now();
+    sys.start_ms = ms_since(run_start_, begin);
+    sys.duration_ms = ms_since(begin, end);
+
+    // Ready successors go to this worker's own deque; idle workers steal them.
+    for (const std::size_t next : sys.successors) {
+      if (waiting_[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        threads_->submit([this, &world, next] { execute(world, next); });
+      }
+    }
+    remaining_.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  ThreadPool* threads_ = nullptr;
+  std::vector<System> systems_;
+  // Union of every system's declared reads and writes.
+  Signature<kMaxComponents> touched_{};
+  std::unique_ptr<std::atomic<std::size_t>[]> waiting_;
+  std::atomic<std::size_t> remaining_{0};
+  Clock::time_point run_start_{};
+  double frame_ms_ = 0.0;
+};
+
+} // namespace ecs_lab
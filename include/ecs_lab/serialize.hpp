@@ -0,0 +1,948 @@
+#pragma once
+
+#include "ecs_lab/world.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ecs_lab {
+
+// Binary snapshot format, version 2 (host byte order and layout). `pad n` zero-fills up to the
+// next multiple of n bytes from the start of the file, so a mapped file has aligned sections:
+//
+//   u32 magic "ECSL", u32 version, u64 next_entity_id
+//   u32 K, K x { u16 length, name bytes }        component table; file slot = position
+//   pad 8, u32 bump, u32 free_head, u64 idx_total
+//   bump x SnapshotMetaRecord, idx_total x SnapshotIdxRecord
+//   K x { pad 8, SnapshotPoolHeader, rows, [stable bookkeeping: 3 x { u64 n, n values }] }
+//
+// Components are identified by the name given to register_component<T>(), never by the
+// process-local component_id<T>(), so signatures and idx tables are remapped on load.
+// Trivially copyable components store their rows as DenseArray block images (after pad
+// max(64, image alignment)), which map_snapshot adopts in place; other components go through
+// their registered hooks as { u32 entity_idx, u32 gen, payload } per row. SoA pools store, per
+// block, entity_idx, gen and then each field column (rows x field size, no padding); they are
+// always copied on load.
+constexpr std::uint32_t kSnapshotMagic = 0x4C534345u; // "ECSL"
+constexpr std::uint32_t kSnapshotVersion = 2;
+
+struct SnapshotMetaRecord {
+  std::uint64_t entity_id = 0;
+  std::uint32_t entity_idx = 0;
+  std::uint32_t gen = 0;
+  std::uint32_t idx_first = 0; // into the idx records
+  std::uint32_t idx_count = 0;
+};
+
+struct SnapshotIdxRecord {
+  std::uint16_t slot = 0;
+  std::uint16_t reserved = 0;
+  DenseIndex dense_index = 0;
+};
+
+// SnapshotPoolHeader::layout values.
+constexpr std::uint8_t kPoolRowsHooked = 0;
+constexpr std::uint8_t kPoolBlockImages = 1;
+constexpr std::uint8_t kPoolColumns = 2; // SoA: per block, each column's rows back to back
+
+struct SnapshotPoolHeader {
+  std::uint8_t stable = 0;
+  std::uint8_t layout = 0; // kPoolRowsHooked / kPoolBlockImages / kPoolColumns
+  std::uint16_t reserved = 0;
+  std::uint32_t row_bytes = 0;
+  std::uint64_t rows = 0;
+  std::uint32_t image_bytes = 0;
+  std::uint32_t image_offset = 0;
+};
+
+// Buffered binary sink. Writes of at least one buffer go straight to the stream.
+class BinaryWriter {
+public:
+  explicit BinaryWriter(std::ostream& out)
+      : out_(&out) {
+    buf_.reserve(kBufferSize);
+  }
+
+  ~BinaryWriter() { flush(); }
+
+  // Published with the number of bytes handed to the stream as writing proceeds.
+  void set_progress(std::atomic<std::uint64_t>* progress) { progress_ = progress; }
+
+  template <typename T>
+  void put(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    write(&value, sizeof(T));
+  }
+
+  void write(const void* data, std::size_t bytes) {
+    offset_ += bytes;
+    if (buf_.size() + bytes > kBufferSize) {
+      flush();
+    }
+    if (bytes >= kBufferSize) {
+      out_->write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+      publish();
+      return;
+    }
+    const char* p = static_cast<const char*>(data);
+    buf_.insert(buf_.end(), p, p + bytes);
+  }
+
+  void zeros(std::size_t bytes) {
+    static constexpr char kZeros[256] = {};
+    for (; bytes > sizeof(kZeros); bytes -= sizeof(kZeros)) {
+      write(kZeros, sizeof(kZeros));
+    }
+    write(kZeros, bytes);
+  }
+
+  // Zero-fills up to the next multiple of `align` bytes written.
+  void pad_to(std::size_t align) { zeros((align - offset_ % align) % align); }
+
+  void flush() {
+    if (!buf_.empty()) {
+      out_->write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+      buf_.clear();
+      publish();
+    }
+  }
+
+  bool ok() const { return static_cast<bool>(*out_); }
+
+private:
+  static constexpr std::size_t kBufferSize = 1 << 16;
+
+  void publish() {
+    if (progress_) {
+      progress_->store(offset_ - buf_.size(), std::memory_order_relaxed);
+    }
+  }
+
+  std::ostream* out_ = nullptr;
+  std::vector<char> buf_;
+  std::uint64_t offset_ = 0;
+  std::atomic<std::uint64_t>* progress_ = nullptr;
+};
+
+// Binary source over a stream (buffered; reads of at least one buffer bypass it) or over memory
+// such as a mapped file, where view() hands out pointers into the memory instead of copying.
+class BinaryReader {
+public:
+  explicit BinaryReader(std::istream& in)
+      : in_(&in), storage_(kBufferSize) {
+    buf_ = storage_.data();
+  }
+
+  BinaryReader(const void* data, std::size_t size)
+      : buf_(static_cast<const char*>(data)), end_(size) {}
+
+  template <typename T>
+  bool get(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return read(&value, sizeof(T));
+  }
+
+  bool read(void* data, std::size_t bytes) {
+    char* p = static_cast<char*>(data);
+    const std::size_t buffered = std::min(bytes, end_ - pos_);
+    std::memcpy(p, buf_ + pos_, buffered);
+    pos_ += buffered;
+    p += buffered;
+    bytes -= buffered;
+    if (bytes == 0) {
+      return true;
+    }
+    if (!in_) {
+      return false;
+    }
+    if (bytes >= kBufferSize) {
+      in_->read(p, static_cast<std::streamsize>(bytes));
+      base_ += static_cast<std::uint64_t>(in_->gcount());
+      return static_cast<std::size_t>(in_->gcount()) == bytes;
+    }
+    refill();
+    if (end_ < bytes) {
+      return false;
+    }
+    std::memcpy(p, buf_, bytes);
+    pos_ = bytes;
+    return true;
+  }
+
+  bool skip(std::size_t bytes) {
+    if (!in_) {
+      if (end_ - pos_ < bytes) {
+        return false;
+      }
+      pos_ += bytes;
+      return true;
+    }
+    char scratch[256];
+    for (; bytes > sizeof(scratch); bytes -= sizeof(scratch)) {
+      if (!read(scratch, sizeof(scratch))) {
+        return false;
+      }
+    }
+    return read(scratch, bytes);
+  }
+
+  // Skips the padding a BinaryWriter::pad_to(align) wrote at the same position.
+  bool align(std::size_t align) { return skip(static_cast<std::size_t>((align - offset() % align) % align)); }
+
+  // Pointer to the next `bytes` bytes, consumed; only over memory (nullptr for streams or past the end).
+  const char* view(std::size_t bytes) {
+    if (in_ || end_ - pos_ < bytes) {
+      return nullptr;
+    }
+    const char* p = buf_ + pos_;
+    pos_ += bytes;
+    return p;
+  }
+
+  bool mapped() const { return in_ == nullptr; }
+
+  std::uint64_t offset() const { return base_ + pos_; }
+
+private:
+  static constexpr std::size_t kBufferSize = 1 << 16;
+
+  void refill() {
+    base_ += end_;
+    in_->read(storage_.data(), static_cast<std::streamsize>(kBufferSize));
+    pos_ = 0;
+    end_ = static_cast<std::size_t>(in_->gcount());
+  }
+
+  std::istream* in_ = nullptr;
+  std::vector<char> storage_;
+  const char* buf_ = nullptr;
+  std::size_t pos_ = 0;
+  std::size_t end_ = 0;
+  std::uint64_t base_ = 0; // file offset of buf_[0]
+};
+
+// Read-only mapping of a whole file (mmap / MapViewOfFile). Unmapped with the last reference.
+class MappedFile {
+public:
+  static std::shared_ptr<const MappedFile> open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#if defined(_WIN32)
+    file->file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size{};
+    if (file->file_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(file->file_, &size) || size.QuadPart == 0) {
+      return nullptr;
+    }
+    file->mapping_ = CreateFileMappingA(file->file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!file->mapping_) {
+      return nullptr;
+    }
+    file->data_ = static_cast<const char*>(MapViewOfFile(file->mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!file->data_) {
+      return nullptr;
+    }
+    file->size_ = static_cast<std::size_t>(size.QuadPart);
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return nullptr;
+    }
+    void* data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      return nullptr;
+    }
+    file->data_ = static_cast<const char*>(data);
+    file->size_ = static_cast<std::size_t>(st.st_size);
+#endif
+    return file;
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile() {
+#if defined(_WIN32)
+    if (data_) {
+      UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+      CloseHandle(mapping_);
+    }
+    if (file_ != INVALID_HANDLE_VALUE) {
+      CloseHandle(file_);
+    }
+#else
+    if (data_) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+  }
+
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+private:
+  MappedFile() = default;
+
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+#if defined(_WIN32)
+  HANDLE file_ = INVALID_HANDLE_VALUE;
+  HANDLE mapping_ = nullptr;
+#endif
+};
+
+// Serialize hooks for components that are not trivially copyable.
+template <typename T>
+using SaveHook = void (*)(BinaryWriter& out, const T& value);
+template <typename T>
+using LoadHook = bool (*)(BinaryReader& in, T& value);
+
+// Registered persistence entry of one component type.
+struct ComponentCodec {
+  std::string name;
+  ComponentId cid = 0;
+  bool (*save)(const IPool& pool, BinaryWriter& out) = nullptr;
+  // `owner` is set when `in` reads a mapped file; adopted blocks keep it alive.
+  std::unique_ptr<IPool> (*load)(BinaryReader& in, const std::shared_ptr<const void>& owner) = nullptr;
+  // Expected section size (hook payloads excluded).
+  std::uint64_t (*size_hint)(const IPool& pool) = nullptr;
+};
+
+inline std::vector<ComponentCodec>& component_codecs() {
+  static std::vector<ComponentCodec> codecs;
+  return codecs;
+}
+
+inline const ComponentCodec* find_codec(ComponentId cid) {
+  for (const auto& codec : component_codecs()) {
+    if (codec.cid == cid) {
+      return &codec;
+    }
+  }
+  return nullptr;
+}
+
+inline const ComponentCodec* find_codec(std::string_view name) {
+  for (const auto& codec : component_codecs()) {
+    if (codec.name == name) {
+      return &codec;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+struct PoolCodec {
+  using Row = Component<T>;
+  using Items = DenseArray<Row>;
+  static constexpr bool kRaw = std::is_trivially_copyable_v<Row>;
+
+  // Set by register_component<T>(); only used for non-trivially-copyable T.
+  static inline SaveHook<T> save_hook = nullptr;
+  static inline LoadHook<T> load_hook = nullptr;
+
+  static constexpr std::size_t image_align() {
+    return std::max<std::size_t>(64, Items::block_image_align());
+  }
+
+  template <typename V>
+  static void put_vector(BinaryWriter& out, const std::vector<V>& v) {
+    out.put(static_cast<std::uint64_t>(v.size()));
+    out.write(v.data(), v.size() * sizeof(V));
+  }
+
+  template <typename V>
+  static bool get_vector(BinaryReader& in, std::vector<V>& v) {
+    std::uint64_t count = 0;
+    if (!in.get(count)) {
+      return false;
+    }
+    v.resize(static_cast<std::size_t>(count));
+    return in.read(v.data(), v.size() * sizeof(V));
+  }
+
+  static std::uint64_t size_hint(const IPool& base) {
+    const auto& items = static_cast<const Pool<T>&>(base).items;
+    if constexpr (kRaw) {
+      return sizeof(SnapshotPoolHeader) + image_align() + items.block_count() * Items::block_image_bytes();
+    } else {
+      return sizeof(SnapshotPoolHeader) + items.size() * 2 * sizeof(std::uint32_t);
+    }
+  }
+
+  static bool save(const IPool& base, BinaryWriter& out) {
+    const auto& pool = static_cast<const Pool<T>&>(base);
+    const auto& items = pool.items;
+    SnapshotPoolHeader header;
+    header.stable = Pool<T>::kStable;
+    header.layout = kRaw ? kPoolBlockImages : kPoolRowsHooked;
+    header.rows = items.size();
+    if constexpr (kRaw) {
+      header.row_bytes = sizeof(Row);
+      header.image_bytes = static_cast<std::uint32_t>(Items::block_image_bytes());
+      header.image_offset = static_cast<std::uint32_t>(Items::block_image_offset());
+    }
+    out.put(header);
+    if constexpr (kRaw) {
+      out.pad_to(image_align());
+      char image_header[Items::block_image_offset()];
+      for (std::size_t b = 0; b < items.block_count(); ++b) {
+        const std::size_t bytes = items.block_rows(b) * sizeof(Row);
+        items.block_image_header(b, image_header);
+        out.write(image_header, sizeof(image_header));
+        out.write(items.block_data(b), bytes);
+        out.zeros(Items::block_image_bytes() - sizeof(image_header) - bytes);
+      }
+    } else {
+      if (!save_hook) {
+        return false;
+      }
+      for (std::size_t i = 0; i < items.size(); ++i) {
+        out.put(items[i].entity_idx);
+        out.put(items[i].gen);
+        if constexpr (Pool<T>::kTracked) {
+          out.put(items[i].ticks);
+        }
+        save_hook(out, items[i].data);
+      }
+    }
+    if constexpr (Pool<T>::kStable) {
+      put_vector(out, pool.occupied_);
+      put_vector(out, pool.block_live_);
+      put_vector(out, pool.free_rows_);
+    }
+    return true;
+  }
+
+  static std::unique_ptr<IPool> load(BinaryReader& in, const std::shared_ptr<const void>& owner) {
+    SnapshotPoolHeader header;
+    if (!in.get(header) || (header.stable != 0) != Pool<T>::kStable || header.layout != (kRaw ? kPoolBlockImages : kPoolRowsHooked)) {
+      return nullptr;
+    }
+    auto pool = std::make_unique<Pool<T>>();
+    auto& items = pool->items;
+    if constexpr (kRaw) {
+      if (header.row_bytes != sizeof(Row) || header.image_bytes != Items::block_image_bytes() ||
+          header.image_offset != Items::block_image_offset() || !in.align(image_align())) {
+        return nullptr;
+      }
+      char image_header[Items::block_image_offset()];
+      while (items.size() < header.rows) {
+        const std::size_t count = std::min<std::size_t>(Pool<T>::kBlockSize, header.rows - items.size());
+        if (owner) {
+          const char* image = in.view(Items::block_image_bytes());
+          if (!image || Items::block_image_rows(image) != count || !Items::block_image_external(image)) {
+            return nullptr;
+          }
+          items.adopt_block(owner, image);
+          continue;
+        }
+        if (!in.read(image_header, sizeof(image_header)) || Items::block_image_rows(image_header) != count ||
+            !in.read(items.append_block(count), count * sizeof(Row)) ||
+            !in.skip(Items::block_image_bytes() - sizeof(image_header) - count * sizeof(Row))) {
+          return nullptr;
+        }
+      }
+    } else {
+      if (!load_hook) {
+        return nullptr;
+      }
+      for (std::uint64_t i = 0; i < header.rows; ++i) {
+        std::uint32_t entity_idx = 0;
+        std::uint32_t gen = 0;
+        if (!in.get(entity_idx) || !in.get(gen)) {
+          return nullptr;
+        }
+        const std::size_t row = items.emplace_back(entity_idx, gen);
+        if constexpr (Pool<T>::kTracked) {
+          if (!in.get(items[row].ticks)) {
+            return nullptr;
+          }
+        }
+        if (!load_hook(in, items[row].data)) {
+          return nullptr;
+        }
+      }
+    }
+    if constexpr (Pool<T>::kStable) {
+      if (!get_vector(in, pool->occupied_) || !get_vector(in, pool->block_live_) ||
+          !get_vector(in, pool->free_rows_)) {
+        return nullptr;
+      }
+    }
+    if constexpr (Pool<T>::kSparse) {
+      pool->rebuild_sparse();
+    }
+    if constexpr (Pool<T>::kTracked) {
+      pool->rebuild_ticks();
+    }
+    return pool;
+  }
+};
+
+template <soa_component T>
+struct PoolCodec<T> {
+  using Items = SoaArray<T>;
+
+  static inline SaveHook<T> save_hook = nullptr;
+  static inline LoadHook<T> load_hook = nullptr;
+
+  static std::uint64_t size_hint(const IPool& base) {
+    return sizeof(SnapshotPoolHeader) + static_cast<const Pool<T>&>(base).items.size() * (sizeof(T) + 8);
+  }
+
+  static bool save(const IPool& base, BinaryWriter& out) {
+    const auto& items = static_cast<const Pool<T>&>(base).items;
+    SnapshotPoolHeader header;
+    header.layout = kPoolColumns;
+    header.row_bytes = sizeof(T);
+    header.rows = items.size();
+    out.put(header);
+    for (std::size_t b = 0; b < items.block_count(); ++b) {
+      for (std::size_t c = 0; c < Items::kColumns; ++c) {
+        out.write(items.column_data(b, c), items.block_rows(b) * Items::column_bytes(c));
+      }
+    }
+    return true;
+  }
+
+  static std::unique_ptr<IPool> load(BinaryReader& in, const std::shared_ptr<const void>&) {
+    SnapshotPoolHeader header;
+    if (!in.get(header) || header.stable != 0 || header.layout != kPoolColumns || header.row_bytes != sizeof(T)) {
+      return nullptr;
+    }
+    auto pool = std::make_unique<Pool<T>>();
+    auto& items = pool->items;
+    while (items.size() < header.rows) {
+      const std::size_t count = std::min<std::size_t>(Items::kBlockSize, header.rows - items.size());
+      items.append_block(count);
+      const std::size_t b = items.block_count() - 1;
+      for (std::size_t c = 0; c < Items::kColumns; ++c) {
+        if (!in.read(items.column_data(b, c), count * Items::column_bytes(c))) {
+          return nullptr;
+        }
+      }
+    }
+    return pool;
+  }
+};
+
+// Makes T persistable under `name`, which must be stable across builds and processes.
+// Trivially copyable components need nothing else; others need save/load hooks.
+template <typename T>
+void register_component(std::string name, SaveHook<T> save = nullptr, LoadHook<T> load = nullptr) {
+  static_assert(std::is_trivially_copyable_v<T> || std::is_default_constructible_v<T>,
+                "Hook-serialized components must be default constructible.");
+  assert((std::is_trivially_copyable_v<T> || (save && load)) && "Non-trivial components need save/load hooks.");
+  const ComponentId cid = component_id<T>();
+  auto& codecs = component_codecs();
+  codecs.erase(std::remove_if(codecs.begin(), codecs.end(),
+                              [&](const ComponentCodec& c) { return c.cid == cid || c.name == name; }),
+               codecs.end());
+  ComponentCodec codec;
+  codec.name = std::move(name);
+  codec.cid = cid;
+  codec.save = &PoolCodec<T>::save;
+  codec.load = &PoolCodec<T>::load;
+  codec.size_hint = &PoolCodec<T>::size_hint;
+  codecs.push_back(std::move(codec));
+  PoolCodec<T>::save_hook = save;
+  PoolCodec<T>::load_hook = load;
+}
+
+// Writes `snap` in the format above: on_total(bytes) once the expected size is known (hook
+// payloads excluded), on_pool(cid) after each pool's section. Entity records are staged in
+// bounded chunks. Returns false if a pool's component is not registered or the stream fails.
+template <typename OnTotal, typename OnPool>
+bool write_snapshot(const World::Snapshot& snap, BinaryWriter& out, OnTotal&& on_total, OnPool&& on_pool) {
+  std::vector<const ComponentCodec*> table;
+  std::vector<std::uint16_t> slot_of(kMaxComponents, 0xFFFFu);
+  for (std::size_t cid = 0; cid < snap.pools.size(); ++cid) {
+    if (!snap.pools[cid]) {
+      continue;
+    }
+    const ComponentCodec* codec = find_codec(static_cast<ComponentId>(cid));
+    if (!codec) {
+      return false;
+    }
+    slot_of[cid] = static_cast<std::uint16_t>(table.size());
+    table.push_back(codec);
+  }
+
+  const auto& arena = snap.arena;
+  const auto bump = static_cast<std::uint32_t>(arena.size());
+  std::uint64_t idx_total = 0;
+  for (std::uint32_t i = 0; i < bump; ++i) {
+    idx_total += arena.at(i).idx.size();
+  }
+  std::uint64_t total = 64 + bump * sizeof(SnapshotMetaRecord) + idx_total * sizeof(SnapshotIdxRecord);
+  for (const ComponentCodec* codec : table) {
+    total += codec->name.size() + 2 + codec->size_hint(*snap.pools[codec->cid]);
+  }
+  on_total(total);
+
+  out.put(kSnapshotMagic);
+  out.put(kSnapshotVersion);
+  out.put(snap.next_entity_id);
+  out.put(static_cast<std::uint32_t>(table.size()));
+  for (const ComponentCodec* codec : table) {
+    out.put(static_cast<std::uint16_t>(codec->name.size()));
+    out.write(codec->name.data(), codec->name.size());
+  }
+  out.pad_to(8);
+  out.put(bump);
+  out.put(arena.free_head());
+  out.put(idx_total);
+
+  constexpr std::uint32_t kChunk = 4096;
+  std::vector<SnapshotMetaRecord> metas;
+  metas.reserve(kChunk);
+  std::uint32_t idx_first = 0;
+  for (std::uint32_t i = 0; i < bump; ++i) {
+    const auto meta = arena.at(i);
+    auto& rec = metas.emplace_back();
+    rec.entity_id = meta.entity_id;
+    rec.entity_idx = meta.entity_idx;
+    rec.gen = meta.gen;
+    rec.idx_first = idx_first;
+    rec.idx_count = static_cast<std::uint32_t>(meta.idx.size());
+    idx_first += rec.idx_count;
+    if (metas.size() == kChunk || i + 1 == bump) {
+      out.write(metas.data(), metas.size() * sizeof(SnapshotMetaRecord));
+      metas.clear();
+    }
+  }
+  std::vector<SnapshotIdxRecord> idx;
+  idx.reserve(kChunk);
+  bool ok = true;
+  for (std::uint32_t i = 0; i < bump; ++i) {
+    const auto meta = arena.at(i);
+    std::size_t k = 0;
+    meta.sig.for_each_set_bit([&](ComponentId cid) {
+      ok = ok && slot_of[cid] != 0xFFFFu;
+      auto& entry = idx.emplace_back();
+      entry.slot = slot_of[cid];
+      entry.dense_index = meta.idx[k++];
+    });
+    if (idx.size() >= kChunk || i + 1 == bump) {
+      out.write(idx.data(), idx.size() * sizeof(SnapshotIdxRecord));
+      idx.clear();
+    }
+  }
+  if (!ok) {
+    return false;
+  }
+
+  for (const ComponentCodec* codec : table) {
+    out.pad_to(8);
+    if (!codec->save(*snap.pools[codec->cid], out)) {
+      return false;
+    }
+    on_pool(codec->cid);
+  }
+  out.flush();
+  return out.ok();
+}
+
+inline bool save_snapshot(const World::Snapshot& snap, std::ostream& stream) {
+  BinaryWriter out(stream);
+  return write_snapshot(snap, out, [](std::uint64_t) {}, [](ComponentId) {});
+}
+
+// Reads a snapshot from `in`; pools adopt block images in place when `owner` (the mapping
+// behind a memory reader) is set.
+inline bool read_snapshot(BinaryReader& in, World::Snapshot& snap, const std::shared_ptr<const void>& owner) {
+  std::uint32_t magic = 0;
+  std::uint32_t version = 0;
+  std::uint64_t next_entity_id = 0;
+  std::uint32_t count = 0;
+  if (!in.get(magic) || !in.get(version) || magic != kSnapshotMagic || version != kSnapshotVersion ||
+      !in.get(next_entity_id) || !in.get(count) || count > kMaxComponents) {
+    return false;
+  }
+  std::vector<const ComponentCodec*> table(count, nullptr);
+  std::string name;
+  for (auto& codec : table) {
+    std::uint16_t length = 0;
+    if (!in.get(length)) {
+      return false;
+    }
+    name.resize(length);
+    if (!in.read(name.data(), length)) {
+      return false;
+    }
+    codec = find_codec(name);
+    if (!codec) {
+      return false;
+    }
+  }
+  // Local component ids may order differently than the saving process's; when they do, each
+  // entity's idx table is re-sorted by id.
+  bool in_order = true;
+  for (std::size_t s = 1; s < table.size(); ++s) {
+    in_order = in_order && table[s - 1]->cid < table[s]->cid;
+  }
+
+  std::uint32_t bump = 0;
+  std::uint32_t free_head = 0;
+  std::uint64_t idx_total = 0;
+  if (!in.align(8) || !in.get(bump) || !in.get(free_head) || !in.get(idx_total)) {
+    return false;
+  }
+  std::vector<SnapshotMetaRecord> meta_storage;
+  std::vector<SnapshotIdxRecord> idx_storage;
+  const auto* metas = reinterpret_cast<const SnapshotMetaRecord*>(in.view(bump * sizeof(SnapshotMetaRecord)));
+  const auto* idx = reinterpret_cast<const SnapshotIdxRecord*>(in.view(idx_total * sizeof(SnapshotIdxRecord)));
+  if (!in.mapped()) {
+    meta_storage.resize(bump);
+    idx_storage.resize(static_cast<std::size_t>(idx_total));
+    if (!in.read(meta_storage.data(), bump * sizeof(SnapshotMetaRecord)) ||
+        !in.read(idx_storage.data(), idx_storage.size() * sizeof(SnapshotIdxRecord))) {
+      return false;
+    }
+    metas = meta_storage.data();
+    idx = idx_storage.data();
+  }
+  if (!metas || !idx) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < bump; ++i) {
+    if (static_cast<std::uint64_t>(metas[i].idx_first) + metas[i].idx_count > idx_total) {
+      return false;
+    }
+  }
+  for (std::uint64_t k = 0; k < idx_total; ++k) {
+    if (idx[k].slot >= count) {
+      return false;
+    }
+  }
+
+  World::Snapshot out;
+  out.next_entity_id = next_entity_id;
+  out.arena = LinearArena(std::make_shared<std::pmr::unsynchronized_pool_resource>());
+  std::vector<std::pair<ComponentId, DenseIndex>> entries;
+  out.arena.rehydrate(bump, free_head, [&](EntityMeta meta, std::uint32_t i) {
+    const SnapshotMetaRecord& rec = metas[i];
+    meta.entity_id = rec.entity_id;
+    meta.entity_idx = rec.entity_idx;
+    meta.gen = rec.gen;
+    meta.idx.resize(rec.idx_count);
+    const SnapshotIdxRecord* first = idx + rec.idx_first;
+    if (in_order) {
+      for (std::uint32_t k = 0; k < rec.idx_count; ++k) {
+        meta.sig.set(table[first[k].slot]->cid);
+        meta.idx[k] = first[k].dense_index;
+      }
+      return;
+    }
+    entries.clear();
+    for (std::uint32_t k = 0; k < rec.idx_count; ++k) {
+      entries.emplace_back(table[first[k].slot]->cid, first[k].dense_index);
+    }
+    std::sort(entries.begin(), entries.end());
+    for (std::uint32_t k = 0; k < rec.idx_count; ++k) {
+      meta.sig.set(entries[k].first);
+      meta.idx[k] = entries[k].second;
+    }
+  });
+
+  for (const ComponentCodec* codec : table) {
+    if (!in.align(8)) {
+      return false;
+    }
+    out.pools[codec->cid] = codec->load(in, owner);
+    if (!out.pools[codec->cid]) {
+      return false;
+    }
+  }
+  // restore indexes pool rows through these unchecked: each must name a live row.
+  for (std::uint64_t k = 0; k < idx_total; ++k) {
+    std::uint32_t row_entity = 0;
+    std::uint32_t row_gen = 0;
+    if (!out.pools[table[idx[k].slot]->cid]->row_owner(idx[k].dense_index, row_entity, row_gen)) {
+      return false;
+    }
+  }
+  snap = std::move(out);
+  return true;
+}
+
+// Reads a snapshot written by save_snapshot into `snap` (restore it with World::restore).
+// Returns false on a malformed stream, a version mismatch or an unregistered component name.
+inline bool load_snapshot(std::istream& stream, World::Snapshot& snap) {
+  BinaryReader in(stream);
+  return read_snapshot(in, snap, nullptr);
+}
+
+inline bool save_snapshot(const World::Snapshot& snap, const std::string& path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  return file && save_snapshot(snap, file);
+}
+
+inline bool load_snapshot(const std::string& path, World::Snapshot& snap) {
+  std::ifstream file(path, std::ios::binary);
+  return file && load_snapshot(file, snap);
+}
+
+// Like load_snapshot, but maps the file and lets pools of trivially copyable components adopt
+// its block images instead of copying them: those rows are read from the mapping until first
+// written, which copies the block. The mapping stays alive while any block still uses it.
+// Entity metadata and hook-serialized pools are rebuilt as in load_snapshot.
+inline bool map_snapshot(const std::string& path, World::Snapshot& snap) {
+  const auto file = MappedFile::open(path);
+  if (!file) {
+    return false;
+  }
+  BinaryReader in(file->data(), file->size());
+  return read_snapshot(in, snap, file);
+}
+
+// A snapshot being written by a background thread (World::begin_async_save). The snapshot
+// shares its blocks copy-on-write, so the World keeps running and only the blocks it writes to
+// are copied; each pool is released as soon as it is on disk. Waits for the thread on
+// destruction. Progress and memory figures may be polled from any thread.
+class AsyncSave {
+public:
+  AsyncSave() = default;
+  AsyncSave(AsyncSave&&) noexcept = default;
+
+  AsyncSave& operator=(AsyncSave&& other) noexcept {
+    if (this != &other) {
+      wait();
+      state_ = std::move(other.state_);
+      thread_ = std::move(other.thread_);
+    }
+    return *this;
+  }
+
+  ~AsyncSave() { wait(); }
+
+  bool done() const { return !state_ || state_->done.load(std::memory_order_acquire); }
+
+  // Blocks until the file is complete; true if it was written successfully. Also releases
+  // the snapshot, on the calling thread (the arena's idx memory belongs to the World's resource).
+  bool wait() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (!state_) {
+      return false;
+    }
+    state_->snap = World::Snapshot();
+    return state_->ok;
+  }
+
+  std::uint64_t bytes_written() const { return state_ ? state_->written.load(std::memory_order_relaxed) : 0; }
+
+  // Expected file size (hook payloads excluded); 0 until the writer has measured it.
+  std::uint64_t total_bytes() const { return state_ ? state_->total.load(std::memory_order_relaxed) : 0; }
+
+  // Fraction written, in [0, 1].
+  double progress() const {
+    if (done()) {
+      return 1.0;
+    }
+    const std::uint64_t total = total_bytes();
+    return total == 0 ? 0.0 : std::min(1.0, static_cast<double>(bytes_written()) / static_cast<double>(total));
+  }
+
+  // Largest amount of block memory kept alive only by the save: blocks the World copied or
+  // dropped while the snapshot still referenced them. Sampled after each section.
+  std::size_t peak_extra_bytes() const {
+    return state_ ? state_->peak_extra.load(std::memory_order_relaxed) : 0;
+  }
+
+private:
+  friend class World;
+
+  struct State {
+    World::Snapshot snap;
+    std::string path;
+    std::atomic<std::uint64_t> written{0};
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::size_t> peak_extra{0};
+    std::atomic<bool> done{false};
+    bool ok = false;
+  };
+
+  static void run(State& state) {
+    const auto sample = [&state] {
+      std::size_t extra = state.snap.arena.exclusive_bytes();
+      for (const auto& pool : state.snap.pools) {
+        extra += pool ? pool->exclusive_bytes() : 0;
+      }
+      if (extra > state.peak_extra.load(std::memory_order_relaxed)) {
+        state.peak_extra.store(extra, std::memory_order_relaxed);
+      }
+    };
+    std::ofstream file(state.path, std::ios::binary | std::ios::trunc);
+    if (file) {
+      BinaryWriter out(file);
+      out.set_progress(&state.written);
+      state.ok = write_snapshot(
+          state.snap, out,
+          [&](std::uint64_t total) {
+            state.total.store(total, std::memory_order_relaxed);
+            sample();
+          },
+          [&](ComponentId cid) {
+            sample();
+            state.snap.pools[cid].reset();
+          });
+      file.close();
+      state.ok = state.ok && !file.fail();
+    }
+    state.done.store(true, std::memory_order_release);
+  }
+
+  std::unique_ptr<State> state_;
+  std::thread thread_;
+};
+
+inline AsyncSave World::begin_async_save(const std::string& path) const {
+  AsyncSave save;
+  save.state_ = std::make_unique<AsyncSave::State>();
+  save.state_->snap = snapshot();
+  save.state_->path = path;
+  save.thread_ = std::thread(&AsyncSave::run, std::ref(*save.state_));
+  return save;
+}
+
+} // namespace ecs_lab
@@ -108,6 +108,31 @@ public:
     return true;
   }
 
+  // contains_all(required) && !intersects(excluded), in one branch-free pass over the words.
+  bool matches(const Signature& required, const Signature& excluded) const noexcept {
+    std::uint64_t miss = 0;
+    for (std::size_t i = 0; i < kWordCount; ++i) {
+      miss |= (required.words_[i] & ~words_[i]) | (excluded.words_[i] & words_[i]);
+    }
+    return miss == 0;
+  }
+
+  bool operator==(const Signature& other) const noexcept = default;
+
+  // Component cid is bit cid % 64 of word cid / 64 (batch kernels, see signature_match.hpp).
+  const std::uint64_t* words() const noexcept {
+    return words_.data();
+  }
+
+  bool intersects(const Signature& other) const noexcept {
+    for (std::size_t i = 0; i < kWordCount; ++i) {
+      if ((words_[i] & other.words_[i]) != 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
 private:
   static inline std::uint32_t popcnt64(std::uint64_t value) {
 #if defined(_MSC_VER)
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "ecs_lab/signature.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ECS_LAB_SIMD_DISPATCH 1
+#include <immintrin.h>
+#else
+#define ECS_LAB_SIMD_DISPATCH 0
+#endif
+
+namespace ecs_lab {
+
+// Batch signature matching: one bit per signature of a contiguous array (e.g. one block of the
+// arena's signature column), set iff the signature has every component of `required` and none
+// of `excluded`. 128-component signatures (the default) get AVX2 and AVX-512 kernels chosen at
+// run time; other sizes, other compilers and older CPUs take the scalar loop.
+
+enum class SimdLevel : std::uint8_t { kScalar, kAvx2, kAvx512 };
+
+// Widest kernel this CPU runs (detected once).
+inline SimdLevel cpu_simd_level() {
+#if ECS_LAB_SIMD_DISPATCH
+  static const SimdLevel level = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+      return SimdLevel::kAvx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+      return SimdLevel::kAvx2;
+    }
+    return SimdLevel::kScalar;
+  }();
+  return level;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+namespace detail {
+
+template <std::size_t MaxC>
+std::uint64_t match_word_scalar(const Signature<MaxC>* sigs, std::size_t count, const Signature<MaxC>& required,
+                                const Signature<MaxC>& excluded) {
+  std::uint64_t bits = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    bits |= static_cast<std::uint64_t>(sigs[i].matches(required, excluded)) << i;
+  }
+  return bits;
+}
+
+#if ECS_LAB_SIMD_DISPATCH
+// Two-word signatures, 64 per call: `words` holds 128 words, required/excluded two each. Each
+// kernel computes per word the required bits missing plus the excluded bits present, ORs each
+// signature's two words together, and turns "all zero" into its match bit.
+__attribute__((target("avx2"))) inline std::uint64_t match_word_avx2(const std::uint64_t* words,
+                                                                     const std::uint64_t* required,
+                                                                     const std::uint64_t* excluded) {
+  const auto r0 = static_cast<long long>(required[0]);
+  const auto r1 = static_cast<long long>(required[1]);
+  const auto x0 = static_cast<long long>(excluded[0]);
+  const auto x1 = static_cast<long long>(excluded[1]);
+  const __m256i req = _mm256_setr_epi64x(r0, r1, r0, r1);
+  const __m256i exc = _mm256_setr_epi64x(x0, x1, x0, x1);
+  const __m256i zero = _mm256_setzero_si256();
+  std::uint64_t bits = 0;
+  for (std::size_t i = 0; i < 64; i += 4) {
+    const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + 2 * i));
+    const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + 2 * i + 4));
+    const __m256i miss_a = _mm256_or_si256(_mm256_andnot_si256(a, req), _mm256_and_si256(a, exc));
+    const __m256i miss_b = _mm256_or_si256(_mm256_andnot_si256(b, req), _mm256_and_si256(b, exc));
+    // Signatures i, i+2, i+1, i+3; the permute restores their order.
+    const __m256i miss = _mm256_or_si256(_mm256_unpacklo_epi64(miss_a, miss_b), _mm256_unpackhi_epi64(miss_a, miss_b));
+    const __m256i ok = _mm256_cmpeq_epi64(_mm256_permute4x64_epi64(miss, 0xD8), zero);
+    bits |= static_cast<std::uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(ok))) << i;
+  }
+  return bits;
+}
+
+__attribute__((target("avx512f"))) inline std::uint64_t match_word_avx512(const std::uint64_t* words,
+                                                                          const std::uint64_t* required,
+                                                                          const std::uint64_t* excluded) {
+  const auto r0 = static_cast<long long>(required[0]);
+  const auto r1 = static_cast<long long>(required[1]);
+  const auto x0 = static_cast<long long>(excluded[0]);
+  const auto x1 = static_cast<long long>(excluded[1]);
+  const __m512i req = _mm512_setr_epi64(r0, r1, r0, r1, r0, r1, r0, r1);
+  const __m512i exc = _mm512_setr_epi64(x0, x1, x0, x1, x0, x1, x0, x1);
+  // Lanes 0-7 of a, then 8-15 of b: the low and high word of each signature, in order.
+  const __m512i lo = _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, 14);
+  const __m512i hi = _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, 15);
+  std::uint64_t bits = 0;
+  for (std::size_t i = 0; i < 64; i += 8) {
+    const __m512i a = _mm512_loadu_si512(words + 2 * i);
+    const __m512i b = _mm512_loadu_si512(words + 2 * i + 8);
+    // (~sig & req) | (sig & exc) in one instruction.
+    const __m512i miss_a = _mm512_ternarylogic_epi64(a, req, exc, 0xAC);
+    const __m512i miss_b = _mm512_ternarylogic_epi64(b, req, exc, 0xAC);
+    const __m512i miss =
+        _mm512_or_si512(_mm512_permutex2var_epi64(miss_a, lo, miss_b), _mm512_permutex2var_epi64(miss_a, hi, miss_b));
+    const __mmask8 hit = _mm512_testn_epi64_mask(miss, miss);
+    bits |= static_cast<std::uint64_t>(hit) << i;
+  }
+  return bits;
+}
+#endif
+
+} // namespace detail
+
+// Writes the match bits of sigs[0, count) to out[0, (count + 63) / 64), bit i of the result
+// in bit i % 64 of out[i / 64] (bits past `count` are zero), and returns the number of matches.
+// `level` caps the kernel used (benchmarks); the CPU's own limit always applies.
+template <std::size_t MaxC>
+std::size_t match_signatures(const Signature<MaxC>* sigs, std::size_t count, const Signature<MaxC>& required,
+                             const Signature<MaxC>& excluded, std::uint64_t* out,
+                             SimdLevel level = cpu_simd_level()) {
+  level = std::min(level, cpu_simd_level());
+  std::size_t matches = 0;
+  std::size_t i = 0;
+#if ECS_LAB_SIMD_DISPATCH
+  if constexpr (Signature<MaxC>::kWordCount == 2 && sizeof(Signature<MaxC>) == 16) {
+    if (level != SimdLevel::kScalar) {
+      for (; i + 64 <= count; i += 64) {
+        const auto* words = reinterpret_cast<const std::uint64_t*>(sigs + i);
+        const std::uint64_t bits = level == SimdLevel::kAvx512
+                                       ? detail::match_word_avx512(words, required.words(), excluded.words())
+                                       : detail::match_word_avx2(words, required.words(), excluded.words());
+        out[i / 64] = bits;
+        matches += static_cast<std::size_t>(std::popcount(bits));
+      }
+    }
+  }
+#endif
+  for (; i < count; i += 64) {
+    const std::size_t n = std::min<std::size_t>(64, count - i);
+    const std::uint64_t bits = detail::match_word_scalar(sigs + i, n, required, excluded);
+    out[i / 64] = bits;
+    matches += static_cast<std::size_t>(std::popcount(bits));
+  }
+  return matches;
+}
+
+} // namespace ecs_lab
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+// Structure-of-arrays storage policy. Specialize with the data members of T to store each of
+// them, and the owner's entity_idx/gen, in its own contiguous per-block array:
+//
+//   template <>
+//   struct soa_fields<Body> {
+//     static constexpr auto members = std::make_tuple(&Body::x, &Body::vx, &Body::mass);
+//   };
+//
+// T must be trivially copyable and default constructible, and the members must cover all of
+// it. SoA components have no T& (World::get returns a SoaRef); iterate them by block with
+// World::each_block.
+template <typename T>
+struct soa_fields {};
+
+template <typename T>
+concept soa_component = requires { soa_fields<T>::members; };
+
+template <typename M>
+struct member_traits;
+
+template <typename C, typename F>
+struct member_traits<F C::*> {
+  using type = F;
+};
+
+// Block-chunked, copy-on-write column storage (same block and sharing rules as DenseArray).
+template <typename T, std::size_t BlockSize = 4096>
+class SoaArray {
+  using Members = std::remove_cvref_t<decltype(soa_fields<T>::members)>;
+
+public:
+  static constexpr std::size_t kBlockSize = BlockSize;
+  static constexpr std::size_t kFields = std::tuple_size_v<Members>;
+  // entity_idx, gen, then one per field.
+  static constexpr std::size_t kColumns = 2 + kFields;
+
+  template <std::size_t I>
+  using Field = typename member_traits<std::tuple_element_t<I, Members>>::type;
+
+  static_assert(std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>,
+                "SoA components must be trivially copyable and default constructible.");
+  static_assert(
+      []<std::size_t... I>(std::index_sequence<I...>) { return (sizeof(Field<I>) + ... + 0) == sizeof(T); }(
+          std::make_index_sequence<kFields>{}),
+      "soa_fields<T>::members must list every data member of T.");
+
+  // Index of `Member` in soa_fields<T>::members.
+  template <auto Member>
+  static constexpr std::size_t index_of() {
+    return []<std::size_t... I>(std::index_sequence<I...>) {
+      std::size_t out = kFields;
+      ((matches<Member, I>() ? (out = I, true) : false) || ...);
+      return out;
+    }(std::make_index_sequence<kFields>{});
+  }
+
+private:
+  template <typename F>
+  struct alignas(64) Column {
+    F data[BlockSize];
+  };
+
+  template <typename Seq>
+  struct ColumnsOf;
+  template <std::size_t... I>
+  struct ColumnsOf<std::index_sequence<I...>> {
+    using type = std::tuple<Column<Field<I>>...>;
+  };
+
+  struct Block {
+    Block() {}
+    Block(const Block&) = delete;
+    Block& operator=(const Block&) = delete;
+
+    // Rows [0, count) are in use.
+    std::size_t count = 0;
+    Column<std::uint32_t> entity_idx;
+    Column<std::uint32_t> gen;
+    typename ColumnsOf<std::make_index_sequence<kFields>>::type fields;
+  };
+
+public:
+  // Rows of one block as parallel columns, each size() long. Field spans are what SIMD kernels
+  // (or the auto-vectorizer) should loop over.
+  template <bool Const>
+  class BlockViewT {
+  public:
+    template <typename F>
+    using Span = std::span<std::conditional_t<Const, const F, F>>;
+
+    std::size_t size() const { return entity_idx.size(); }
+
+    template <auto Member>
+    Span<Field<index_of<Member>()>> field() const {
+      static_assert(index_of<Member>() < kFields, "Member is not listed in soa_fields<T>.");
+      return std::get<index_of<Member>()>(columns_);
+    }
+
+    std::span<const std::uint32_t> entity_idx;
+    std::span<const std::uint32_t> gen;
+
+  private:
+    friend class SoaArray;
+
+    template <std::size_t... I>
+    static std::tuple<Span<Field<I>>...> columns_type(std::index_sequence<I...>);
+
+    decltype(columns_type(std::make_index_sequence<kFields>{})) columns_;
+  };
+
+  using BlockView = BlockViewT<false>;
+  using ConstBlockView = BlockViewT<true>;
+
+  // Blocks that differ from a base array (see diff/patch); block granularity only.
+  struct Delta {
+    std::size_t size = 0;
+    std::size_t block_total = 0;
+    std::vector<std::size_t> index;
+    std::vector<std::shared_ptr<Block>> blocks;
+  };
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  std::size_t block_count() const { return (size_ + BlockSize - 1) / BlockSize; }
+  std::size_t block_rows(std::size_t block_idx) const { return std::min(BlockSize, size_ - block_idx * BlockSize); }
+  std::size_t capacity() const { return blocks_.size() * BlockSize; }
+
+  std::size_t emplace_back(std::uint32_t entity_idx, std::uint32_t gen, const T& value) {
+    const std::size_t idx = size_;
+    if (idx / BlockSize >= blocks_.size()) {
+      blocks_.push_back(std::make_shared<Block>());
+    }
+    Block& block = writable_block(idx / BlockSize);
+    const std::size_t off = idx % BlockSize;
+    block.entity_idx.data[off] = entity_idx;
+    block.gen.data[off] = gen;
+    store_row(block, off, value, std::make_index_sequence<kFields>{});
+    ++block.count;
+    ++size_;
+    return idx;
+  }
+
+  void pop_back() {
+    if (size_ == 0) {
+      return;
+    }
+    --size_;
+    --writable_block(size_ / BlockSize).count;
+  }
+
+  // Drops every row. Shared blocks are released rather than copied.
+  void clear() {
+    blocks_.clear();
+    size_ = 0;
+  }
+
+  void reserve(std::size_t count) {
+    const std::size_t blocks = (count + BlockSize - 1) / BlockSize;
+    blocks_.reserve(blocks);
+    while (blocks_.size() < blocks) {
+      blocks_.push_back(std::make_shared<Block>());
+    }
+  }
+
+  // Gathers row `idx` into a T.
+  T load(std::size_t idx) const {
+    T out;
+    load_row(*blocks_[idx / BlockSize], idx % BlockSize, out, std::make_index_sequence<kFields>{});
+    return out;
+  }
+
+  // Scatters `value` into row `idx`.
+  void store(std::size_t idx, const T& value) {
+    store_row(writable_block(idx / BlockSize), idx % BlockSize, value, std::make_index_sequence<kFields>{});
+  }
+
+  std::uint32_t entity_idx(std::size_t idx) const { return blocks_[idx / BlockSize]->entity_idx.data[idx % BlockSize]; }
+  std::uint32_t gen(std::size_t idx) const { return blocks_[idx / BlockSize]->gen.data[idx % BlockSize]; }
+
+  template <auto Member>
+  Field<index_of<Member>()>& field(std::size_t idx) {
+    return std::get<index_of<Member>()>(writable_block(idx / BlockSize).fields).data[idx % BlockSize];
+  }
+
+  template <auto Member>
+  const Field<index_of<Member>()>& field(std::size_t idx) const {
+    return std::get<index_of<Member>()>(blocks_[idx / BlockSize]->fields).data[idx % BlockSize];
+  }
+
+  // Copies every column of row `src` over row `dst` (swap-erase).
+  void move_row(std::size_t dst, std::size_t src) {
+    const Block& from = *blocks_[src / BlockSize];
+    Block& to = writable_block(dst / BlockSize);
+    for (std::size_t c = 0; c < kColumns; ++c) {
+      const std::size_t bytes = column_bytes(c);
+      std::memcpy(static_cast<char*>(column_ptr(to, c)) + dst % BlockSize * bytes,
+                  static_cast<const char*>(column_ptr(from, c)) + src % BlockSize * bytes, bytes);
+    }
+  }
+
+  BlockView block(std::size_t block_idx) {
+    Block& block = writable_block(block_idx);
+    return make_view<false>(block, block_rows(block_idx), std::make_index_sequence<kFields>{});
+  }
+
+  ConstBlockView block(std::size_t block_idx) const {
+    return make_view<true>(*blocks_[block_idx], block_rows(block_idx), std::make_index_sequence<kFields>{});
+  }
+
+  // Raw column access for loaders/savers: column `c` of block `block_idx`, column_bytes(c) per row.
+  static constexpr std::size_t column_bytes(std::size_t c) {
+    std::size_t out = sizeof(std::uint32_t);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((c == 2 + I ? (out = sizeof(Field<I>), true) : false) || ...);
+    }(std::make_index_sequence<kFields>{});
+    return out;
+  }
+
+  const void* column_data(std::size_t block_idx, std::size_t c) const { return column_ptr(*blocks_[block_idx], c); }
+  void* column_data(std::size_t block_idx, std::size_t c) { return column_ptr(writable_block(block_idx), c); }
+
+  // Appends a block of `count` rows for the caller to fill column by column. Requires a
+  // block-aligned size().
+  void append_block(std::size_t count) {
+    blocks_.resize(size_ / BlockSize);
+    auto block = std::make_shared<Block>();
+    block->count = count;
+    blocks_.push_back(std::move(block));
+    size_ += count;
+  }
+
+  Delta diff(const SoaArray& base) const {
+    Delta out;
+    out.size = size_;
+    out.block_total = blocks_.size();
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      if (b < base.blocks_.size() && blocks_[b] == base.blocks_[b]) {
+        continue;
+      }
+      out.index.push_back(b);
+      out.blocks.push_back(blocks_[b]);
+    }
+    return out;
+  }
+
+  void patch(const SoaArray& base, const Delta& delta) {
+    blocks_.assign(base.blocks_.begin(),
+                   base.blocks_.begin() + static_cast<std::ptrdiff_t>(std::min(base.blocks_.size(), delta.block_total)));
+    blocks_.resize(delta.block_total);
+    for (std::size_t i = 0; i < delta.index.size(); ++i) {
+      blocks_[delta.index[i]] = delta.blocks[i];
+    }
+    size_ = delta.size;
+  }
+
+  static std::size_t delta_bytes(const Delta& delta) { return delta.blocks.size() * sizeof(Block); }
+  static std::size_t delta_blocks(const Delta& delta) { return delta.blocks.size(); }
+
+  bool is_shared(std::size_t block_idx) const { return blocks_[block_idx].use_count() > 1; }
+
+  std::size_t exclusive_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& block : blocks_) {
+      bytes += block.use_count() == 1 ? sizeof(Block) : 0;
+    }
+    return bytes;
+  }
+
+  void unshare() {
+    for (std::size_t b = 0; b < blocks_.size(); ++b) {
+      writable_block(b);
+    }
+  }
+
+private:
+  template <auto Member, std::size_t I>
+  static constexpr bool matches() {
+    if constexpr (std::is_same_v<decltype(Member), std::tuple_element_t<I, Members>>) {
+      return Member == std::get<I>(soa_fields<T>::members);
+    } else {
+      return false;
+    }
+  }
+
+  template <std::size_t... I>
+  static void store_row(Block& block, std::size_t off, const T& value, std::index_sequence<I...>) {
+    // memcpy so array members work too.
+    (std::memcpy(&std::get<I>(block.fields).data[off], &(value.*std::get<I>(soa_fields<T>::members)), sizeof(Field<I>)),
+     ...);
+  }
+
+  template <std::size_t... I>
+  static void load_row(const Block& block, std::size_t off, T& out, std::index_sequence<I...>) {
+    (std::memcpy(&(out.*std::get<I>(soa_fields<T>::members)), &std::get<I>(block.fields).data[off], sizeof(Field<I>)),
+     ...);
+  }
+
+  template <bool Const, typename B, std::size_t... I>
+  static BlockViewT<Const> make_view(B& block, std::size_t rows, std::index_sequence<I...>) {
+    BlockViewT<Const> view;
+    view.entity_idx = std::span<const std::uint32_t>(block.entity_idx.data, rows);
+    view.gen = std::span<const std::uint32_t>(block.gen.data, rows);
+    view.columns_ = std::make_tuple(typename BlockViewT<Const>::template Span<Field<I>>(
+        std::get<I>(block.fields).data, rows)...);
+    return view;
+  }
+
+  template <typename B>
+  static auto* column_ptr(B& block, std::size_t c) {
+    using Ptr = std::conditional_t<std::is_const_v<B>, const void*, void*>;
+    Ptr out = c == 0 ? Ptr(block.entity_idx.data) : Ptr(block.gen.data);
+    [&]<std::size_t... I>(std::index_sequence<I...>) {
+      ((c == 2 + I ? (out = std::get<I>(block.fields).data, true) : false) || ...);
+    }(std::make_index_sequence<kFields>{});
+    return out;
+  }
+
+  // Returns block `block_idx`, copying its used rows first if another array still references it.
+  Block& writable_block(std::size_t block_idx) {
+    auto& block = blocks_[block_idx];
+    if (block.use_count() > 1) {
+      auto copy = std::make_shared<Block>();
+      copy->count = block->count;
+      for (std::size_t c = 0; c < kColumns; ++c) {
+        std::memcpy(column_ptr(*copy, c), column_ptr(std::as_const(*block), c), block->count * column_bytes(c));
+      }
+      block = std::move(copy);
+    }
+    return *block;
+  }
+
+  std::vector<std::shared_ptr<Block>> blocks_;
+  std::size_t size_ = 0;
+};
+
+template <typename T>
+using SoaBlock = typename SoaArray<T>::BlockView;
+
+// One row of a SoA pool: what World::get/add return for SoA components. Like a T&, it is valid
+// until the pool's next structural change. Gather with load(), scatter with store() or =, or
+// reach a single column element with field<&T::member>().
+template <typename T>
+class SoaRef {
+public:
+  SoaRef(SoaArray<T>& array, std::size_t row)
+      : array_(&array), row_(row) {}
+
+  SoaRef(const SoaRef&) = default;
+  SoaRef& operator=(const SoaRef&) = delete;
+
+  T load() const { return array_->load(row_); }
+  operator T() const { return load(); }
+
+  void store(const T& value) const { array_->store(row_, value); }
+  const SoaRef& operator=(const T& value) const {
+    store(value);
+    return *this;
+  }
+
+  template <auto Member>
+  auto& field() const {
+    return array_->template field<Member>(row_);
+  }
+
+private:
+  SoaArray<T>* array_ = nullptr;
+  std::size_t row_ = 0;
+};
+
+} // namespace ecs_lab
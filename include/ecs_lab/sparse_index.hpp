@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ecs_lab/ecs_types.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ecs_lab {
+
+// Paged map from entity_idx to a pool row (kInvalidIndex if none). Pages are allocated on
+// first write and, like DenseArray blocks, shared copy-on-write between copies, so copying an
+// index is O(pages).
+class SparseIndex {
+public:
+  static constexpr std::size_t kPageSize = 4096;
+
+  DenseIndex get(std::uint32_t entity_idx) const {
+    const std::size_t page = entity_idx / kPageSize;
+    if (page >= pages_.size() || !pages_[page]) {
+      return kInvalidIndex;
+    }
+    return pages_[page]->rows[entity_idx % kPageSize];
+  }
+
+  void set(std::uint32_t entity_idx, DenseIndex di) {
+    writable_page(entity_idx / kPageSize).rows[entity_idx % kPageSize] = di;
+  }
+
+  void reset(std::uint32_t entity_idx) {
+    const std::size_t page = entity_idx / kPageSize;
+    if (page < pages_.size() && pages_[page]) {
+      writable_page(page).rows[entity_idx % kPageSize] = kInvalidIndex;
+    }
+  }
+
+  void clear() { pages_.clear(); }
+
+  // Entries that map to a row (O(pages * kPageSize); for checks).
+  std::size_t count() const {
+    std::size_t n = 0;
+    for (const auto& page : pages_) {
+      if (page) {
+        n += static_cast<std::size_t>(
+            std::count_if(page->rows, page->rows + kPageSize, [](DenseIndex di) { return di != kInvalidIndex; }));
+      }
+    }
+    return n;
+  }
+
+  // Bytes of pages `base` does not share with this index.
+  std::size_t bytes_not_in(const SparseIndex& base) const {
+    std::size_t bytes = 0;
+    for (std::size_t p = 0; p < pages_.size(); ++p) {
+      if (pages_[p] && (p >= base.pages_.size() || pages_[p] != base.pages_[p])) {
+        bytes += sizeof(Page);
+      }
+    }
+    return bytes;
+  }
+
+  // Bytes of pages no other index references (see DenseArray::exclusive_bytes).
+  std::size_t exclusive_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& page : pages_) {
+      bytes += page && page.use_count() == 1 ? sizeof(Page) : 0;
+    }
+    return bytes;
+  }
+
+private:
+  struct Page {
+    Page() { std::fill(rows, rows + kPageSize, kInvalidIndex); }
+    DenseIndex rows[kPageSize];
+  };
+
+  // Returns page `page`, creating it or copying it first if another index still references it.
+  Page& writable_page(std::size_t page) {
+    if (page >= pages_.size()) {
+      pages_.resize(page + 1);
+    }
+    auto& p = pages_[page];
+    if (!p) {
+      p = std::make_shared<Page>();
+    } else if (p.use_count() > 1) {
+      p = std::make_shared<Page>(*p);
+    }
+    return *p;
+  }
+
+  std::vector<std::shared_ptr<Page>> pages_;
+};
+
+} // namespace ecs_lab
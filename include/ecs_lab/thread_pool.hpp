@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ecs_lab {
+
+// Work-stealing worker pool used by parallel iteration and the system scheduler.
+// Each worker owns a deque: tasks submitted from a worker go to its own deque
+// (popped LIFO by the owner), tasks submitted from other threads go to a shared
+// injection queue, and idle workers steal FIFO from other deques.
+// Threads that wait on pool work (parallel_for, Scheduler::run) execute pending
+// tasks while waiting, so nested parallel_for from inside a task is fine.
+class ThreadPool {
+public:
+  explicit ThreadPool(std::size_t workers = default_workers()) {
+    queues_.reserve(workers + 1);
+    for (std::size_t i = 0; i < workers + 1; ++i) {
+      queues_.push_back(std::make_unique<Queue>());
+    }
+    threads_.reserve(workers);
+    for (std::size_t i = 0; i < workers; ++i) {
+      threads_.emplace_back([this, i] { worker_loop(i); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  std::size_t worker_count() const { return threads_.size(); }
+
+  // Process-wide pool sized to hardware_concurrency() - 1 workers.
+  static ThreadPool& shared() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  static std::size_t default_workers() {
+    const unsigned hw = std::thread::hardware_concurrency();
+    return hw > 1 ? static_cast<std::size_t>(hw - 1) : 0;
+  }
+
+  void submit(std::function<void()> task) {
+    Queue& q = *queues_[local_queue()];
+    // Count first so pending_ never underflows when a thief takes the task right away.
+    pending_.fetch_add(1, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(q.mutex);
+      q.tasks.push_back(std::move(task));
+    }
+    {
+      // Pairs with the predicate check in worker_loop so the wakeup cannot be lost.
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+    }
+    cv_.notify_one();
+  }
+
+  // Runs one pending task on the calling thread, if any. Returns false if none was found.
+  bool try_run_one() {
+    std::function<void()> task;
+    if (!take(local_queue(), task)) {
+      return false;
+    }
+    pending_.fetch_sub(1, std::memory_order_acq_rel);
+    task();
+    return true;
+  }
+
+  // Helps executing pool tasks until done() returns true.
+  template <typename Pred>
+  void wait_until(Pred&& done) {
+    while (!done()) {
+      if (!try_run_one()) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  // Calls fn(i) for every i in [0, count), distributing indices dynamically.
+  // Blocks (helping with other pool work) until all calls returned.
+  template <typename Fn>
+  void parallel_for(std::size_t count, Fn&& fn) {
+    if (count == 0) {
+      return;
+    }
+    const std::size_t helpers = std::min(threads_.size(), count - 1);
+    if (helpers == 0) {
+      for (std::size_t i = 0; i < count; ++i) {
+        fn(i);
+      }
+      return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    auto body = [&] {
+      for (;;) {
+        const std::size_t i = next.fetch_add(1, std::memory_order_relaxed);
+        if (i >= count) {
+          return;
+        }
+        fn(i);
+      }
+    };
+
+    std::atomic<std::size_t> running{helpers};
+    for (std::size_t h = 0; h < helpers; ++h) {
+      submit([&] {
+        body();
+        running.fetch_sub(1, std::memory_order_release);
+      });
+    }
+    body();
+    wait_until([&] { return running.load(std::memory_order_acquire) == 0; });
+  }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  // Index of the calling thread's deque; non-worker threads share the injection queue.
+  std::size_t local_queue() const {
+    if (tls_pool_ == this) {
+      return tls_index_;
+    }
+    return threads_.size();
+  }
+
+  bool take(std::size_t self, std::function<void()>& out) {
+    {
+      Queue& own = *queues_[self];
+      std::lock_guard<std::mutex> lock(own.mutex);
+      if (!own.tasks.empty()) {
+        out = std::move(own.tasks.back());
+        own.tasks.pop_back();
+        return true;
+      }
+    }
+    const std::size_t n = queues_.size();
+    for (std::size_t k = 1; k < n; ++k) {
+      Queue& victim = *queues_[(self + k) % n];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty()) {
+        out = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void worker_loop(std::size_t index) {
+    tls_pool_ = this;
+    tls_index_ = index;
+    for (;;) {
+      if (try_run_one()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      cv_.wait(lock, [this] { return stop_ || pending_.load(std::memory_order_acquire) > 0; });
+      if (stop_ && pending_.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+    }
+  }
+
+  inline static thread_local const ThreadPool* tls_pool_ = nullptr;
+  inline static thread_local std::size_t tls_index_ = 0;
+
+  // queues_[i] belongs to worker i; the last one is the injection queue.
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<std::size_t> pending_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+} // namespace ecs_lab
@@ -1,7 +1,14 @@
 #pragma once
 
 #include "ecs_lab/arena.hpp"
+#include "ecs_lab/command_buffer.hpp"
+#include "ecs_lab/event_stream.hpp"
+#include "ecs_lab/group.hpp"
+#include "ecs_lab/hierarchy.hpp"
 #include "ecs_lab/pool.hpp"
+#include "ecs_lab/query_filter.hpp"
+#include "ecs_lab/scheduler.hpp"
+#include "ecs_lab/thread_pool.hpp"
 
 #include <algorithm>
 #include <array>
@@ -10,7 +17,11 @@
 #include <cstdint>
 #include <memory>
 #include <memory_resource>
+#include <optional>
+#include <span>
+#include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -18,15 +29,57 @@ namespace ecs_lab {
 
 class EntityProxy;
 class EntityProxyRef;
+class AsyncSave;
 
 template <typename T>
 struct QueryAccess {
+  static_assert(!Pool<T>::kSoa, "Queries hand out T&; SoA components use World::each_block.");
   ComponentId cid = 0;
   Pool<T>* pool = nullptr;
 };
 
+// A Changed<T> (kAdded = false) or Added<T> term of a QueryFilter.
+template <typename T, bool kAdded>
+struct TickAccess {
+  using type = T;
+  ComponentId cid = 0;
+  Pool<T>* pool = nullptr;
+
+  static Tick row_tick(const Component<T>& comp) {
+    return kAdded ? comp.ticks.added : comp.ticks.changed;
+  }
+
+  Tick block_tick(std::size_t block_idx) const {
+    const RowTicks ticks = pool->block_ticks(block_idx);
+    return kAdded ? ticks.added : ticks.changed;
+  }
+};
+
+// An incremental reorder of T's pool (World::begin_sort / begin_sort_like): the target order is
+// planned up front as owner handles and applied a few blocks at a time by World::sort_step.
+template <typename T>
+class PoolSort {
+public:
+  bool done() const {
+    return next_ >= plan_.size();
+  }
+
+  // Planned rows not yet placed.
+  std::size_t remaining() const {
+    return plan_.size() - next_;
+  }
+
+private:
+  friend class World;
+
+  std::vector<EntityLink> plan_;
+  std::size_t next_ = 0;
+  // Row the next planned owner moves to.
+  DenseIndex row_ = 0;
+};
+
 template <typename T>
-T& query_get(EntityMeta& meta, const QueryAccess<T>& access) {
+T& query_get(ConstEntityMeta meta, const QueryAccess<T>& access) {
   assert(access.pool != nullptr);
   const std::size_t pos = meta.sig.rank(access.cid);
   assert(pos < meta.idx.size());
@@ -36,10 +89,12 @@ T& query_get(EntityMeta& meta, const QueryAccess<T>& access) {
 
 class World {
 public:
+  // Copy-on-write view of a World: arena and pool blocks are shared with the World (and with
+  // other snapshots) until one side writes to them. Taking and restoring a snapshot is
+  // O(blocks); memory overhead grows with the number of blocks written afterwards.
   struct Snapshot {
     Snapshot()
-        : idx_resource(std::make_unique<std::pmr::unsynchronized_pool_resource>()),
-          arena(idx_resource.get()) {
+        : arena(nullptr) {
       pools.resize(kMaxComponents);
     }
 
@@ -48,14 +103,45 @@ public:
     Snapshot(const Snapshot&) = delete;
     Snapshot& operator=(const Snapshot&) = delete;
 
-    std::unique_ptr<std::pmr::unsynchronized_pool_resource> idx_resource;
     LinearArena arena;
     std::vector<std::unique_ptr<IPool>> pools;
     std::uint64_t next_entity_id = 0;
+    // Entities whose shared meta still points at a proxy of the source World.
+    std::vector<std::uint32_t> proxied;
+  };
+
+  // Difference between a Snapshot (the base) and the World at snapshot_delta() time: the arena
+  // and pool blocks written since the base, shared copy-on-write like a Snapshot's. Created and
+  // destroyed entities and signature/idx changes are carried by the dirty arena blocks.
+  struct Delta {
+    LinearArena::Delta arena;
+    // Indexed by component id; nullptr = pool unchanged since the base (or absent, see `present`).
+    std::vector<std::unique_ptr<IPoolDelta>> pools;
+    Signature<kMaxComponents> present{};
+    std::uint64_t next_entity_id = 0;
+    std::vector<std::uint32_t> proxied;
+
+    std::size_t dirty_blocks() const {
+      std::size_t count = LinearArena::delta_blocks(arena);
+      for (const auto& pool : pools) {
+        count += pool ? pool->dirty_blocks() : 0;
+      }
+      return count;
+    }
+
+    // Storage kept alive by the delta beyond what the base already holds (idx vectors excluded).
+    std::size_t dirty_bytes() const {
+      std::size_t bytes = LinearArena::delta_bytes(arena);
+      for (const auto& pool : pools) {
+        bytes += pool ? pool->dirty_bytes() : 0;
+      }
+      return bytes;
+    }
   };
 
   World()
-      : arena_(&idx_resource_) {
+      : idx_resource_(std::make_shared<std::pmr::unsynchronized_pool_resource>()),
+        arena_(idx_resource_) {
     pools_.resize(kMaxComponents);
   }
 
@@ -67,7 +153,7 @@ public:
 
   Entity create() {
     const std::uint32_t idx = arena_.alloc();
-    auto& meta = arena_.at(idx);
+    auto meta = arena_.at(idx);
     meta.entity_id = ++next_entity_id_;
     meta.entity_idx = idx;
     meta.gen = (meta.gen & kGenMask) | kGenAliveBit;
@@ -77,20 +163,31 @@ public:
   }
 
   void destroy(Entity e) {
-    auto* meta = validate(e);
+    auto meta = validate(e);
     if (!meta) {
       return;
     }
 
     invalidate_proxy_all(*meta);
+    groups_leave_all(*meta);
+    if (in_hierarchy(*meta)) {
+      hierarchy_unlink(*meta);
+    }
 
+    const bool watched = remove_watched_.intersects(meta->sig);
     std::size_t i = 0;
     meta->sig.for_each_set_bit([&](ComponentId cid) {
       const DenseIndex di = meta->idx[i++];
       if (cid < pools_.size() && pools_[cid]) {
+        if (watched && remove_watched_.test(cid)) {
+          emit_removed(*meta, cid, di);
+        }
         pools_[cid]->erase_dense(di, *this);
       }
     });
+    if (destroy_events_) {
+      destroy_events_->push(e);
+    }
 
     meta->sig.clear();
     meta->idx.clear();
@@ -99,7 +196,46 @@ public:
   }
 
   bool is_alive(Entity e) const {
-    return validate_const(e) != nullptr;
+    return live_handle(e.entity_idx, e.gen) && arena_.entity_id(e.entity_idx) == e.entity_id;
+  }
+
+  // Checks the invariant iteration relies on instead of re-validating rows: every live pool row
+  // belongs to a live entity whose idx entry points back at it, every idx entry names such a
+  // row, and sparse indexes agree with their pools. O(entities + components); meant for tests
+  // and debug builds, where each/par_each/query also assert the row half as they go.
+  bool verify_pools() const {
+    std::vector<std::size_t> owned(pools_.size(), 0);
+    for (std::uint32_t entity_idx = 0; entity_idx < arena_.size(); ++entity_idx) {
+      const auto meta = meta_at(entity_idx);
+      if ((meta.gen & kGenAliveBit) == 0) {
+        continue;
+      }
+      if (meta.idx.size() != meta.sig.popcount()) {
+        return false;
+      }
+      bool ok = true;
+      std::size_t pos = 0;
+      meta.sig.for_each_set_bit([&](ComponentId cid) {
+        const DenseIndex di = meta.idx[pos++];
+        std::uint32_t owner_idx = 0;
+        std::uint32_t owner_gen = 0;
+        if (cid >= pools_.size() || !pools_[cid] || !pools_[cid]->row_owner(di, owner_idx, owner_gen) ||
+            owner_idx != entity_idx || owner_gen != meta.gen) {
+          ok = false;
+          return;
+        }
+        ++owned[cid];
+      });
+      if (!ok) {
+        return false;
+      }
+    }
+    for (std::size_t cid = 0; cid < pools_.size(); ++cid) {
+      if (pools_[cid] && (pools_[cid]->live_rows() != owned[cid] || !pools_[cid]->index_consistent())) {
+        return false;
+      }
+    }
+    return true;
   }
 
   // Reconstruct a full Entity handle (including entity_id) from (entity_idx, gen).
@@ -108,55 +244,70 @@ public:
     if (entity_idx >= arena_.size()) {
       return Entity{};
     }
-    const auto& meta = arena_.at(entity_idx);
+    const auto meta = arena_.at(entity_idx);
     if ((meta.gen & kGenAliveBit) == 0 || meta.gen != gen) {
       return Entity{};
     }
     return Entity{meta.entity_id, entity_idx, gen};
   }
 
+  // Current change tick: add, mutable get, mark_changed and `stamp_changed` iteration stamp
+  // change_ticks<T> rows with it. Starts at 1. try_get* never stamp; call mark_changed after
+  // writing through them. (In par_each callbacks, look up through a const World&: see there.)
+  Tick tick() const {
+    return tick_;
+  }
+
+  // Ends the current tick and returns it; later stamps get a newer one. A system that filters
+  // on Changed/Added sets `filter.since` to the value this returned after its previous run:
+  //   filter.since = last_run; world.query(filter, fn); last_run = world.advance_tick();
+  // Ticks are 32-bit and do not wrap in practice (one advance per system run).
+  Tick advance_tick() {
+    return tick_++;
+  }
+
+  // Stamps e's T as changed (change_ticks<T> components; no-op otherwise or if e lacks T).
+  // For writes made through pointers obtained before, e.g. from a proxy or each_chunk.
+  template <typename T>
+  void mark_changed(Entity e) {
+    if constexpr (Pool<T>::kTracked) {
+      const DenseIndex di = row_of<T>(e);
+      if (di != kInvalidIndex) {
+        get_pool<T>().stamp_changed(di, tick_);
+      }
+    } else {
+      (void)e;
+    }
+  }
+
   template <typename T>
   bool has(Entity e) const {
-    const auto* meta = validate_const(e);
-    if (!meta) {
-      return false;
+    if constexpr (Pool<T>::kSparse) {
+      return row_of<T>(e) != kInvalidIndex;
+    } else {
+      return is_alive(e) && arena_.sig(e.entity_idx).test(component_id<T>());
     }
-    return meta->sig.test(component_id<T>());
   }
 
   template <typename T>
   T* try_get(Entity e) {
-    auto* meta = validate(e);
-    if (!meta) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(e);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const ComponentId cid = component_id<T>();
-    if (!meta->sig.test(cid)) {
-      return nullptr;
-    }
-    const std::size_t pos = meta->sig.rank(cid);
-    const DenseIndex di = meta->idx[pos];
-    auto& pool = get_pool<T>();
-    return &pool.items[di].data;
+    return &get_pool<T>().items[di].data;
   }
 
   // Fast access when you only have (entity_idx, gen).
   // Useful for compact references inside components (idx+gen), without storing entity_id.
   template <typename T>
   T* try_get_idx_gen(std::uint32_t entity_idx, std::uint32_t gen) {
-    if (entity_idx >= arena_.size()) {
-      return nullptr;
-    }
-    auto& meta = arena_.at(entity_idx);
-    if ((meta.gen & kGenAliveBit) == 0 || meta.gen != gen) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(entity_idx, gen);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const ComponentId cid = component_id<T>();
-    if (!meta.sig.test(cid)) {
-      return nullptr;
-    }
-    const std::size_t pos = meta.sig.rank(cid);
-    const DenseIndex di = meta.idx[pos];
     auto* pool = get_pool_if_exists<T>();
     if (!pool) {
       return nullptr;
@@ -166,35 +317,21 @@ public:
 
   template <typename T>
   Component<T>* try_get_component(Entity e) {
-    auto* meta = validate(e);
-    if (!meta) {
-      return nullptr;
-    }
-    const ComponentId cid = component_id<T>();
-    if (!meta->sig.test(cid)) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(e);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const std::size_t pos = meta->sig.rank(cid);
-    const DenseIndex di = meta->idx[pos];
-    auto& pool = get_pool<T>();
-    return &pool.items[di];
+    return &get_pool<T>().items[di];
   }
 
   template <typename T>
   const T* try_get_idx_gen(std::uint32_t entity_idx, std::uint32_t gen) const {
-    if (entity_idx >= arena_.size()) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(entity_idx, gen);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const auto& meta = arena_.at(entity_idx);
-    if ((meta.gen & kGenAliveBit) == 0 || meta.gen != gen) {
-      return nullptr;
-    }
-    const ComponentId cid = component_id<T>();
-    if (!meta.sig.test(cid)) {
-      return nullptr;
-    }
-    const std::size_t pos = meta.sig.rank(cid);
-    const DenseIndex di = meta.idx[pos];
     const auto* pool = get_pool_const<T>();
     if (!pool) {
       return nullptr;
@@ -204,16 +341,11 @@ public:
 
   template <typename T>
   const T* try_get(Entity e) const {
-    const auto* meta = validate_const(e);
-    if (!meta) {
-      return nullptr;
-    }
-    const ComponentId cid = component_id<T>();
-    if (!meta->sig.test(cid)) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(e);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const std::size_t pos = meta->sig.rank(cid);
-    const DenseIndex di = meta->idx[pos];
     const auto* pool = get_pool_const<T>();
     if (!pool) {
       return nullptr;
@@ -223,16 +355,11 @@ public:
 
   template <typename T>
   const Component<T>* try_get_component(Entity e) const {
-    const auto* meta = validate_const(e);
-    if (!meta) {
-      return nullptr;
-    }
-    const ComponentId cid = component_id<T>();
-    if (!meta->sig.test(cid)) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T*; use get<T>, which returns a SoaRef.");
+    const DenseIndex di = row_of<T>(e);
+    if (di == kInvalidIndex) {
       return nullptr;
     }
-    const std::size_t pos = meta->sig.rank(cid);
-    const DenseIndex di = meta->idx[pos];
     const auto* pool = get_pool_const<T>();
     if (!pool) {
       return nullptr;
@@ -240,17 +367,29 @@ public:
     return &pool->items[di];
   }
 
+  // T&, or SoaRef<T> for SoA components.
   template <typename T>
-  T& get(Entity e) {
-    auto* ptr = try_get<T>(e);
-    assert(ptr != nullptr);
-    return *ptr;
+  decltype(auto) get(Entity e) {
+    if constexpr (Pool<T>::kSoa) {
+      const DenseIndex di = row_of<T>(e);
+      assert(di != kInvalidIndex);
+      return SoaRef<T>(get_pool<T>().items, di);
+    } else {
+      const DenseIndex di = row_of<T>(e);
+      assert(di != kInvalidIndex);
+      auto& pool = get_pool<T>();
+      pool.stamp_changed(di, tick_);
+      T* ptr = &pool.items[di].data;
+      return *ptr;
+    }
   }
 
   template <typename T, typename... Args>
-  T& add(Entity e, Args&&... args) {
-    auto* meta = validate(e);
-    assert(meta != nullptr);
+  decltype(auto) add(Entity e, Args&&... args) {
+    static_assert(!std::is_same_v<T, Relationship> || sizeof...(Args) == 0,
+                  "Relationships are linked with set_parent; add<Relationship> only adds a root.");
+    auto meta = validate(e);
+    assert(meta);
     const ComponentId cid = component_id<T>();
     if (meta->sig.test(cid)) {
       return get<T>(e);
@@ -260,14 +399,26 @@ public:
     meta->sig.set(cid);
     auto& pool = get_pool<T>();
     const DenseIndex di = pool.emplace(e.entity_idx, e.gen, std::forward<Args>(args)...);
+    if constexpr (Pool<T>::kTracked) {
+      pool.stamp_added(di, tick_);
+    }
     meta->idx.insert(meta->idx.begin() + static_cast<std::ptrdiff_t>(pos), di);
-    notify_proxy_component_ptr(*meta, cid, &pool.items[di]);
-    return pool.items[di].data;
+    notify_proxy_component_ptr(*meta, cid, pool.component_ptr(di));
+    groups_on_gain(*meta, cid);
+    if (add_watched_.test(cid)) {
+      events_[cid].added->push(e);
+    }
+    // Packed groups may have moved the new row; re-read its slot.
+    if constexpr (Pool<T>::kSoa) {
+      return SoaRef<T>(pool.items, meta->idx[pos]);
+    } else {
+      return (pool.items[meta->idx[pos]].data);
+    }
   }
 
   template <typename T>
   void remove(Entity e) {
-    auto* meta = validate(e);
+    auto meta = validate(e);
     if (!meta) {
       return;
     }
@@ -275,10 +426,19 @@ public:
     if (!meta->sig.test(cid)) {
       return;
     }
+    if constexpr (std::is_same_v<T, Relationship>) {
+      if (in_hierarchy(*meta)) {
+        hierarchy_unlink(*meta);
+      }
+    }
 
+    groups_on_loss(*meta, cid);
     const std::size_t pos = meta->sig.rank(cid);
     const DenseIndex di = meta->idx[pos];
     if (cid < pools_.size() && pools_[cid]) {
+      if (remove_watched_.test(cid)) {
+        emit_removed(*meta, cid, di);
+      }
       pools_[cid]->erase_dense(di, *this);
     }
     meta->idx.erase(meta->idx.begin() + static_cast<std::ptrdiff_t>(pos));
@@ -287,12 +447,13 @@ public:
   }
 
   void add_missing_components(Entity dst, Entity src) {
-    auto* dst_meta = validate(dst);
-    const auto* src_meta = validate_const(src);
+    auto dst_meta = validate(dst);
+    const auto src_meta = validate_const(src);
     if (!dst_meta || !src_meta) {
       return;
     }
 
+    const Signature<kMaxComponents> before = dst_meta->sig;
     std::size_t i = 0;
     src_meta->sig.for_each_set_bit([&](ComponentId cid) {
       const DenseIndex src_di = src_meta->idx[i++];
@@ -304,70 +465,182 @@ public:
       }
       const std::size_t pos = dst_meta->sig.rank(cid);
       dst_meta->sig.set(cid);
-      const DenseIndex di = pools_[cid]->clone_dense(dst_meta->entity_idx, dst_meta->gen, src_di);
+      const DenseIndex di = pools_[cid]->clone_dense(dst_meta->entity_idx, dst_meta->gen, src_di, tick_);
+      if (cid == relationship_cid_) {
+        // The copy would alias the source's links.
+        get_pool<Relationship>().items[di].data = Relationship{};
+      }
       dst_meta->idx.insert(dst_meta->idx.begin() + static_cast<std::ptrdiff_t>(pos), di);
       notify_proxy_component_ptr(*dst_meta, cid, pools_[cid]->component_ptr(di));
+      if (add_watched_.test(cid)) {
+        events_[cid].added->push(dst);
+      }
     });
+    groups_enter_new(*dst_meta, before);
   }
 
+  // Calls fn(Entity, T&) or fn(T&) for every T in pool order. Pool rows always belong to live
+  // entities (see verify_pools), so rows are not re-validated; the arena is only read to build
+  // the Entity, and not at all for fn(T&).
   template <typename T, typename Fn>
   void each(Fn&& fn) {
-    auto& pool = get_pool<T>();
-    const std::size_t count = pool.items.size();
-    for (std::size_t i = 0; i < count; ++i) {
-      auto& comp = pool.items[i];
-      auto& meta = arena_.at(comp.entity_idx);
-      if ((meta.gen & kGenAliveBit) == 0 || meta.gen != comp.gen) {
-        continue;
-      }
-      Entity e{meta.entity_id, comp.entity_idx, comp.gen};
-      fn(e, comp.data);
-    }
+    each_rows<false, T>(fn);
+  }
+
+  // Like each, but stamps every visited row changed (change_ticks<T> components).
+  template <typename T, typename Fn>
+  void each(StampChanged, Fn&& fn) {
+    each_rows<true, T>(fn);
   }
 
+  // Iterates entities that have all of T0, Ts...
+  // The smallest participating pool drives the scan; callback argument order is unchanged.
   template <typename T0, typename... Ts, typename Fn>
   void query(Fn&& fn) {
-    static_assert(are_unique<T0, Ts...>::value, "Query component types must be unique.");
+    query_rows<false, T0, Ts...>(fn);
+  }
 
-    auto* pool0 = get_pool_if_exists<T0>();
-    if (!pool0) {
+  // Like query, but stamps the change_ticks components among T0, Ts... of every visited
+  // entity as changed.
+  template <typename T0, typename... Ts, typename Fn>
+  void query(StampChanged, Fn&& fn) {
+    query_rows<true, T0, Ts...>(fn);
+  }
+
+  // Iterates entities that match `filter`: fn(Entity, With&..., Optional*...), With and
+  // Optional components in term order. The smallest With pool drives the scan, as for query;
+  // with Changed/Added terms the smallest of their pools drives instead, and its blocks with
+  // nothing newer than filter.since are skipped whole.
+  template <typename... Terms, typename Fn>
+  void query(const QueryFilter<Terms...>& filter, Fn&& fn) {
+    filter_query<false>(filter, fn);
+  }
+
+  // Like query(filter, fn), but stamps the change_ticks With components of every visited
+  // entity as changed.
+  template <typename... Terms, typename Fn>
+  void query(const QueryFilter<Terms...>& filter, StampChanged, Fn&& fn) {
+    filter_query<true>(filter, fn);
+  }
+
+  // Parallel each<T>: rows are split across the pool by DenseArray block.
+  // Contract: fn is called concurrently from several threads. It may mutate the
+  // component it is handed and read anything else through a const World&, but must not make
+  // structural changes (create/destroy/add/remove/instantiate/restore) to this World. Only the
+  // iterated pool is unshared up front, so mutable lookups of other components (try_get
+  // included) may race to copy a block shared with a snapshot; mutable get and mark_changed
+  // also stamp change ticks.
+  template <typename T, typename Fn>
+  void par_each(ThreadPool& threads, Fn&& fn) {
+    static_assert(!Pool<T>::kSoa, "par_each hands out T&; SoA components use each_block.");
+    auto* pool = get_pool_if_exists<T>();
+    if (!pool) {
       return;
     }
+    constexpr std::size_t kBlock = DenseArray<Component<T>>::kBlockSize;
+    const std::size_t count = pool->items.size();
+    pool->items.unshare();
+    threads.parallel_for(pool->items.block_count(), [&](std::size_t block) {
+      const std::size_t end = std::min(count, (block + 1) * kBlock);
+      pool->for_each_row(block * kBlock, end, [&](std::size_t i) {
+        auto& comp = pool->items[i];
+        assert(row_owner_live(comp.entity_idx, comp.gen));
+        if constexpr (std::is_invocable_v<Fn&, T&>) {
+          fn(comp.data);
+        } else {
+          Entity e{meta_at(comp.entity_idx).entity_id, comp.entity_idx, comp.gen};
+          fn(e, comp.data);
+        }
+      });
+    });
+  }
 
-    auto access = std::make_tuple(QueryAccess<Ts>{component_id<Ts>(), get_pool_if_exists<Ts>()}...);
-    if constexpr (sizeof...(Ts) > 0) {
-      bool ok = true;
-      std::apply([&](auto&... a) { ok = ((a.pool != nullptr) && ...); }, access);
-      if (!ok) {
-        return;
+  template <typename T, typename Fn>
+  void par_each(Fn&& fn) {
+    par_each<T>(ThreadPool::shared(), std::forward<Fn>(fn));
+  }
+
+  // Calls fn(std::span<Component<T>>) once per pool block, rows in storage order with their
+  // owners in entity_idx/gen. Pool rows always belong to live entities, so unlike each there is
+  // no per-row arena lookup and the callback's loop can be vectorized. Blocks of handle-stable
+  // pools may contain tombstones (gen == 0); blocks with no live row are skipped.
+  template <typename T, typename Fn>
+  void each_chunk(Fn&& fn) {
+    static_assert(!Pool<T>::kSoa, "SoA components use each_block.");
+    auto* pool = get_pool_if_exists<T>();
+    if (!pool) {
+      return;
+    }
+    for (std::size_t b = 0; b < pool->items.block_count(); ++b) {
+      if (!pool->block_empty(b)) {
+        fn(pool->items.block_span(b));
       }
     }
+  }
+
+  // Calls fn(SoaBlock<T>) once per block of a SoA pool: parallel column spans over every row,
+  // with the owners in entity_idx/gen. Blocks shared with a snapshot are copied on the way.
+  template <typename T, typename Fn>
+  void each_block(Fn&& fn) {
+    static_assert(Pool<T>::kSoa, "each_block needs a soa_fields<T> specialization; use each<T>.");
+    auto* pool = get_pool_if_exists<T>();
+    if (!pool) {
+      return;
+    }
+    for (std::size_t b = 0; b < pool->items.block_count(); ++b) {
+      fn(pool->items.block(b));
+    }
+  }
+
+  // Parallel query: the smallest participating pool is split by DenseArray block.
+  // Same contract as par_each.
+  template <typename T0, typename... Ts, typename Fn>
+  void par_query(ThreadPool& threads, Fn&& fn) {
+    static_assert(are_unique<T0, Ts...>::value, "Query component types must be unique.");
+
+    auto access = std::make_tuple(QueryAccess<T0>{component_id<T0>(), get_pool_if_exists<T0>()},
+                                  QueryAccess<Ts>{component_id<Ts>(), get_pool_if_exists<Ts>()}...);
+    bool ok = true;
+    std::apply([&](auto&... a) { ok = ((a.pool != nullptr) && ...); }, access);
+    if (!ok) {
+      return;
+    }
 
     Signature<kMaxComponents> required{};
     required.clear();
     required.set(component_id<T0>());
     (required.set(component_id<Ts>()), ...);
 
-    const std::size_t count = pool0->items.size();
-    for (std::size_t i = 0; i < count; ++i) {
-      auto& comp0 = pool0->items[i];
-      auto& meta = arena_.at(comp0.entity_idx);
-      if ((meta.gen & kGenAliveBit) == 0 || meta.gen != comp0.gen) {
-        continue;
-      }
-      if constexpr (sizeof...(Ts) > 0) {
-        if (!meta.sig.contains_all(required)) {
-          continue;
-        }
-      }
-      Entity e{meta.entity_id, comp0.entity_idx, comp0.gen};
+    constexpr std::size_t kCount = 1 + sizeof...(Ts);
+    std::size_t driver = 0;
+    std::size_t blocks = 0;
+    std::apply(
+        [&](auto&... a) {
+          std::size_t i = 0;
+          std::size_t best = static_cast<std::size_t>(-1);
+          ((a.pool->size() < best ? (best = a.pool->size(), blocks = a.pool->items.block_count(),
+                                           driver = i)
+                                        : 0,
+            ++i),
+           ...);
+        },
+        access);
+
+    std::apply([](auto&... a) { (a.pool->items.unshare(), ...); }, access);
+    threads.parallel_for(blocks, [&](std::size_t block) {
+      query_dispatch<false>(fn, access, required, driver, std::make_index_sequence<kCount>{}, &block);
+    });
+  }
 
-      if constexpr (sizeof...(Ts) == 0) {
-        fn(e, comp0.data);
-      } else {
-        std::apply([&](auto&... a) { fn(e, comp0.data, query_get(meta, a)...); }, access);
-      }
-    }
+  template <typename T0, typename... Ts, typename Fn>
+  void par_query(Fn&& fn) {
+    par_query<T0, Ts...>(ThreadPool::shared(), std::forward<Fn>(fn));
+  }
+
+  // Applies the structural changes recorded in `buffer` and empties it.
+  // Placeholders returned by buffer.create()/instantiate() map to real entities via buffer.resolve().
+  void flush(CommandBuffer& buffer) {
+    buffer.replay(*this);
   }
 
   template <typename... Ts>
@@ -379,11 +652,741 @@ public:
       return e;
     }
 
-    auto& meta = arena_.at(e.entity_idx);
     auto entries = make_prefab_entries(prefab);
     std::sort(entries.begin(), entries.end(),
               [](const PrefabEntry& a, const PrefabEntry& b) { return a.cid < b.cid; });
+    emplace_prefab_entries(arena_.at(e.entity_idx), entries.data(), count);
+    return e;
+  }
+
+  // Creates `count` entities into out[0, count). Arena blocks are reserved up front.
+  void create_n(std::size_t count, std::span<Entity> out) {
+    assert(out.size() >= count);
+    arena_.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = create();
+    }
+  }
+
+  // Instantiates `prefab` `count` times into out[0, count).
+  // Arena and pool capacity are reserved once and the prefab entries are sorted once.
+  template <typename... Ts>
+  void instantiate_n(const Prefab<Ts...>& prefab, std::size_t count, std::span<Entity> out) {
+    static_assert(are_unique<Ts...>::value, "Prefab component types must be unique.");
+    assert(out.size() >= count);
+    arena_.reserve(count);
+    (reserve_pool<Ts>(count), ...);
+
+    auto entries = make_prefab_entries(prefab);
+    std::sort(entries.begin(), entries.end(),
+              [](const PrefabEntry& a, const PrefabEntry& b) { return a.cid < b.cid; });
+    for (std::size_t i = 0; i < count; ++i) {
+      out[i] = create();
+      if constexpr (sizeof...(Ts) > 0) {
+        emplace_prefab_entries(arena_.at(out[i].entity_idx), entries.data(), sizeof...(Ts));
+      }
+    }
+  }
+
+  // Destroys every live entity in `entities` (stale handles and duplicates are ignored).
+  // Erasures are grouped per pool: one virtual dispatch per pool instead of per component.
+  void destroy_batch(std::span<const Entity> entities) {
+    auto& rows = batch_rows_;
+    auto& by_pool = batch_by_pool_;
+    auto& freed = batch_freed_;
+    rows.clear();
+    freed.clear();
+    std::array<std::size_t, kMaxComponents + 1> offsets{};
+
+    for (const Entity e : entities) {
+      auto meta = validate(e);
+      if (!meta) {
+        continue;
+      }
+      invalidate_proxy_all(*meta);
+      groups_leave_all(*meta);
+      // Unlinks before the gen bump: later entities of the batch no longer point at this one.
+      if (in_hierarchy(*meta)) {
+        hierarchy_unlink(*meta);
+      }
+      const bool watched = remove_watched_.intersects(meta->sig);
+      std::size_t i = 0;
+      meta->sig.for_each_set_bit([&](ComponentId cid) {
+        const DenseIndex di = meta->idx[i++];
+        // Rows are still in place: erasure waits for the per-pool pass below.
+        if (watched && remove_watched_.test(cid) && cid < pools_.size() && pools_[cid]) {
+          emit_removed(*meta, cid, di);
+        }
+        rows.emplace_back(cid, di);
+        ++offsets[cid + 1];
+      });
+      if (destroy_events_) {
+        destroy_events_->push(e);
+      }
+      // Dead from here on: duplicates fail validate() and update_moved() skips it.
+      meta->gen = (meta->gen + 1u) & kGenMask;
+      freed.push_back(e.entity_idx);
+    }
+
+    // Counting sort by component id, then one erase_dense_batch call per pool.
+    for (std::size_t c = 0; c < kMaxComponents; ++c) {
+      offsets[c + 1] += offsets[c];
+    }
+    by_pool.resize(rows.size());
+    std::array<std::size_t, kMaxComponents + 1> cursor = offsets;
+    for (const auto& [cid, di] : rows) {
+      by_pool[cursor[cid]++] = di;
+    }
+    for (std::size_t c = 0; c < kMaxComponents; ++c) {
+      const std::size_t begin = offsets[c];
+      const std::size_t end = offsets[c + 1];
+      if (begin != end && c < pools_.size() && pools_[c]) {
+        pools_[c]->erase_dense_batch(by_pool.data() + begin, end - begin, *this);
+      }
+    }
+
+    for (const std::uint32_t idx : freed) {
+      auto meta = arena_.at(idx);
+      meta.sig.clear();
+      meta.idx.clear();
+      arena_.free(idx);
+    }
+  }
+
+  // Blocks become shared, so component pointers handed out earlier (get/try_get/iteration
+  // references) must be re-fetched before writing through them; proxy caches are cleared here.
+  Snapshot snapshot() const {
+    Snapshot snap;
+    snap.next_entity_id = next_entity_id_;
+    clear_proxy_caches(snap.proxied);
+    snap.arena = arena_.clone_with_resource(idx_resource_);
+    snap.pools.resize(pools_.size());
+    for (std::size_t i = 0; i < pools_.size(); ++i) {
+      if (pools_[i]) {
+        snap.pools[i] = pools_[i]->clone();
+      }
+    }
+    return snap;
+  }
+
+  // Takes a snapshot and writes it to `path` from a background thread (defined in
+  // serialize.hpp). The World stays fully usable meanwhile; blocks it writes to are copied.
+  AsyncSave begin_async_save(const std::string& path) const;
+
+  // Records what changed since `base`. Dirty tracking is the copy-on-write itself: add, remove,
+  // destroy and every mutable accessor copy the block they touch, so blocks still identical to
+  // the base's are clean. Read through const paths to keep blocks clean. Cost is O(blocks).
+  Delta snapshot_delta(const Snapshot& base) const {
+    Delta delta;
+    delta.next_entity_id = next_entity_id_;
+    clear_proxy_caches(delta.proxied);
+    delta.arena = arena_.diff(base.arena);
+    delta.pools.resize(pools_.size());
+    for (std::size_t i = 0; i < pools_.size(); ++i) {
+      if (pools_[i]) {
+        delta.present.set(static_cast<ComponentId>(i));
+        delta.pools[i] = pools_[i]->diff(i < base.pools.size() ? base.pools[i].get() : nullptr);
+      }
+    }
+    return delta;
+  }
+
+  // Restores the state `delta` was taken from; `base` must be the snapshot it was taken against.
+  void restore_delta(const Snapshot& base, const Delta& delta) {
+    invalidate_all_proxies();
+    arena_.patch(base.arena, delta.arena);
+    pools_.clear();
+    pools_.resize(kMaxComponents);
+    for (std::size_t i = 0; i < delta.pools.size(); ++i) {
+      if (!delta.present.test(static_cast<ComponentId>(i))) {
+        continue;
+      }
+      const IPool* from = i < base.pools.size() ? base.pools[i].get() : nullptr;
+      if (delta.pools[i]) {
+        pools_[i] = delta.pools[i]->apply(from);
+      } else if (from) {
+        pools_[i] = from->clone();
+      }
+    }
+    clear_restored_proxies(base.proxied);
+    clear_restored_proxies(delta.proxied);
+    next_entity_id_ = delta.next_entity_id;
+    catch_up_tick();
+    for (auto& g : groups_) {
+      g->stale = true;
+    }
+  }
+
+  // Copies every block the pools of `components` still share with a snapshot. par_each,
+  // par_query and Scheduler::run call it before fanning out, so worker threads never race
+  // to copy the same shared block on first write.
+  void unshare(const Signature<kMaxComponents>& components) {
+    components.for_each_set_bit([&](ComponentId cid) {
+      if (cid < pools_.size() && pools_[cid]) {
+        pools_[cid]->unshare();
+      }
+    });
+  }
+
+  void restore(const Snapshot& snap) {
+    // Proxies cache component pointers; restoring invalidates all caches.
+    invalidate_all_proxies();
+    arena_ = snap.arena.clone_with_resource(idx_resource_);
+    clear_restored_proxies(snap.proxied);
+    pools_.clear();
+    pools_.resize(kMaxComponents);
+    for (std::size_t i = 0; i < snap.pools.size(); ++i) {
+      if (snap.pools[i]) {
+        pools_[i] = snap.pools[i]->clone();
+      }
+    }
+    next_entity_id_ = snap.next_entity_id;
+    catch_up_tick();
+    // Groups cache dense indices and pool pointers; rebuild lazily on next use.
+    for (auto& g : groups_) {
+      g->stale = true;
+    }
+  }
+
+  // Registers (on first call) and returns a persistent group of entities that have all of Ts.
+  // The group is kept up to date by add/remove/destroy/instantiate/add_missing_components.
+  template <typename... Ts>
+  QueryGroup<Ts...>& group() {
+    static_assert(are_unique<Ts...>::value, "Group component types must be unique.");
+    for (auto& g : groups_) {
+      if (auto* typed = dynamic_cast<QueryGroup<Ts...>*>(g.get())) {
+        return *typed;
+      }
+    }
+    auto owned = std::make_unique<QueryGroup<Ts...>>(*this);
+    auto& out = *owned;
+    groups_.push_back(std::move(owned));
+    return out;
+  }
+
+  // Opt-in packed storage for a component set: registers (on first call) a PackedGroup that owns
+  // the pools of Ts and keeps matching entities row-aligned at the front of each pool.
+  // has/add/remove/get keep working unchanged; a pool can be owned by at most one packed group.
+  template <typename... Ts>
+  PackedGroup<Ts...>& pack() {
+    static_assert(are_unique<Ts...>::value, "Packed component types must be unique.");
+    for (auto& g : groups_) {
+      if (auto* typed = dynamic_cast<PackedGroup<Ts...>*>(g.get())) {
+        return *typed;
+      }
+    }
+    const ComponentId cids[] = {component_id<Ts>()...};
+    for (const ComponentId cid : cids) {
+      assert(!owned_.test(cid) && "Component pool already owned by another packed group.");
+      owned_.set(cid);
+    }
+    auto owned = std::make_unique<PackedGroup<Ts...>>(*this);
+    auto& out = *owned;
+    groups_.push_back(std::move(owned));
+    return out;
+  }
+
+  // Parent/child links (see Relationship). Makes `child` the first child of `parent`, detaching it
+  // from its current parent; either gets a Relationship if it has none. Returns false, changing
+  // nothing, if either is dead, they are the same entity or `parent` is in `child`'s subtree.
+  // O(depth of parent), plus O(size of child's subtree) when the child's depth changes.
+  bool set_parent(Entity child, Entity parent) {
+    if (!is_alive(child) || !is_alive(parent) || child.entity_idx == parent.entity_idx) {
+      return false;
+    }
+    const EntityLink child_link{child.entity_idx, child.gen};
+    const EntityLink parent_link{parent.entity_idx, parent.gen};
+    for (EntityLink up = parent_link; up;) {
+      if (up.entity_idx == child.entity_idx) {
+        return false;
+      }
+      const auto* rel = std::as_const(*this).try_get_idx_gen<Relationship>(up.entity_idx, up.gen);
+      up = rel ? rel->parent_ : EntityLink{};
+    }
+
+    relationship_cid_ = component_id<Relationship>();
+    // Structural changes first: they may move Relationship rows (packed groups).
+    if (!has<Relationship>(child)) {
+      add<Relationship>(child);
+    }
+    if (!has<Relationship>(parent)) {
+      add<Relationship>(parent);
+    }
+    Relationship& c = relationship_at(child_link);
+    if (c.parent_.entity_idx == parent.entity_idx && c.parent_.gen == parent.gen) {
+      return true;
+    }
+    Relationship& p = relationship_at(parent_link);
+    const std::uint32_t old_depth = c.depth_;
+    unlink_parent(c);
+    c.parent_ = parent_link;
+    c.next_sibling_ = p.first_child_;
+    if (p.first_child_) {
+      relationship_at(p.first_child_).prev_sibling_ = child_link;
+    }
+    p.first_child_ = child_link;
+
+    if (p.depth_ + 1 != old_depth) {
+      set_subtree_depth(child_link, p.depth_ + 1);
+    }
+    hierarchy_reparented(child.entity_idx, &parent.entity_idx);
+    return true;
+  }
+
+  // Detaches `child` from its parent: it becomes a root, keeping its own subtree.
+  void clear_parent(Entity child) {
+    if (!is_alive(child) || !in_hierarchy(meta_at(child.entity_idx))) {
+      return;
+    }
+    const EntityLink child_link{child.entity_idx, child.gen};
+    Relationship& c = relationship_at(child_link);
+    if (!c.parent_) {
+      return;
+    }
+    unlink_parent(c);
+    set_subtree_depth(child_link, 0);
+    hierarchy_reparented(child.entity_idx, nullptr);
+  }
+
+  // Parent of `e`, or Entity{} for roots and entities without a Relationship.
+  Entity parent_of(Entity e) const {
+    const auto* rel = try_get<Relationship>(e);
+    if (!rel || !rel->parent_) {
+      return Entity{};
+    }
+    return resolve_idx_gen(rel->parent_.entity_idx, rel->parent_.gen);
+  }
+
+  // Calls fn(Entity) for each child of `e`, most recently attached first. No structural changes
+  // or reparenting from fn.
+  template <typename Fn>
+  void each_child(Entity e, Fn&& fn) const {
+    const auto* rel = try_get<Relationship>(e);
+    for (EntityLink child = rel ? rel->first_child_ : EntityLink{}; child;) {
+      fn(resolve_idx_gen(child.entity_idx, child.gen));
+      child = try_get_idx_gen<Relationship>(child.entity_idx, child.gen)->next_sibling_;
+    }
+  }
+
+  // Registers (on first call) and returns the depth-ordered storage of T for hierarchy members
+  // (see HierarchyOrder). It owns T's pool, like a packed group.
+  template <typename T>
+  HierarchyOrder<T>& hierarchy() {
+    for (auto& g : groups_) {
+      if (auto* typed = dynamic_cast<HierarchyOrder<T>*>(g.get())) {
+        return *typed;
+      }
+    }
+    const ComponentId cid = component_id<T>();
+    assert(!owned_.test(cid) && "Component pool already owned by another packed group.");
+    owned_.set(cid);
+    relationship_cid_ = component_id<Relationship>();
+    auto owned = std::make_unique<HierarchyOrder<T>>(*this);
+    auto& out = *owned;
+    hierarchies_.push_back(&out);
+    groups_.push_back(std::move(owned));
+    return out;
+  }
+
+  // Event streams for reactive systems, registered on first call (`capacity` only applies then).
+  // on_add<T> records the entity whenever it gains T (add, instantiate, add_missing_components),
+  // on_remove<T> whenever it loses T (remove, destroy, destroy_batch), on_remove_value<T> the
+  // same with the component moved out of its row, and on_destroy every destroyed entity. Handles
+  // are the ones the entity had at the time, so removal and destroy events name dead entities by
+  // the time they are read. Register streams before running the systems that read them; restores
+  // and loads emit nothing. Unwatched components cost one signature bit test per change.
+  static constexpr std::size_t kDefaultEventCapacity = 4096;
+
+  template <typename T>
+  EventStream<Entity>& on_add(std::size_t capacity = kDefaultEventCapacity) {
+    const ComponentId cid = component_id<T>();
+    auto& slot = component_events(cid).added;
+    if (!slot) {
+      slot = std::make_unique<EventStream<Entity>>(capacity);
+      add_watched_.set(cid);
+    }
+    return *slot;
+  }
+
+  template <typename T>
+  EventStream<Entity>& on_remove(std::size_t capacity = kDefaultEventCapacity) {
+    const ComponentId cid = component_id<T>();
+    auto& slot = component_events(cid).removed;
+    if (!slot) {
+      slot = std::make_unique<EventStream<Entity>>(capacity);
+      remove_watched_.set(cid);
+    }
+    return *slot;
+  }
+
+  template <typename T>
+  EventStream<Removed<T>>& on_remove_value(std::size_t capacity = kDefaultEventCapacity) {
+    static_assert(!Pool<T>::kSoa, "SoA components have no T to move out; use on_remove.");
+    const ComponentId cid = component_id<T>();
+    auto& slot = component_events(cid).values;
+    if (!slot) {
+      slot = std::make_unique<RemovedValues<T>>(capacity);
+      remove_watched_.set(cid);
+    }
+    return static_cast<RemovedValues<T>&>(*slot).stream;
+  }
+
+  EventStream<Entity>& on_destroy(std::size_t capacity = kDefaultEventCapacity) {
+    if (!destroy_events_) {
+      destroy_events_ = std::make_unique<EventStream<Entity>>(capacity);
+    }
+    return *destroy_events_;
+  }
+
+  // Closes the tombstone holes of every handle-stable pool (see stable_storage). Live components
+  // move, so pointers into those pools are invalidated: run it at a frame boundary.
+  void compact() {
+    for (auto& pool : pools_) {
+      if (pool) {
+        pool->compact(*this);
+      }
+    }
+  }
+
+  template <typename T>
+  void compact() {
+    if (auto* pool = get_pool_if_exists<T>()) {
+      pool->compact(*this);
+    }
+  }
+
+  // Reorders T's rows by `cmp` (a strict weak order on const T&; equal rows keep their order), so
+  // iteration follows the key. One gather pass moves the rows, then one pass over the moved rows
+  // patches their owners' idx entries, groups and proxy caches. Pointers into T's pool are
+  // invalidated: run it at a frame boundary. Pools owned by a packed group or hierarchy keep
+  // their own order (asserted).
+  template <typename T, typename Compare>
+  void sort(Compare cmp) {
+    auto* pool = sortable_pool<T>();
+    if (!pool) {
+      return;
+    }
+    const auto& order = sorted_rows(*pool, cmp);
+    auto& dest = sort_dest_;
+    dest.resize(order.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      dest[order[i]] = static_cast<DenseIndex>(i);
+    }
+    permute_rows<T>(dest);
+  }
+
+  // Reorders T's rows to follow U's: entities that have both come first, in U's row order, the
+  // others after them in their current order. Queries over T and U then walk both pools (and,
+  // if U is in creation order, the arena) front to back.
+  template <typename T, typename U>
+  void sort_like() {
+    static_assert(!std::is_same_v<T, U>, "sort_like needs two different components.");
+    auto* pool = sortable_pool<T>();
+    const auto* like = get_pool_const<U>();
+    if (!pool || !like) {
+      return;
+    }
+    const ComponentId cid = component_id<T>();
+    auto& dest = sort_dest_;
+    dest.assign(pool->items.size(), kInvalidIndex);
+    DenseIndex next = 0;
+    for (std::size_t di = 0; di < like->items.size(); ++di) {
+      std::uint32_t entity_idx = 0;
+      std::uint32_t gen = 0;
+      if (like->row_owner(static_cast<DenseIndex>(di), entity_idx, gen)) {
+        const DenseIndex row = row_of(entity_idx, gen, cid);
+        if (row != kInvalidIndex) {
+          dest[row] = next++;
+        }
+      }
+    }
+    for (auto& to : dest) {
+      if (to == kInvalidIndex) {
+        to = next++;
+      }
+    }
+    permute_rows<T>(dest);
+  }
+
+  // Incremental sort / sort_like: plans the order now and moves rows into place on each
+  // sort_step. Structural changes between steps are fine: planned entities that lost T are
+  // skipped, rows added since end up after the planned ones, and rows a swap-erase moves into
+  // the already placed front just stay out of order there.
+  template <typename T, typename Compare>
+  PoolSort<T> begin_sort(Compare cmp) {
+    PoolSort<T> sort;
+    if (auto* pool = sortable_pool<T>()) {
+      const auto& items = std::as_const(pool->items);
+      for (const DenseIndex row : sorted_rows(*pool, cmp)) {
+        sort.plan_.push_back(EntityLink{items[row].entity_idx, items[row].gen});
+      }
+    }
+    return sort;
+  }
+
+  template <typename T, typename U>
+  PoolSort<T> begin_sort_like() {
+    static_assert(!std::is_same_v<T, U>, "sort_like needs two different components.");
+    PoolSort<T> sort;
+    const auto* like = get_pool_const<U>();
+    if (!sortable_pool<T>() || !like) {
+      return sort;
+    }
+    const ComponentId cid = component_id<T>();
+    for (std::size_t di = 0; di < like->items.size(); ++di) {
+      std::uint32_t entity_idx = 0;
+      std::uint32_t gen = 0;
+      if (like->row_owner(static_cast<DenseIndex>(di), entity_idx, gen) &&
+          row_of(entity_idx, gen, cid) != kInvalidIndex) {
+        sort.plan_.push_back(EntityLink{entity_idx, gen});
+      }
+    }
+    return sort;
+  }
+
+  // Places the next `blocks` pool blocks' worth of planned rows (one swap and two owner patches
+  // per row out of place). Returns true once the sort is done.
+  template <typename T>
+  bool sort_step(PoolSort<T>& sort, std::size_t blocks = 1) {
+    auto* pool = sortable_pool<T>();
+    if (!pool) {
+      sort.next_ = sort.plan_.size();
+      return true;
+    }
+    const ComponentId cid = component_id<T>();
+    const std::size_t budget = blocks * Pool<T>::kBlockSize;
+    for (std::size_t placed = 0; placed < budget && !sort.done();) {
+      const EntityLink owner = sort.plan_[sort.next_++];
+      const DenseIndex row = row_of(owner.entity_idx, owner.gen, cid);
+      ++placed;
+      // Gone, or moved into the placed rows by a swap-erase since the last step: leave it.
+      if (row == kInvalidIndex || row < sort.row_) {
+        continue;
+      }
+      const DenseIndex to = sort.row_++;
+      if (row != to) {
+        pool->swap_dense(row, to);
+        const auto& items = std::as_const(pool->items);
+        update_moved(row, items[row].entity_idx, items[row].gen, cid);
+        update_moved(to, items[to].entity_idx, items[to].gen, cid);
+      }
+    }
+    return sort.done();
+  }
+
+private:
+  template <typename T>
+  Pool<T>* sortable_pool() {
+    static_assert(!Pool<T>::kStable, "Rows of a handle-stable pool never move.");
+    static_assert(!Pool<T>::kSoa, "sort reorders T rows; SoA pools are not supported.");
+    assert(!owned_.test(component_id<T>()) && "Pools owned by a packed group or hierarchy keep their own order.");
+    return get_pool_if_exists<T>();
+  }
+
+  // Rows of `pool` in `cmp` order (stable).
+  template <typename T, typename Compare>
+  const std::vector<DenseIndex>& sorted_rows(const Pool<T>& pool, Compare& cmp) {
+    const auto& items = pool.items;
+    auto& order = sort_order_;
+    order.resize(items.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+      order[i] = static_cast<DenseIndex>(i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](DenseIndex a, DenseIndex b) { return cmp(items[a].data, items[b].data); });
+    return order;
+  }
+
+  // Moves row r of T's pool to row dest[r] for every r < dest.size(), then patches the owner of
+  // every row that changed hands: its idx entry, the groups that track T and its proxy cache.
+  template <typename T>
+  void permute_rows(std::span<const DenseIndex> dest) {
+    const ComponentId cid = component_id<T>();
+    auto& pool = get_pool<T>();
+    pool.permute(dest);
+    bool grouped = false;
+    for (const auto& g : groups_) {
+      grouped = grouped || (!g->stale && g->required.test(cid));
+    }
+    const auto& items = std::as_const(pool.items);
+    for (std::size_t r = 0; r < dest.size(); ++r) {
+      // Row r has a new owner iff its old owner moved away.
+      if (dest[r] == r) {
+        continue;
+      }
+      const auto di = static_cast<DenseIndex>(r);
+      auto meta = arena_.at(items[di].entity_idx);
+      meta.idx[meta.sig.rank(cid)] = di;
+      if (grouped) {
+        for (auto& g : groups_) {
+          if (!g->stale && g->required.test(cid)) {
+            g->on_moved(meta.entity_idx, cid, di);
+          }
+        }
+      }
+      notify_proxy_component_ptr(meta, cid, pool.component_ptr(di));
+    }
+  }
+
+  // Whether `meta` has a Relationship set_parent may have linked (relationship_cid_ is set by
+  // the first set_parent / hierarchy call; before that no entity has links).
+  bool in_hierarchy(ConstEntityMeta meta) const {
+    return relationship_cid_ < kMaxComponents && meta.sig.test(relationship_cid_);
+  }
+
+  // Links always name live entities: destroy and remove<Relationship> unlink first.
+  Relationship& relationship_at(EntityLink link) {
+    auto* rel = try_get_idx_gen<Relationship>(link.entity_idx, link.gen);
+    assert(rel != nullptr);
+    return *rel;
+  }
+
+  void unlink_parent(Relationship& rel) {
+    if (!rel.parent_) {
+      return;
+    }
+    if (rel.prev_sibling_) {
+      relationship_at(rel.prev_sibling_).next_sibling_ = rel.next_sibling_;
+    } else {
+      relationship_at(rel.parent_).first_child_ = rel.next_sibling_;
+    }
+    if (rel.next_sibling_) {
+      relationship_at(rel.next_sibling_).prev_sibling_ = rel.prev_sibling_;
+    }
+    rel.parent_ = EntityLink{};
+    rel.next_sibling_ = EntityLink{};
+    rel.prev_sibling_ = EntityLink{};
+  }
+
+  void set_subtree_depth(EntityLink root, std::uint32_t depth) {
+    auto& stack = hierarchy_stack_;
+    stack.clear();
+    stack.emplace_back(root, depth);
+    while (!stack.empty()) {
+      const auto [link, d] = stack.back();
+      stack.pop_back();
+      Relationship& rel = relationship_at(link);
+      rel.depth_ = d;
+      for (EntityLink child = rel.first_child_; child; child = relationship_at(child).next_sibling_) {
+        stack.emplace_back(child, d + 1);
+      }
+    }
+  }
+
+  // `meta` is about to lose its Relationship (remove / destroy): it leaves its parent's child list
+  // and its children become roots.
+  void hierarchy_unlink(ConstEntityMeta meta) {
+    Relationship& rel = relationship_at(EntityLink{meta.entity_idx, meta.gen});
+    if (!rel.parent_ && !rel.first_child_) {
+      return;
+    }
+    unlink_parent(rel);
+    for (EntityLink child = rel.first_child_; child;) {
+      Relationship& c = relationship_at(child);
+      const EntityLink next = c.next_sibling_;
+      c.parent_ = EntityLink{};
+      c.next_sibling_ = EntityLink{};
+      c.prev_sibling_ = EntityLink{};
+      set_subtree_depth(child, 0);
+      hierarchy_reparented(child.entity_idx, nullptr);
+      child = next;
+    }
+    rel.first_child_ = EntityLink{};
+  }
+
+  void hierarchy_reparented(std::uint32_t child, const std::uint32_t* parent) {
+    for (auto* order : hierarchies_) {
+      if (order->stale) {
+        continue;
+      }
+      const ConstEntityMeta child_meta = meta_at(child);
+      if (parent) {
+        const ConstEntityMeta parent_meta = meta_at(*parent);
+        order->on_reparent(child_meta, &parent_meta);
+      } else {
+        order->on_reparent(child_meta, nullptr);
+      }
+    }
+  }
+
+  struct IRemovedValues {
+    virtual ~IRemovedValues() = default;
+    // Moves the component at row `di` of `pool` into the stream.
+    virtual void push(Entity e, IPool& pool, DenseIndex di) = 0;
+  };
+
+  template <typename T>
+  struct RemovedValues final : IRemovedValues {
+    explicit RemovedValues(std::size_t capacity) : stream(capacity) {}
+
+    void push(Entity e, IPool& pool, DenseIndex di) override {
+      auto& comp = static_cast<Pool<T>&>(pool).items[di];
+      stream.push(Removed<T>{e, std::move(comp.data)});
+    }
+
+    EventStream<Removed<T>> stream;
+  };
+
+  struct ComponentEvents {
+    std::unique_ptr<EventStream<Entity>> added;
+    std::unique_ptr<EventStream<Entity>> removed;
+    std::unique_ptr<IRemovedValues> values;
+  };
+
+  ComponentEvents& component_events(ComponentId cid) {
+    if (events_.empty()) {
+      events_.resize(kMaxComponents);
+    }
+    return events_[cid];
+  }
+
+  // `meta` still owns row `di` of component `cid`, which is about to be erased.
+  void emit_removed(ConstEntityMeta meta, ComponentId cid, DenseIndex di) {
+    auto& events = events_[cid];
+    const Entity e{meta.entity_id, meta.entity_idx, meta.gen};
+    if (events.removed) {
+      events.removed->push(e);
+    }
+    if (events.values) {
+      events.values->push(e, *pools_[cid], di);
+    }
+  }
+
+  struct PrefabEntry {
+    ComponentId cid = 0;
+    const void* data = nullptr;
+    void (*emplace)(World& world, EntityMeta meta, const void* data, DenseIndex& out) = nullptr;
+  };
+
+  template <typename T>
+  static void prefab_emplace(World& world, EntityMeta meta, const void* data, DenseIndex& out) {
+    auto& pool = world.get_pool<T>();
+    const auto* value = static_cast<const T*>(data);
+    if constexpr (std::is_same_v<T, Relationship>) {
+      // Prefab relationships start as roots (a copied one would alias another entity's links).
+      (void)value;
+      out = pool.emplace(meta.entity_idx, meta.gen);
+    } else {
+      out = pool.emplace(meta.entity_idx, meta.gen, *value);
+    }
+    if constexpr (Pool<T>::kTracked) {
+      pool.stamp_added(out, world.tick_);
+    }
+  }
+
+  template <typename... Ts, std::size_t... I>
+  static std::array<PrefabEntry, sizeof...(Ts)> make_prefab_entries(const Prefab<Ts...>& prefab,
+                                                                    std::index_sequence<I...>) {
+    return {PrefabEntry{component_id<Ts>(), &std::get<I>(prefab.data), &prefab_emplace<Ts>}...};
+  }
+
+  template <typename... Ts>
+  static std::array<PrefabEntry, sizeof...(Ts)> make_prefab_entries(const Prefab<Ts...>& prefab) {
+    return make_prefab_entries(prefab, std::index_sequence_for<Ts...>{});
+  }
 
+  // Fills a freshly created entity from entries sorted by component id (one idx resize, no inserts).
+  void emplace_prefab_entries(EntityMeta meta, const PrefabEntry* entries, std::size_t count) {
     meta.sig.clear();
     meta.idx.clear();
     meta.idx.resize(count);
@@ -393,64 +1396,282 @@ public:
       if (i > 0) {
         assert(entries[i - 1].cid != entry.cid);
       }
-      meta.sig.set(entry.cid);
-      DenseIndex di = kInvalidIndex;
-      entry.emplace(*this, meta, entry.data, di);
-      meta.idx[i] = di;
+      meta.sig.set(entry.cid);
+      DenseIndex di = kInvalidIndex;
+      entry.emplace(*this, meta, entry.data, di);
+      meta.idx[i] = di;
+    }
+    groups_enter_new(meta, Signature<kMaxComponents>{});
+    if (add_watched_.intersects(meta.sig)) {
+      const Entity e{meta.entity_id, meta.entity_idx, meta.gen};
+      meta.sig.for_each_set_bit([&](ComponentId cid) {
+        if (add_watched_.test(cid)) {
+          events_[cid].added->push(e);
+        }
+      });
+    }
+  }
+
+  template <typename T>
+  void reserve_pool(std::size_t extra) {
+    auto& pool = get_pool<T>();
+    pool.items.reserve(pool.items.size() + extra);
+  }
+
+  template <bool Stamp, typename T, typename Fn>
+  void each_rows(Fn& fn) {
+    static_assert(!Pool<T>::kSoa, "each hands out T&; SoA components use each_block.");
+    auto& pool = get_pool<T>();
+    pool.for_each_row(0, pool.items.size(), [&](std::size_t i) {
+      auto& comp = pool.items[i];
+      assert(row_owner_live(comp.entity_idx, comp.gen));
+      if constexpr (std::is_invocable_v<Fn&, T&>) {
+        fn(comp.data);
+      } else {
+        Entity e{meta_at(comp.entity_idx).entity_id, comp.entity_idx, comp.gen};
+        fn(e, comp.data);
+      }
+      if constexpr (Stamp) {
+        pool.stamp_changed(static_cast<DenseIndex>(i), tick_);
+      }
+    });
+  }
+
+  template <bool Stamp, typename T0, typename... Ts, typename Fn>
+  void query_rows(Fn& fn) {
+    static_assert(are_unique<T0, Ts...>::value, "Query component types must be unique.");
+
+    auto access = std::make_tuple(QueryAccess<T0>{component_id<T0>(), get_pool_if_exists<T0>()},
+                                  QueryAccess<Ts>{component_id<Ts>(), get_pool_if_exists<Ts>()}...);
+    bool ok = true;
+    std::apply([&](auto&... a) { ok = ((a.pool != nullptr) && ...); }, access);
+    if (!ok) {
+      return;
+    }
+
+    Signature<kMaxComponents> required{};
+    required.clear();
+    required.set(component_id<T0>());
+    (required.set(component_id<Ts>()), ...);
+
+    constexpr std::size_t kCount = 1 + sizeof...(Ts);
+    std::size_t driver = 0;
+    std::apply(
+        [&](auto&... a) {
+          std::size_t i = 0;
+          std::size_t best = static_cast<std::size_t>(-1);
+          ((a.pool->size() < best ? (best = a.pool->size(), driver = i) : 0, ++i), ...);
+        },
+        access);
+
+    query_dispatch<Stamp>(fn, access, required, driver, std::make_index_sequence<kCount>{}, nullptr);
+  }
+
+  // `block` restricts the scan to one DenseArray block of the driver pool (nullptr = all rows).
+  // Stamp: also stamp the entity's change_ticks components as changed (query(stamp_changed, fn)).
+  template <bool Stamp, typename Fn, typename Access, std::size_t... I>
+  void query_dispatch(Fn& fn, Access& access, const Signature<kMaxComponents>& required, std::size_t driver,
+                      std::index_sequence<I...> seq, const std::size_t* block) {
+    ((driver == I ? (query_drive<Stamp, I>(fn, access, required, seq, block), true) : false) || ...);
+  }
+
+  template <bool Stamp, std::size_t Driver, typename Fn, typename Access, std::size_t... I>
+  void query_drive(Fn& fn, Access& access, const Signature<kMaxComponents>& required, std::index_sequence<I...>,
+                   const std::size_t* block) {
+    auto* pool = std::get<Driver>(access).pool;
+    std::size_t begin = 0;
+    std::size_t count = pool->items.size();
+    if (block) {
+      constexpr std::size_t kBlock = std::remove_reference_t<decltype(pool->items)>::kBlockSize;
+      begin = *block * kBlock;
+      count = std::min(count, begin + kBlock);
+    }
+    pool->for_each_row(begin, count, [&](std::size_t i) {
+      auto& comp = pool->items[i];
+      const auto meta = meta_at(comp.entity_idx);
+      assert(row_owner_live(comp.entity_idx, comp.gen));
+      if constexpr (sizeof...(I) > 1) {
+        if (!meta.sig.contains_all(required)) {
+          return;
+        }
+      }
+      Entity e{meta.entity_id, comp.entity_idx, comp.gen};
+      fn(e, query_arg<I, Driver>(comp, meta, std::get<I>(access))...);
+      if constexpr (Stamp) {
+        (stamp_row<I, Driver>(i, meta.sig, meta.idx, std::get<I>(access)), ...);
+      }
+    });
+  }
+
+  // Stamps the entity's T as changed; `row` is its dense index if I is the driver.
+  template <std::size_t I, std::size_t Driver, typename T>
+  void stamp_row(std::size_t row, const Signature<kMaxComponents>& sig, const IdxTable& idx,
+                 const QueryAccess<T>& access) {
+    if constexpr (Pool<T>::kTracked) {
+      const DenseIndex di = I == Driver ? static_cast<DenseIndex>(row) : idx[sig.rank(access.cid)];
+      access.pool->stamp_changed(di, tick_);
+    } else {
+      (void)row;
+      (void)sig;
+      (void)idx;
+      (void)access;
     }
-    return e;
   }
 
-  Snapshot snapshot() const {
-    Snapshot snap;
-    snap.next_entity_id = next_entity_id_;
-    snap.arena = arena_.clone_with_resource(snap.idx_resource.get());
-    snap.pools.resize(pools_.size());
-    for (std::size_t i = 0; i < pools_.size(); ++i) {
-      if (pools_[i]) {
-        snap.pools[i] = pools_[i]->clone();
-      }
+  template <std::size_t I, std::size_t Driver, typename C, typename T>
+  static T& query_arg(C& driver_comp, ConstEntityMeta meta, const QueryAccess<T>& access) {
+    if constexpr (I == Driver) {
+      return driver_comp.data;
+    } else {
+      return query_get(meta, access);
     }
-    return snap;
   }
 
-  void restore(const Snapshot& snap) {
-    // Proxies cache component pointers; restoring invalidates all caches.
-    invalidate_all_proxies();
-    arena_ = snap.arena.clone_with_resource(&idx_resource_);
-    pools_.clear();
-    pools_.resize(kMaxComponents);
-    for (std::size_t i = 0; i < snap.pools.size(); ++i) {
-      if (snap.pools[i]) {
-        pools_[i] = snap.pools[i]->clone();
+  template <bool Stamp, typename Filter, typename Fn>
+  void filter_query(const Filter& filter, Fn& fn) {
+    filter_query<Stamp>(filter, fn, std::type_identity<typename Filter::WithTypes>{},
+                        std::type_identity<typename Filter::OptionalTypes>{},
+                        std::type_identity<typename Filter::ChangedTypes>{},
+                        std::type_identity<typename Filter::AddedTypes>{});
+  }
+
+  template <bool Stamp, typename Filter, typename Fn, typename... Ws, typename... Os, typename... Cs, typename... As>
+  void filter_query(const Filter& filter, Fn& fn, std::type_identity<std::tuple<Ws...>>,
+                    std::type_identity<std::tuple<Os...>>, std::type_identity<std::tuple<Cs...>>,
+                    std::type_identity<std::tuple<As...>>) {
+    auto access = std::make_tuple(QueryAccess<Ws>{component_id<Ws>(), get_pool_if_exists<Ws>()}...);
+    auto ticked = std::make_tuple(TickAccess<Cs, false>{component_id<Cs>(), get_pool_if_exists<Cs>()}...,
+                                  TickAccess<As, true>{component_id<As>(), get_pool_if_exists<As>()}...);
+    bool ok = true;
+    std::apply([&](auto&... a) { ok = ((a.pool != nullptr) && ...); }, access);
+    std::apply([&](auto&... a) { ok = ok && ((a.pool != nullptr) && ...); }, ticked);
+    if (!ok) {
+      return;
+    }
+    // A missing Optional pool stays nullptr; the owner's signature never has its bit set.
+    auto optional = std::make_tuple(QueryAccess<Os>{component_id<Os>(), get_pool_if_exists<Os>()}...);
+
+    const auto smallest = [](auto&... a) {
+      std::size_t driver = 0;
+      std::size_t i = 0;
+      std::size_t best = static_cast<std::size_t>(-1);
+      ((a.pool->size() < best ? (best = a.pool->size(), driver = i) : 0, ++i), ...);
+      return driver;
+    };
+    constexpr bool kTickDriver = sizeof...(Cs) + sizeof...(As) > 0;
+    std::size_t driver = 0;
+    if constexpr (kTickDriver) {
+      driver = std::apply(smallest, ticked);
+    } else {
+      driver = std::apply(smallest, access);
+    }
+    constexpr std::size_t kDrivers = kTickDriver ? sizeof...(Cs) + sizeof...(As) : sizeof...(Ws);
+    filter_dispatch<Stamp, kTickDriver>(driver, std::make_index_sequence<kDrivers>{}, fn, filter, access, optional,
+                                        ticked);
+  }
+
+  template <bool Stamp, bool kTickDriver, std::size_t... D, typename Fn, typename Filter, typename Access,
+            typename OptAccess, typename TickedAccess>
+  void filter_dispatch(std::size_t driver, std::index_sequence<D...>, Fn& fn, const Filter& filter, Access& access,
+                       OptAccess& optional, TickedAccess& ticked) {
+    ((driver == D ? (filter_drive<Stamp, kTickDriver, D>(fn, filter, access, optional, ticked,
+                                                         std::make_index_sequence<std::tuple_size_v<Access>>{},
+                                                         std::make_index_sequence<std::tuple_size_v<OptAccess>>{},
+                                                         std::make_index_sequence<std::tuple_size_v<TickedAccess>>{}),
+                     true)
+                  : false) ||
+     ...);
+  }
+
+  // Driver indexes `ticked` if kTickDriver, else `access`. Reads the arena columns rather than a
+  // meta view (see row_of); rows that fail the masks touch only the signature column.
+  template <bool Stamp, bool kTickDriver, std::size_t Driver, typename Fn, typename Filter, typename Access,
+            typename OptAccess, typename TickedAccess, std::size_t... I, std::size_t... J, std::size_t... K>
+  void filter_drive(Fn& fn, const Filter& filter, Access& access, OptAccess& optional, TickedAccess& ticked,
+                    std::index_sequence<I...>, std::index_sequence<J...>, std::index_sequence<K...>) {
+    constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+    // A With term for the driving change term's component is handed the driver row. Unread
+    // when the filter has no With terms.
+    [[maybe_unused]] constexpr std::size_t kWithDriver = [] {
+      if constexpr (kTickDriver) {
+        using DriverAccess = QueryAccess<typename std::tuple_element_t<Driver, TickedAccess>::type>;
+        std::size_t at = kNone;
+        ((std::is_same_v<std::tuple_element_t<I, Access>, DriverAccess> ? void(at = I) : void()), ...);
+        return at;
+      } else {
+        return Driver;
       }
+    }();
+    // The driver row already proves its own component; a lone required bit with nothing to
+    // exclude or look up needs no signature read (a cache miss per row when matches are sparse).
+    const bool test_sig =
+        filter.required.popcount() > 1 || filter.excluded.popcount() > 0 || std::tuple_size_v<OptAccess> > 0;
+    auto* pool = [&] {
+      if constexpr (kTickDriver) {
+        return std::get<Driver>(ticked).pool;
+      } else {
+        return std::get<Driver>(access).pool;
+      }
+    }();
+    constexpr std::size_t kBlock = std::remove_pointer_t<decltype(pool)>::kBlockSize;
+    const std::size_t rows = pool->items.size();
+    for (std::size_t block = 0; block * kBlock < rows; ++block) {
+      if constexpr (kTickDriver) {
+        if (std::get<Driver>(ticked).block_tick(block) <= filter.since) {
+          continue;
+        }
+      }
+      pool->for_each_row(block * kBlock, std::min(rows, (block + 1) * kBlock), [&](std::size_t i) {
+        const auto& comp = std::as_const(pool->items)[i];
+        assert(row_owner_live(comp.entity_idx, comp.gen));
+        if constexpr (kTickDriver) {
+          if (std::get<Driver>(ticked).row_tick(comp) <= filter.since) {
+            return;
+          }
+        }
+        const auto& sig = arena_.sig(comp.entity_idx);
+        if (test_sig && !sig.matches(filter.required, filter.excluded)) {
+          return;
+        }
+        const auto& idx = arena_.idx(comp.entity_idx);
+        if (!(tick_newer<K, (kTickDriver ? Driver : kNone)>(sig, idx, std::get<K>(ticked), filter.since) && ...)) {
+          return;
+        }
+        Entity e{arena_.entity_id(comp.entity_idx), comp.entity_idx, comp.gen};
+        fn(e, filter_arg<I, kWithDriver>(i, sig, idx, std::get<I>(access))...,
+           filter_opt(sig, idx, std::get<J>(optional))...);
+        if constexpr (Stamp) {
+          (stamp_row<I, kWithDriver>(i, sig, idx, std::get<I>(access)), ...);
+        }
+      });
     }
-    next_entity_id_ = snap.next_entity_id;
   }
 
-private:
-  struct PrefabEntry {
-    ComponentId cid = 0;
-    const void* data = nullptr;
-    void (*emplace)(World& world, EntityMeta& meta, const void* data, DenseIndex& out) = nullptr;
-  };
-
-  template <typename T>
-  static void prefab_emplace(World& world, EntityMeta& meta, const void* data, DenseIndex& out) {
-    auto& pool = world.get_pool<T>();
-    const auto* value = static_cast<const T*>(data);
-    out = pool.emplace(meta.entity_idx, meta.gen, *value);
+  template <std::size_t I, std::size_t Driver, typename T>
+  static T& filter_arg(std::size_t row, const Signature<kMaxComponents>& sig, const IdxTable& idx,
+                       const QueryAccess<T>& access) {
+    if constexpr (I == Driver) {
+      return access.pool->items[row].data;
+    } else {
+      return access.pool->items[idx[sig.rank(access.cid)]].data;
+    }
   }
 
-  template <typename... Ts, std::size_t... I>
-  static std::array<PrefabEntry, sizeof...(Ts)> make_prefab_entries(const Prefab<Ts...>& prefab,
-                                                                    std::index_sequence<I...>) {
-    return {PrefabEntry{component_id<Ts>(), &std::get<I>(prefab.data), &prefab_emplace<Ts>}...};
+  template <typename T>
+  static T* filter_opt(const Signature<kMaxComponents>& sig, const IdxTable& idx, const QueryAccess<T>& access) {
+    return sig.test(access.cid) ? &access.pool->items[idx[sig.rank(access.cid)]].data : nullptr;
   }
 
-  template <typename... Ts>
-  static std::array<PrefabEntry, sizeof...(Ts)> make_prefab_entries(const Prefab<Ts...>& prefab) {
-    return make_prefab_entries(prefab, std::index_sequence_for<Ts...>{});
+  // Change term K of an entity that has its component (the masks checked that); the driving
+  // term was checked on its own row already.
+  template <std::size_t K, std::size_t Driver, typename T, bool kAdded>
+  static bool tick_newer(const Signature<kMaxComponents>& sig, const IdxTable& idx, const TickAccess<T, kAdded>& term,
+                         Tick since) {
+    if constexpr (K == Driver) {
+      return true;
+    } else {
+      return term.row_tick(std::as_const(term.pool->items)[idx[sig.rank(term.cid)]]) > since;
+    }
   }
 
   template <typename T>
@@ -480,33 +1701,137 @@ private:
     return static_cast<Pool<T>*>(pools_[cid].get());
   }
 
-  EntityMeta* validate(Entity e) {
-    if (e.entity_idx >= arena_.size()) {
-      return nullptr;
+  std::optional<EntityMeta> validate(Entity e) {
+    if (!is_alive(e)) {
+      return std::nullopt;
     }
-    auto& meta = arena_.at(e.entity_idx);
-    if ((meta.gen & kGenAliveBit) == 0 || meta.gen != e.gen || meta.entity_id != e.entity_id) {
-      return nullptr;
+    return arena_.at(e.entity_idx);
+  }
+
+  // Restored metas may still link proxies of the World they were captured from.
+  void clear_restored_proxies(const std::vector<std::uint32_t>& proxied) {
+    for (const std::uint32_t idx : proxied) {
+      if (idx < arena_.size() && meta_at(idx).proxy) {
+        arena_.at(idx).proxy = nullptr;
+      }
     }
-    return &meta;
   }
 
-  const EntityMeta* validate_const(Entity e) const {
-    if (e.entity_idx >= arena_.size()) {
-      return nullptr;
+  // Read-only arena access: never copies a block shared with a snapshot.
+  ConstEntityMeta meta_at(std::uint32_t idx) const {
+    return arena_.at(idx);
+  }
+
+  bool row_owner_live(std::uint32_t entity_idx, std::uint32_t gen) const {
+    const std::uint32_t live = arena_.gen(entity_idx);
+    return (live & kGenAliveBit) != 0 && live == gen;
+  }
+
+  // Restored pools may carry ticks from another World; stamps must not go back past them.
+  void catch_up_tick() {
+    for (const auto& pool : pools_) {
+      if (pool) {
+        tick_ = std::max(tick_, pool->max_tick());
+      }
     }
-    const auto& meta = arena_.at(e.entity_idx);
-    if ((meta.gen & kGenAliveBit) == 0 || meta.gen != e.gen || meta.entity_id != e.entity_id) {
-      return nullptr;
+  }
+
+  bool live_handle(std::uint32_t entity_idx, std::uint32_t gen) const {
+    return entity_idx < arena_.size() && row_owner_live(entity_idx, gen);
+  }
+
+  // Dense row of component `cid` for a live (entity_idx, gen), or kInvalidIndex. Lookups read
+  // the arena columns they need directly rather than assembling an EntityMeta view: the view's
+  // five references cost more than the loads on this path.
+  DenseIndex row_of(std::uint32_t entity_idx, std::uint32_t gen, ComponentId cid) const {
+    if (!live_handle(entity_idx, gen)) {
+      return kInvalidIndex;
+    }
+    const auto& sig = arena_.sig(entity_idx);
+    if (!sig.test(cid)) {
+      return kInvalidIndex;
+    }
+    return arena_.idx(entity_idx)[sig.rank(cid)];
+  }
+
+  DenseIndex row_of(Entity e, ComponentId cid) const {
+    const DenseIndex di = row_of(e.entity_idx, e.gen, cid);
+    return di != kInvalidIndex && arena_.entity_id(e.entity_idx) == e.entity_id ? di : kInvalidIndex;
+  }
+
+  // Sparse-lookup components skip the arena: one page read, then the row's own gen stands in
+  // for the liveness test, since live rows belong to live entities (see verify_pools). Handles
+  // are matched on (entity_idx, gen) alone, as by try_get_idx_gen; the Entity overload below
+  // also checks entity_id, as is_alive does.
+  template <typename T>
+  DenseIndex row_of(std::uint32_t entity_idx, std::uint32_t gen) const {
+    if constexpr (Pool<T>::kSparse) {
+      const auto* pool = get_pool_const<T>();
+      if (!pool) {
+        return kInvalidIndex;
+      }
+      const DenseIndex di = pool->sparse_row(entity_idx);
+      return di != kInvalidIndex && pool->items[di].gen == gen ? di : kInvalidIndex;
+    } else {
+      return row_of(entity_idx, gen, component_id<T>());
+    }
+  }
+
+  template <typename T>
+  DenseIndex row_of(Entity e) const {
+    if constexpr (Pool<T>::kSparse) {
+      const DenseIndex di = row_of<T>(e.entity_idx, e.gen);
+      return di != kInvalidIndex && arena_.entity_id(e.entity_idx) == e.entity_id ? di : kInvalidIndex;
+    } else {
+      return row_of(e, component_id<T>());
+    }
+  }
+
+  // Liveness is tested on the columns; the view is only assembled for a live handle.
+  std::optional<ConstEntityMeta> validate_const(Entity e) const {
+    if (!is_alive(e)) {
+      return std::nullopt;
+    }
+    return arena_.at(e.entity_idx);
+  }
+
+  void groups_on_gain(ConstEntityMeta meta, ComponentId cid) {
+    for (auto& g : groups_) {
+      if (!g->stale && g->required.test(cid) && meta.sig.contains_all(g->required)) {
+        g->on_enter(meta);
+      }
+    }
+  }
+
+  void groups_on_loss(ConstEntityMeta meta, ComponentId cid) {
+    for (auto& g : groups_) {
+      if (!g->stale && g->required.test(cid) && meta.sig.contains_all(g->required)) {
+        g->on_leave(meta.entity_idx);
+      }
+    }
+  }
+
+  void groups_enter_new(ConstEntityMeta meta, const Signature<kMaxComponents>& before) {
+    for (auto& g : groups_) {
+      if (!g->stale && !before.contains_all(g->required) && meta.sig.contains_all(g->required)) {
+        g->on_enter(meta);
+      }
+    }
+  }
+
+  void groups_leave_all(ConstEntityMeta meta) {
+    for (auto& g : groups_) {
+      if (!g->stale && meta.sig.contains_all(g->required)) {
+        g->on_leave(meta.entity_idx);
+      }
     }
-    return &meta;
   }
 
   void update_moved(DenseIndex di, std::uint32_t entity_idx, std::uint32_t gen, ComponentId cid) {
     if (entity_idx >= arena_.size()) {
       return;
     }
-    auto& meta = arena_.at(entity_idx);
+    auto meta = arena_.at(entity_idx);
     if ((meta.gen & kGenAliveBit) == 0 || meta.gen != gen) {
       return;
     }
@@ -514,6 +1839,11 @@ private:
     if (pos < meta.idx.size()) {
       meta.idx[pos] = di;
     }
+    for (auto& g : groups_) {
+      if (!g->stale && g->required.test(cid)) {
+        g->on_moved(entity_idx, cid, di);
+      }
+    }
     if (cid < pools_.size() && pools_[cid]) {
       notify_proxy_component_ptr(meta, cid, pools_[cid]->component_ptr(di));
     } else {
@@ -521,22 +1851,52 @@ private:
     }
   }
 
-  std::pmr::unsynchronized_pool_resource idx_resource_{};
+  // Shared with arena blocks (and the snapshots that share them), which keep it alive.
+  std::shared_ptr<std::pmr::unsynchronized_pool_resource> idx_resource_;
   std::pmr::unsynchronized_pool_resource proxy_resource_{};
   LinearArena arena_;
   std::vector<std::unique_ptr<IPool>> pools_;
   std::uint64_t next_entity_id_ = 0;
+  Tick tick_ = 1;
   EntityProxy* proxy_head_ = nullptr;
+  std::vector<std::unique_ptr<IGroup>> groups_;
+  // Components whose pools are owned by a PackedGroup.
+  Signature<kMaxComponents> owned_{};
+  // Event streams by component id (allocated on first registration) and the components that
+  // have an on_add, or an on_remove / on_remove_value, stream.
+  std::vector<ComponentEvents> events_;
+  Signature<kMaxComponents> add_watched_{};
+  Signature<kMaxComponents> remove_watched_{};
+  std::unique_ptr<EventStream<Entity>> destroy_events_;
+  // Hierarchy orders (owned by groups_), the Relationship component id once hierarchies are in
+  // use, and set_subtree_depth scratch.
+  std::vector<IHierarchyOrder*> hierarchies_;
+  ComponentId relationship_cid_ = kMaxComponents;
+  std::vector<std::pair<EntityLink, std::uint32_t>> hierarchy_stack_;
+  // sort / sort_like scratch.
+  std::vector<DenseIndex> sort_order_;
+  std::vector<DenseIndex> sort_dest_;
+  // destroy_batch scratch, kept to avoid reallocating per call.
+  std::vector<std::pair<ComponentId, DenseIndex>> batch_rows_;
+  std::vector<DenseIndex> batch_by_pool_;
+  std::vector<std::uint32_t> batch_freed_;
 
   template <typename T>
   friend class Pool;
+  template <typename... Ts>
+  friend class QueryGroup;
+  template <typename... Ts>
+  friend class PackedGroup;
+  template <typename T>
+  friend class HierarchyOrder;
   friend class EntityProxy;
 
-  void invalidate_proxy_component(EntityMeta& meta, ComponentId cid);
-  void notify_proxy_missing(EntityMeta& meta, ComponentId cid);
-  void notify_proxy_component_ptr(EntityMeta& meta, ComponentId cid, void* comp_ptr);
-  void invalidate_proxy_all(EntityMeta& meta);
+  void invalidate_proxy_component(EntityMeta meta, ComponentId cid);
+  void notify_proxy_missing(EntityMeta meta, ComponentId cid);
+  void notify_proxy_component_ptr(EntityMeta meta, ComponentId cid, void* comp_ptr);
+  void invalidate_proxy_all(EntityMeta meta);
   void invalidate_all_proxies();
+  void clear_proxy_caches(std::vector<std::uint32_t>& linked) const;
   void link_proxy(EntityProxy& proxy);
   void unlink_proxy(EntityProxy& proxy);
   void destroy_proxy(EntityProxy& proxy);
@@ -759,7 +2119,7 @@ private:
 };
 
 inline EntityProxyRef World::get_proxy(Entity e) {
-  auto* meta = validate(e);
+  auto meta = validate(e);
   if (!meta) {
     return {};
   }
@@ -777,25 +2137,25 @@ inline EntityProxyRef World::get_proxy(Entity e) {
   return EntityProxyRef{*proxy};
 }
 
-inline void World::invalidate_proxy_component(EntityMeta& meta, ComponentId cid) {
+inline void World::invalidate_proxy_component(EntityMeta meta, ComponentId cid) {
   if (meta.proxy) {
     meta.proxy->invalidate_component(cid);
   }
 }
 
-inline void World::notify_proxy_missing(EntityMeta& meta, ComponentId cid) {
+inline void World::notify_proxy_missing(EntityMeta meta, ComponentId cid) {
   if (meta.proxy) {
     meta.proxy->mark_missing(cid);
   }
 }
 
-inline void World::notify_proxy_component_ptr(EntityMeta& meta, ComponentId cid, void* comp_ptr) {
+inline void World::notify_proxy_component_ptr(EntityMeta meta, ComponentId cid, void* comp_ptr) {
   if (meta.proxy) {
     meta.proxy->cache_component(cid, comp_ptr);
   }
 }
 
-inline void World::invalidate_proxy_all(EntityMeta& meta) {
+inline void World::invalidate_proxy_all(EntityMeta meta) {
   if (meta.proxy) {
     meta.proxy->invalidate_all();
     meta.proxy->mark_dead();
@@ -825,6 +2185,17 @@ inline void World::invalidate_all_proxies() {
   }
 }
 
+// Drops cached component pointers (they may point into blocks a snapshot is about to share)
+// and collects the entities whose meta links a proxy.
+inline void World::clear_proxy_caches(std::vector<std::uint32_t>& linked) const {
+  for (EntityProxy* it = proxy_head_; it; it = it->next_) {
+    it->clear_cache();
+    if (it->linked_) {
+      linked.push_back(it->entity_.entity_idx);
+    }
+  }
+}
+
 inline void World::link_proxy(EntityProxy& proxy) {
   assert(proxy.prev_ == nullptr);
   assert(proxy.next_ == nullptr);
@@ -859,12 +2230,440 @@ inline void World::destroy_proxy(EntityProxy& proxy) {
 
 template <typename T>
 void Pool<T>::erase_dense(DenseIndex di, World& world) {
+  if constexpr (kStable) {
+    (void)world;
+    bury(di);
+    return;
+  }
+  sparse_drop(di);
   const std::size_t last = items.size() - 1;
   if (di != last) {
     items[di] = std::move(items[last]);
+    sparse_note(di);
+    ticks_note(di);
     world.update_moved(di, items[di].entity_idx, items[di].gen, component_id<T>());
   }
   items.pop_back();
 }
 
+template <typename T>
+void Pool<T>::erase_dense_batch(const DenseIndex* rows, std::size_t count, World& world) {
+  if constexpr (kStable) {
+    (void)world;
+    for (std::size_t i = 0; i < count; ++i) {
+      bury(rows[i]);
+    }
+    return;
+  }
+  // Mark doomed rows, then fill each hole from the back, first dropping doomed rows that
+  // sit at the back. A row moved into a hole is therefore never one still waiting to go.
+  std::vector<std::uint64_t> doomed((items.size() + 63) / 64, 0);
+  auto is_doomed = [&](std::size_t i) { return ((doomed[i >> 6] >> (i & 63)) & 1ULL) != 0; };
+  for (std::size_t i = 0; i < count; ++i) {
+    doomed[rows[i] >> 6] |= 1ULL << (rows[i] & 63);
+    sparse_drop(rows[i]);
+  }
+  const ComponentId cid = component_id<T>();
+  for (std::size_t i = 0; i < count; ++i) {
+    while (!items.empty() && is_doomed(items.size() - 1)) {
+      items.pop_back();
+    }
+    const DenseIndex di = rows[i];
+    if (di >= items.size()) {
+      continue;
+    }
+    const std::size_t last = items.size() - 1;
+    items[di] = std::move(items[last]);
+    doomed[di >> 6] &= ~(1ULL << (di & 63));
+    sparse_note(di);
+    ticks_note(di);
+    world.update_moved(di, items[di].entity_idx, items[di].gen, cid);
+    items.pop_back();
+  }
+}
+
+template <typename T>
+void Pool<T>::compact(World& world) {
+  if constexpr (kStable) {
+    // Fill holes in ascending order with the last live row, dropping trailing tombstones first.
+    std::sort(free_rows_.begin(), free_rows_.end());
+    const ComponentId cid = component_id<T>();
+    for (const DenseIndex hole : free_rows_) {
+      while (!items.empty() && !is_live(static_cast<DenseIndex>(items.size() - 1))) {
+        items.pop_back();
+      }
+      if (hole >= items.size()) {
+        break;
+      }
+      const std::size_t last = items.size() - 1;
+      items[hole] = std::move(items[last]);
+      occupied_[last >> 6] &= ~(1ULL << (last & 63));
+      occupied_[hole >> 6] |= 1ULL << (hole & 63);
+      items.pop_back();
+      sparse_note(hole);
+      ticks_note(hole);
+      world.update_moved(hole, items[hole].entity_idx, items[hole].gen, cid);
+    }
+    while (!items.empty() && !is_live(static_cast<DenseIndex>(items.size() - 1))) {
+      items.pop_back();
+    }
+    free_rows_.clear();
+
+    // Every row is live now: rebuild the bitmap and per-block counts for the new size.
+    const std::size_t count = items.size();
+    occupied_.assign((count + 63) / 64, ~0ULL);
+    if (count % 64 != 0) {
+      occupied_.back() = (1ULL << (count % 64)) - 1ULL;
+    }
+    block_live_.assign(items.block_count(), static_cast<std::uint32_t>(kBlockSize));
+    if (count % kBlockSize != 0) {
+      block_live_.back() = static_cast<std::uint32_t>(count % kBlockSize);
+    }
+  } else {
+    (void)world;
+  }
+}
+
+template <soa_component T>
+void Pool<T>::erase_dense(DenseIndex di, World& world) {
+  const std::size_t last = items.size() - 1;
+  if (di != last) {
+    items.move_row(di, last);
+    world.update_moved(di, items.entity_idx(di), items.gen(di), component_id<T>());
+  }
+  items.pop_back();
+}
+
+template <soa_component T>
+void Pool<T>::erase_dense_batch(const DenseIndex* rows, std::size_t count, World& world) {
+  // Same back-filling scheme as the row-major pools.
+  std::vector<std::uint64_t> doomed((items.size() + 63) / 64, 0);
+  auto is_doomed = [&](std::size_t i) { return ((doomed[i >> 6] >> (i & 63)) & 1ULL) != 0; };
+  for (std::size_t i = 0; i < count; ++i) {
+    doomed[rows[i] >> 6] |= 1ULL << (rows[i] & 63);
+  }
+  const ComponentId cid = component_id<T>();
+  for (std::size_t i = 0; i < count; ++i) {
+    while (!items.empty() && is_doomed(items.size() - 1)) {
+      items.pop_back();
+    }
+    const DenseIndex di = rows[i];
+    if (di >= items.size()) {
+      continue;
+    }
+    items.move_row(di, items.size() - 1);
+    doomed[di >> 6] &= ~(1ULL << (di & 63));
+    world.update_moved(di, items.entity_idx(di), items.gen(di), cid);
+    items.pop_back();
+  }
+}
+
+template <typename... Ts>
+void QueryGroup<Ts...>::rebuild(World& world) {
+  rows_.clear();
+  slot_.assign(world.arena_.size(), kInvalidIndex);
+  pools_ = std::make_tuple(&world.get_pool<Ts>()...);
+  stale = false;
+
+  // Seed from the smallest pool, same as World::query.
+  IPool* seed = nullptr;
+  std::size_t best = static_cast<std::size_t>(-1);
+  auto pick = [&](auto* pool) {
+    if (pool->size() < best) {
+      best = pool->size();
+      seed = pool;
+    }
+  };
+  std::apply([&](auto*... p) { (pick(p), ...); }, pools_);
+
+  auto scan = [&](auto* pool) {
+    if (static_cast<IPool*>(pool) != seed) {
+      return;
+    }
+    pool->for_each_row(0, pool->items.size(), [&](std::size_t i) {
+      const auto& comp = std::as_const(pool->items)[i];
+      const auto& meta = world.meta_at(comp.entity_idx);
+      if ((meta.gen & kGenAliveBit) == 0 || meta.gen != comp.gen) {
+        return;
+      }
+      if (meta.sig.contains_all(required)) {
+        on_enter(meta);
+      }
+    });
+  };
+  std::apply([&](auto*... p) { (scan(p), ...); }, pools_);
+}
+
+template <typename... Ts>
+void PackedGroup<Ts...>::on_enter(ConstEntityMeta meta) {
+  const DenseIndex target = static_cast<DenseIndex>(packed_);
+  auto pack_one = [&](auto* pool, ComponentId cid) {
+    const DenseIndex di = meta.idx[meta.sig.rank(cid)];
+    assert(di >= target);
+    if (di != target) {
+      pool->swap_dense(di, target);
+      world_->update_moved(di, pool->items[di].entity_idx, pool->items[di].gen, cid);
+      world_->update_moved(target, pool->items[target].entity_idx, pool->items[target].gen, cid);
+    }
+  };
+  std::apply([&](auto*... p) {
+    std::size_t i = 0;
+    (pack_one(p, cids_[i++]), ...);
+  }, pools_);
+  ++packed_;
+}
+
+template <typename... Ts>
+void PackedGroup<Ts...>::on_leave(std::uint32_t entity_idx) {
+  assert(packed_ > 0);
+  const auto& meta = world_->meta_at(entity_idx);
+  const DenseIndex last = static_cast<DenseIndex>(packed_ - 1);
+  auto unpack_one = [&](auto* pool, ComponentId cid) {
+    const DenseIndex di = meta.idx[meta.sig.rank(cid)];
+    assert(di <= last);
+    if (di != last) {
+      pool->swap_dense(di, last);
+      world_->update_moved(di, pool->items[di].entity_idx, pool->items[di].gen, cid);
+      world_->update_moved(last, pool->items[last].entity_idx, pool->items[last].gen, cid);
+    }
+  };
+  std::apply([&](auto*... p) {
+    std::size_t i = 0;
+    (unpack_one(p, cids_[i++]), ...);
+  }, pools_);
+  --packed_;
+}
+
+template <typename... Ts>
+void PackedGroup<Ts...>::rebuild(World& world) {
+  pools_ = std::make_tuple(&world.get_pool<Ts>()...);
+  packed_ = 0;
+  stale = false;
+
+  IPool* seed = nullptr;
+  std::size_t best = static_cast<std::size_t>(-1);
+  auto pick = [&](auto* pool) {
+    if (pool->items.size() < best) {
+      best = pool->items.size();
+      seed = pool;
+    }
+  };
+  std::apply([&](auto*... p) { (pick(p), ...); }, pools_);
+
+  // Entering swaps row i with row packed_ <= i, so a forward scan visits every row exactly once.
+  auto scan = [&](auto* pool) {
+    if (static_cast<IPool*>(pool) != seed) {
+      return;
+    }
+    const std::size_t count = pool->items.size();
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto& comp = std::as_const(pool->items)[i];
+      const auto& meta = world.meta_at(comp.entity_idx);
+      if ((meta.gen & kGenAliveBit) == 0 || meta.gen != comp.gen) {
+        continue;
+      }
+      if (meta.sig.contains_all(required)) {
+        on_enter(meta);
+      }
+    }
+  };
+  std::apply([&](auto*... p) { (scan(p), ...); }, pools_);
+}
+
+template <typename... Ts>
+template <typename Fn, std::size_t... I>
+void PackedGroup<Ts...>::each_impl(Fn& fn, std::index_sequence<I...>) {
+  const std::size_t count = packed_;
+  if constexpr (std::is_invocable_v<Fn&, Ts&...>) {
+    for (std::size_t r = 0; r < count; ++r) {
+      fn(std::get<I>(pools_)->items[r].data...);
+    }
+  } else {
+    auto* lead = std::get<0>(pools_);
+    for (std::size_t r = 0; r < count; ++r) {
+      const auto& comp = lead->items[r];
+      Entity e{world_->meta_at(comp.entity_idx).entity_id, comp.entity_idx, comp.gen};
+      fn(e, std::get<I>(pools_)->items[r].data...);
+    }
+  }
+}
+
+template <typename T>
+HierarchyOrder<T>::HierarchyOrder(World& world)
+    : world_(&world), cid_(component_id<T>()), rel_cid_(component_id<Relationship>()) {
+  required.clear();
+  required.set(cid_);
+  required.set(rel_cid_);
+}
+
+template <typename T>
+void HierarchyOrder<T>::on_reparent(ConstEntityMeta child, const ConstEntityMeta* parent) {
+  if (!child.sig.test(cid_)) {
+    return;
+  }
+  const DenseIndex row = child.idx[child.sig.rank(cid_)];
+  assert(row < count_);
+  const DenseIndex up = parent && parent->sig.test(cid_) ? parent->idx[parent->sig.rank(cid_)] : kInvalidIndex;
+  parent_row_[row] = up;
+  if (up != kInvalidIndex && up > row) {
+    reorder_ = true;
+  }
+}
+
+template <typename T>
+void HierarchyOrder<T>::rebuild(World& world) {
+  pool_ = &world.get_pool<T>();
+  const auto& rels = std::as_const(world.get_pool<Relationship>().items);
+  const auto& items = std::as_const(pool_->items);
+  const std::size_t rows = items.size();
+  up_.assign(rows, kNotMember);
+  for (std::size_t r = 0; r < rows; ++r) {
+    const ConstEntityMeta meta = world.meta_at(items[r].entity_idx);
+    if (!meta.sig.test(rel_cid_)) {
+      continue;
+    }
+    const EntityLink link = rels[meta.idx[meta.sig.rank(rel_cid_)]].data.parent();
+    DenseIndex up = kInvalidIndex;
+    if (link) {
+      const ConstEntityMeta parent = world.meta_at(link.entity_idx);
+      if (parent.sig.test(cid_)) {
+        up = parent.idx[parent.sig.rank(cid_)];
+      }
+    }
+    up_[r] = up;
+  }
+  sort_rows(world, rows);
+}
+
+template <typename T>
+void HierarchyOrder<T>::sort_rows(World& world, std::size_t rows) {
+  // Our own hooks must ignore the moves below.
+  stale = true;
+  constexpr std::uint32_t kUnknown = 0xFFFFFFFFu;
+
+  // Depth of each member along its chain of parent rows, each row walked once.
+  auto& depth = depth_;
+  auto& start = depth_start_;
+  depth.assign(rows, kUnknown);
+  start.assign(1, 0);
+  std::size_t members = 0;
+  for (std::size_t r = 0; r < rows; ++r) {
+    if (up_[r] == kNotMember) {
+      continue;
+    }
+    ++members;
+    if (depth[r] != kUnknown) {
+      continue;
+    }
+    walk_.clear();
+    DenseIndex x = static_cast<DenseIndex>(r);
+    while (x != kInvalidIndex && depth[x] == kUnknown) {
+      assert(up_[x] != kNotMember);
+      walk_.push_back(x);
+      x = up_[x];
+    }
+    std::uint32_t d = x == kInvalidIndex ? 0 : depth[x] + 1;
+    for (auto it = walk_.rbegin(); it != walk_.rend(); ++it, ++d) {
+      depth[*it] = d;
+    }
+    if (d + 1 > start.size()) {
+      start.resize(d + 1, 0);
+    }
+  }
+
+  // Counting sort: members by depth (stable, so a sorted pool stays put), then everything else.
+  for (std::size_t r = 0; r < rows; ++r) {
+    if (up_[r] != kNotMember) {
+      ++start[depth[r] + 1];
+    }
+  }
+  for (std::size_t d = 1; d < start.size(); ++d) {
+    start[d] += start[d - 1];
+  }
+  auto& dest = dest_;
+  dest.resize(rows);
+  std::size_t tail = members;
+  bool sorted = true;
+  for (std::size_t r = 0; r < rows; ++r) {
+    dest[r] = static_cast<DenseIndex>(up_[r] == kNotMember ? tail++ : start[depth[r]]++);
+    sorted = sorted && dest[r] == r;
+  }
+
+  if (!sorted) {
+    world.template permute_rows<T>(std::span<const DenseIndex>(dest.data(), rows));
+  }
+
+  parent_row_.resize(members);
+  for (std::size_t r = 0; r < rows; ++r) {
+    const DenseIndex up = up_[r];
+    if (up != kNotMember) {
+      parent_row_[dest[r]] = up == kInvalidIndex ? kInvalidIndex : dest[up];
+      assert(up == kInvalidIndex || dest[up] < dest[r]);
+    }
+  }
+  count_ = members;
+  reorder_ = false;
+  stale = false;
+}
+
+template <typename T>
+template <typename Fn>
+void HierarchyOrder<T>::each(Fn&& fn) {
+  refresh();
+  auto& items = pool_->items;
+  const std::size_t count = count_;
+  for (std::size_t r = 0; r < count; ++r) {
+    const DenseIndex up = parent_row_[r];
+    // The parent's row came earlier in this pass, so its block is already unshared.
+    const T* parent = up == kInvalidIndex ? nullptr : &std::as_const(items)[up].data;
+    auto& comp = items[r];
+    if constexpr (std::is_invocable_v<Fn&, T&, const T*>) {
+      fn(comp.data, parent);
+    } else {
+      Entity e{world_->meta_at(comp.entity_idx).entity_id, comp.entity_idx, comp.gen};
+      fn(e, comp.data, parent);
+    }
+  }
+}
+
+inline void Scheduler::unshare(World& world) const {
+  world.unshare(touched_);
+}
+
+inline void CommandBuffer::replay(World& world) {
+  resolved_.clear();
+  resolved_.reserve(spawns_.size());
+  for (auto& spawn : spawns_) {
+    resolved_.push_back(spawn.apply ? spawn.apply(world, spawn.payload) : world.create());
+  }
+
+  // Group by component id so each pool is touched in one run; stable keeps per-entity order.
+  std::stable_sort(commands_.begin(), commands_.end(),
+                   [](const Command& a, const Command& b) { return a.cid < b.cid; });
+  for (auto& cmd : commands_) {
+    cmd.apply(world, resolve(cmd.target), cmd.payload);
+  }
+  for (const Entity e : destroys_) {
+    world.destroy(resolve(e));
+  }
+  discard();
+}
+
+template <typename T>
+void CommandBuffer::add_payload(World& world, Entity target, void* payload) {
+  if (world.is_alive(target)) {
+    world.add<T>(target, std::move(*static_cast<T*>(payload)));
+  }
+}
+
+template <typename T>
+void CommandBuffer::remove_payload(World& world, Entity target, void*) {
+  world.remove<T>(target);
+}
+
+template <typename... Ts>
+Entity CommandBuffer::instantiate_payload(World& world, void* payload) {
+  return world.instantiate(*static_cast<const Prefab<Ts...>*>(payload));
+}
+
 } // namespace ecs_lab
@@ -0,0 +1,167 @@
+#include "ecs_lab/ecs.hpp"
+
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct Position {
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+};
+
+struct Velocity {
+  float vx = 0.0f;
+  float vy = 0.0f;
+  float vz = 0.0f;
+};
+
+struct Health {
+  float hp = 100.0f;
+};
+
+struct Heat {
+  float value = 0.0f;
+};
+
+template <typename Fn>
+double time_ns(int repeats, Fn&& fn) {
+  const auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repeats; ++r) {
+    fn();
+  }
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start).count();
+  return static_cast<double>(ns) / static_cast<double>(repeats);
+}
+
+// A little arithmetic per row so the loop is not purely memory bound.
+void integrate(Position& p, const Velocity& v) {
+  p.x += v.vx * 0.016f;
+  p.y += v.vy * 0.016f;
+  p.z = std::sqrt(p.x * p.x + p.y * p.y);
+}
+
+void bench_scalability(ecs_lab::World& world, std::size_t entities, std::size_t max_threads, int repeats) {
+  std::cout << "par_each / par_query scaling benchmark\n";
+  std::cout << "entities: " << entities << "\n";
+  std::cout << "threads\teach ms\tpar_each ms\tquery ms\tpar_query ms\n";
+
+  const double each_ns = time_ns(repeats, [&] {
+    world.each<Position>([](ecs_lab::Entity, Position& p) { p.z = std::sqrt(p.x * p.x + p.y * p.y); });
+  });
+  const double query_ns = time_ns(repeats, [&] {
+    world.query<Position, Velocity>([](ecs_lab::Entity, Position& p, Velocity& v) { integrate(p, v); });
+  });
+
+  for (std::size_t threads = 1; threads <= max_threads; threads *= 2) {
+    ecs_lab::ThreadPool pool(threads - 1);
+    const double par_each_ns = time_ns(repeats, [&] {
+      world.par_each<Position>(pool, [](ecs_lab::Entity, Position& p) { p.z = std::sqrt(p.x * p.x + p.y * p.y); });
+    });
+    const double par_query_ns = time_ns(repeats, [&] {
+      world.par_query<Position, Velocity>(pool, [](ecs_lab::Entity, Position& p, Velocity& v) { integrate(p, v); });
+    });
+    std::cout << threads << "\t" << each_ns / 1e6 << "\t" << par_each_ns / 1e6 << "\t" << query_ns / 1e6 << "\t"
+              << par_query_ns / 1e6 << "\n";
+  }
+}
+
+// A small frame of systems run through the Scheduler, reporting where the time goes.
+void bench_scheduler(ecs_lab::World& world, std::size_t max_threads, int repeats) {
+  ecs_lab::ThreadPool pool(max_threads - 1);
+  ecs_lab::Scheduler scheduler(pool);
+  using ecs_lab::Reads;
+  using ecs_lab::Writes;
+
+  scheduler.add_system<Reads<Velocity>, Writes<Position>>("integrate", [](ecs_lab::World& w) {
+    w.query<Position, Velocity>([](ecs_lab::Entity, Position& p, Velocity& v) { integrate(p, v); });
+  });
+  scheduler.add_system<Reads<>, Writes<Heat>>("cool", [](ecs_lab::World& w) {
+    w.each<Heat>([](ecs_lab::Entity, Heat& h) { h.value *= 0.99f; });
+  });
+  scheduler.add_system<Reads<Position>, Writes<Health>>("zone_damage", [](ecs_lab::World& w) {
+    w.query<Position, Health>([](ecs_lab::Entity, Position& p, Health& h) { h.hp -= p.z > 1e6f ? 1.0f : 0.0f; });
+  });
+  scheduler.add_system<Reads<Health>, Writes<Heat>>("regen_heat", [](ecs_lab::World& w) {
+    w.query<Health, Heat>([](ecs_lab::Entity, Health& h, Heat& t) { t.value += h.hp * 0.001f; });
+  });
+  scheduler.add_system<Reads<>, Writes<Velocity>>("drag", [](ecs_lab::World& w) {
+    w.par_each<Velocity>([](ecs_lab::Entity, Velocity& v) { v.vx *= 0.999f; });
+  });
+
+  for (int r = 0; r < repeats; ++r) {
+    scheduler.run(world);
+  }
+
+  std::cout << "Scheduler frame (last of " << repeats << ", " << max_threads << " threads)\n";
+  std::cout << "system\tstart ms\tduration ms\n";
+  for (const auto& s : scheduler.stats()) {
+    std::cout << s.name << "\t" << s.start_ms << "\t" << s.duration_ms << "\n";
+  }
+  std::cout << "frame ms: " << scheduler.frame_ms() << "\n";
+  std::cout << "critical path:";
+  const auto stats = scheduler.stats();
+  for (const std::size_t i : scheduler.critical_path()) {
+    std::cout << " " << stats[i].name;
+  }
+  std::cout << " (" << scheduler.critical_path_ms() << " ms)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t entities = 1'000'000;
+  int repeats = 10;
+  std::size_t max_threads = std::thread::hardware_concurrency();
+  bool run_scaling = true;
+  bool run_scheduler = true;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--scaling") {
+      run_scheduler = false;
+      continue;
+    }
+    if (arg == "--scheduler") {
+      run_scaling = false;
+      continue;
+    }
+    if (arg.rfind("--threads=", 0) == 0) {
+      max_threads = static_cast<std::size_t>(std::stoull(arg.substr(10)));
+      continue;
+    }
+    if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0]))) {
+      entities = static_cast<std::size_t>(std::stoull(arg));
+    }
+  }
+  if (max_threads == 0) {
+    max_threads = 1;
+  }
+
+  ecs_lab::World world;
+  for (std::size_t i = 0; i < entities; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, static_cast<float>(i), 0.0f, 0.0f);
+    if (i % 2 == 0) {
+      world.add<Velocity>(e, 1.0f, 2.0f, 0.0f);
+    }
+    if (i % 3 == 0) {
+      world.add<Health>(e);
+      world.add<Heat>(e);
+    }
+  }
+
+  if (run_scaling) {
+    bench_scalability(world, entities, max_threads, repeats);
+  }
+  if (run_scheduler) {
+    bench_scheduler(world, max_threads, repeats);
+  }
+  return 0;
+}
@@ -0,0 +1,785 @@
+#include "ecs_lab/ecs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Transform {
+  float x = 0.0f;
+  float y = 0.0f;
+  float z = 0.0f;
+};
+
+struct Stunned {
+  int ticks = 0;
+};
+
+struct Velocity {
+  float vx = 0.0f;
+  float vy = 0.0f;
+  float vz = 0.0f;
+};
+
+struct Collider {
+  float radius = 0.0f;
+};
+
+struct Motion {
+  float x = 0.0f, y = 0.0f, z = 0.0f;
+  float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+};
+
+// A "fat" component: the integrate kernel touches 6 of its 16 floats.
+struct Body {
+  float x = 0.0f, y = 0.0f, z = 0.0f;
+  float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+  float mass = 1.0f, drag = 0.0f, radius = 0.0f, restitution = 0.0f;
+  float inertia[6] = {};
+};
+
+// Same layout, stored as columns.
+struct SoaBody : Body {};
+
+// Transform with change ticks.
+struct TrackedTransform : Transform {};
+
+// 2D scene-graph node: local offset and rotation (as cos/sin), and the composed world transform.
+struct SceneNode {
+  float lx = 0.0f, ly = 0.0f, lc = 1.0f, ls = 0.0f;
+  float wx = 0.0f, wy = 0.0f, wc = 1.0f, ws = 0.0f;
+};
+
+// What scenes store without a built-in hierarchy: the parent's (entity_idx, gen).
+struct ParentRef {
+  std::uint32_t entity_idx = 0;
+  std::uint32_t gen = 0;
+};
+
+} // namespace
+
+namespace ecs_lab {
+template <>
+struct change_ticks<TrackedTransform> : std::true_type {};
+template <>
+struct soa_fields<SoaBody> {
+  static constexpr auto members = std::make_tuple(
+      &SoaBody::x, &SoaBody::y, &SoaBody::z, &SoaBody::vx, &SoaBody::vy, &SoaBody::vz, &SoaBody::mass,
+      &SoaBody::drag, &SoaBody::radius, &SoaBody::restitution, &SoaBody::inertia);
+};
+} // namespace ecs_lab
+
+namespace {
+
+std::uint32_t xorshift32(std::uint32_t& state) {
+  std::uint32_t x = state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  state = x;
+  return x;
+}
+
+template <typename Fn>
+double time_ns(int repeats, Fn&& fn) {
+  const auto start = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < repeats; ++r) {
+    fn();
+  }
+  const auto end_time = std::chrono::high_resolution_clock::now();
+  const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start).count();
+  return static_cast<double>(ns) / static_cast<double>(repeats);
+}
+
+void bench_driver(std::size_t entities, int repeats) {
+  // Fraction of Transform entities that also carry Stunned, in 1/100000 units.
+  const std::uint32_t ratios[] = {75, 1'000, 10'000, 50'000, 100'000};
+
+  std::cout << "World::query<Transform, Stunned> benchmark\n";
+  std::cout << "entities: " << entities << "\n";
+  std::cout << "stunned%\tmatches\tT0-driven ms\tquery ms\tspeedup\n";
+
+  for (const std::uint32_t ratio : ratios) {
+    ecs_lab::World world;
+    std::uint32_t rng = 0x12345678u;
+    for (std::size_t i = 0; i < entities; ++i) {
+      auto e = world.create();
+      world.add<Transform>(e, static_cast<float>(i), 0.0f, 0.0f);
+      if (xorshift32(rng) % 100'000 < ratio) {
+        world.add<Stunned>(e, 1);
+      }
+    }
+
+    volatile float sink = 0.0f;
+    std::size_t matches = 0;
+
+    // Baseline: what query<Transform, Stunned> used to do, i.e. scan the first pool.
+    const double scan_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      matches = 0;
+      world.each<Transform>([&](ecs_lab::Entity e, Transform& t) {
+        if (auto* s = world.try_get<Stunned>(e)) {
+          acc += t.x + static_cast<float>(s->ticks);
+          ++matches;
+        }
+      });
+      sink = sink + acc;
+    });
+
+    const double query_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      world.query<Transform, Stunned>([&](ecs_lab::Entity, Transform& t, Stunned& s) {
+        acc += t.x + static_cast<float>(s.ticks);
+      });
+      sink = sink + acc;
+    });
+
+    std::cout << static_cast<double>(ratio) / 1000.0 << "\t" << matches << "\t" << scan_ns / 1e6 << "\t"
+              << query_ns / 1e6 << "\t" << scan_ns / query_ns << "\n";
+  }
+}
+
+// Registered QueryGroup vs ad-hoc query over Transform + Velocity + Stunned.
+void bench_group(std::size_t entities, int repeats) {
+  const std::uint32_t ratios[] = {1'000, 10'000, 90'000};
+
+  std::cout << "QueryGroup<Transform, Velocity, Stunned> vs query benchmark\n";
+  std::cout << "entities: " << entities << "\n";
+  std::cout << "match%\tmatches\tquery ms\tgroup ms\tspeedup\n";
+
+  for (const std::uint32_t ratio : ratios) {
+    ecs_lab::World world;
+    auto& group = world.group<Transform, Velocity, Stunned>();
+    std::uint32_t rng = 0x9E3779B9u;
+    for (std::size_t i = 0; i < entities; ++i) {
+      auto e = world.create();
+      world.add<Transform>(e, static_cast<float>(i), 0.0f, 0.0f);
+      world.add<Velocity>(e, 1.0f, 0.0f, 0.0f);
+      if (xorshift32(rng) % 100'000 < ratio) {
+        world.add<Stunned>(e, 1);
+      }
+    }
+
+    volatile float sink = 0.0f;
+    const double query_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      world.query<Transform, Velocity, Stunned>([&](ecs_lab::Entity, Transform& t, Velocity& v, Stunned&) {
+        t.x += v.vx;
+        acc += t.x;
+      });
+      sink = sink + acc;
+    });
+
+    const double group_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      group.each([&](ecs_lab::Entity, Transform& t, Velocity& v, Stunned&) {
+        t.x += v.vx;
+        acc += t.x;
+      });
+      sink = sink + acc;
+    });
+
+    std::cout << static_cast<double>(ratio) / 1000.0 << "\t" << group.size() << "\t" << query_ns / 1e6 << "\t"
+              << group_ns / 1e6 << "\t" << query_ns / group_ns << "\n";
+  }
+}
+
+// Three-term filter (Transform + Velocity, without Stunned, optional Collider): compiled
+// QueryFilter vs query<Transform, Velocity> with has/try_get checks in the callback.
+void bench_filter(std::size_t entities, int repeats) {
+  const std::uint32_t ratios[] = {10'000, 50'000, 90'000};
+
+  std::cout << "QueryFilter<With<Transform, Velocity>, Without<Stunned>, Optional<Collider>> benchmark\n";
+  std::cout << "entities: " << entities << " (Velocity 50%, Collider 30%)\n";
+  std::cout << "stunned%\tmatches\tcallback ms\tfilter ms\tspeedup\n";
+
+  using Filter = ecs_lab::QueryFilter<ecs_lab::With<Transform, Velocity>, ecs_lab::Without<Stunned>,
+                                      ecs_lab::Optional<Collider>>;
+  const Filter filter;
+
+  for (const std::uint32_t ratio : ratios) {
+    ecs_lab::World world;
+    std::uint32_t rng = 0x9E3779B9u;
+    for (std::size_t i = 0; i < entities; ++i) {
+      auto e = world.create();
+      world.add<Transform>(e, static_cast<float>(i), 0.0f, 0.0f);
+      if (xorshift32(rng) % 2 == 0) {
+        world.add<Velocity>(e, 1.0f, 0.0f, 0.0f);
+      }
+      if (xorshift32(rng) % 100'000 < ratio) {
+        world.add<Stunned>(e, 1);
+      }
+      if (xorshift32(rng) % 10 < 3) {
+        world.add<Collider>(e, 0.5f);
+      }
+    }
+
+    volatile float sink = 0.0f;
+    std::size_t matches = 0;
+    const double callback_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      matches = 0;
+      world.query<Transform, Velocity>([&](ecs_lab::Entity e, Transform& t, Velocity& v) {
+        if (world.has<Stunned>(e)) {
+          return;
+        }
+        const Collider* c = world.try_get<Collider>(e);
+        t.x += v.vx;
+        acc += c ? t.x * c->radius : t.x;
+        ++matches;
+      });
+      sink = sink + acc;
+    });
+
+    const double filter_ns = time_ns(repeats, [&] {
+      float acc = 0.0f;
+      world.query(filter, [&](ecs_lab::Entity, Transform& t, Velocity& v, Collider* c) {
+        t.x += v.vx;
+        acc += c ? t.x * c->radius : t.x;
+      });
+      sink = sink + acc;
+    });
+
+    std::cout << static_cast<double>(ratio) / 1000.0 << "\t" << matches << "\t" << callback_ns / 1e6 << "\t"
+              << filter_ns / 1e6 << "\t" << callback_ns / filter_ns << "\n";
+  }
+}
+
+// A system that only needs rows changed since its last run: rescanning every row with each<T>
+// vs a Changed<T> filter, with the changed rows spread at random (most blocks touched) or
+// clustered at the front of the pool.
+void bench_changed(std::size_t entities, int repeats) {
+  const std::uint32_t ratios[] = {100, 1'000, 10'000};
+
+  std::cout << "Changed<TrackedTransform> vs full scan benchmark\n";
+  std::cout << "entities: " << entities << "\n";
+  std::cout << "changed%\tlayout\tmatches\teach ms\tChanged ms\tspeedup\n";
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es;
+  for (std::size_t i = 0; i < entities; ++i) {
+    auto e = world.create();
+    world.add<TrackedTransform>(e, TrackedTransform{{static_cast<float>(i), 0.0f, 0.0f}});
+    es.push_back(e);
+  }
+  ecs_lab::QueryFilter<ecs_lab::With<TrackedTransform>, ecs_lab::Changed<TrackedTransform>> changed;
+
+  for (const std::uint32_t ratio : ratios) {
+    for (const bool clustered : {false, true}) {
+      changed.since = world.advance_tick();
+      std::uint32_t rng = 0x9E3779B9u;
+      const std::size_t count = entities * ratio / 100'000;
+      for (std::size_t k = 0; k < count; ++k) {
+        const std::size_t i = clustered ? k : xorshift32(rng) % entities;
+        world.get<TrackedTransform>(es[i]).y += 1.0f;
+      }
+
+      volatile float sink = 0.0f;
+      const double each_ns = time_ns(repeats, [&] {
+        float acc = 0.0f;
+        world.each<TrackedTransform>([&](TrackedTransform& t) { acc += t.y; });
+        sink = sink + acc;
+      });
+
+      std::size_t matches = 0;
+      const double changed_ns = time_ns(repeats, [&] {
+        float acc = 0.0f;
+        matches = 0;
+        world.query(changed, [&](ecs_lab::Entity, TrackedTransform& t) {
+          ++matches;
+          acc += t.y;
+        });
+        sink = sink + acc;
+      });
+
+      std::cout << static_cast<double>(ratio) / 1000.0 << "\t" << (clustered ? "clustered" : "random") << "\t"
+                << matches << "\t" << each_ns / 1e6 << "\t" << changed_ns / 1e6 << "\t" << each_ns / changed_ns
+                << "\n";
+    }
+  }
+}
+
+void compose(SceneNode& node, const SceneNode* parent) {
+  if (!parent) {
+    node.wx = node.lx;
+    node.wy = node.ly;
+    node.wc = node.lc;
+    node.ws = node.ls;
+    return;
+  }
+  node.wx = parent->wx + parent->wc * node.lx - parent->ws * node.ly;
+  node.wy = parent->wy + parent->ws * node.lx + parent->wc * node.ly;
+  node.wc = parent->wc * node.lc - parent->ws * node.ls;
+  node.ws = parent->ws * node.lc + parent->wc * node.ls;
+}
+
+// Transform propagation over a random forest whose pool order is shuffled relative to the tree:
+// parent handles in a user component looked up per node, vs World::hierarchy's depth-ordered pass.
+void bench_hierarchy(std::size_t nodes, int repeats) {
+  std::cout << "Transform propagation benchmark\n";
+  std::cout << "nodes: " << nodes << "\n";
+
+  // Node i's parent is a random earlier node (the first 1000 are roots).
+  std::uint32_t rng = 0x2545F491u;
+  std::vector<std::uint32_t> parent(nodes, 0);
+  for (std::size_t i = 1000; i < nodes; ++i) {
+    parent[i] = xorshift32(rng) % static_cast<std::uint32_t>(i);
+  }
+  std::vector<std::uint32_t> slot(nodes);
+  for (std::size_t i = 0; i < nodes; ++i) {
+    slot[i] = static_cast<std::uint32_t>(i);
+  }
+  for (std::size_t i = nodes; i > 1; --i) {
+    std::swap(slot[i - 1], slot[xorshift32(rng) % i]);
+  }
+  auto local = [](std::size_t i) {
+    const float a = static_cast<float>(i % 360) * 0.0174533f;
+    return SceneNode{1.0f, 0.5f, std::cos(a), std::sin(a)};
+  };
+
+  volatile float sink = 0.0f;
+  double lookup_ns = 0.0;
+  {
+    ecs_lab::World world;
+    std::vector<ecs_lab::Entity> es(nodes);
+    world.create_n(nodes, es);
+    for (std::size_t k = 0; k < nodes; ++k) {
+      const std::size_t i = slot[k];
+      world.add<SceneNode>(es[i], local(i));
+      if (i >= 1000) {
+        world.add<ParentRef>(es[i], es[parent[i]].entity_idx, es[parent[i]].gen);
+      }
+    }
+    // Node order is already parents-first.
+    lookup_ns = time_ns(repeats, [&] {
+      for (const auto e : es) {
+        auto* node = world.try_get<SceneNode>(e);
+        const auto* ref = std::as_const(world).try_get<ParentRef>(e);
+        compose(*node, ref ? world.try_get_idx_gen<SceneNode>(ref->entity_idx, ref->gen) : nullptr);
+      }
+      sink = sink + world.get<SceneNode>(es.back()).wx;
+    });
+  }
+
+  ecs_lab::World world;
+  auto& order = world.hierarchy<SceneNode>();
+  std::vector<ecs_lab::Entity> es(nodes);
+  world.create_n(nodes, es);
+  for (std::size_t k = 0; k < nodes; ++k) {
+    world.add<SceneNode>(es[slot[k]], local(slot[k]));
+  }
+  for (std::size_t i = 1000; i < nodes; ++i) {
+    world.set_parent(es[i], es[parent[i]]);
+  }
+  const double sort_ns = time_ns(1, [&] { order.size(); });
+  const double ordered_ns = time_ns(repeats, [&] {
+    order.each(compose);
+    sink = sink + world.get<SceneNode>(es.back()).wx;
+  });
+
+  // 1% of the nodes move under a random earlier node, then one pass (which re-sorts).
+  const std::size_t moves = nodes / 100;
+  double reparent_ns = 0.0;
+  double resort_ns = 0.0;
+  for (int r = 0; r < repeats; ++r) {
+    reparent_ns += time_ns(1, [&] {
+      for (std::size_t k = 0; k < moves; ++k) {
+        const std::size_t i = 1000 + xorshift32(rng) % (nodes - 1000);
+        world.set_parent(es[i], es[xorshift32(rng) % i]);
+      }
+    });
+    resort_ns += time_ns(1, [&] { order.each(compose); });
+  }
+
+  std::cout << "handle lookups\t" << lookup_ns / 1e6 << " ms/pass\n";
+  std::cout << "hierarchy\t" << ordered_ns / 1e6 << " ms/pass\t(first sort " << sort_ns / 1e6 << " ms)\t"
+            << lookup_ns / ordered_ns << "x\n";
+  std::cout << "reparent 1%\t" << reparent_ns / repeats / 1e6 << " ms\tnext pass " << resort_ns / repeats / 1e6
+            << " ms\n";
+}
+
+// A query over a Transform pool shuffled by churn, before and after sort_like puts it back in
+// Velocity's (creation) order, all at once or two blocks per step.
+void bench_sort(std::size_t entities, int repeats) {
+  std::cout << "sort_like<Transform, Velocity> benchmark\n";
+  std::cout << "entities: " << entities << "\n";
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  world.create_n(entities, es);
+  std::vector<std::size_t> order(entities);
+  for (std::size_t i = 0; i < entities; ++i) {
+    order[i] = i;
+    world.add<Velocity>(es[i], 1.0f, 0.0f, 0.0f);
+  }
+  std::uint32_t rng = 0x9E3779B9u;
+  for (std::size_t i = entities; i > 1; --i) {
+    std::swap(order[i - 1], order[xorshift32(rng) % i]);
+  }
+  for (const std::size_t i : order) {
+    world.add<Transform>(es[i], static_cast<float>(i), 0.0f, 0.0f);
+  }
+
+  volatile float sink = 0.0f;
+  auto run_query = [&] {
+    return time_ns(repeats, [&] {
+      float acc = 0.0f;
+      world.query<Transform, Velocity>([&](ecs_lab::Entity, Transform& t, Velocity& v) {
+        t.x += v.vx;
+        acc += t.x;
+      });
+      sink = sink + acc;
+    });
+  };
+
+  const double shuffled_ns = run_query();
+  auto snap = world.snapshot();
+  const double sort_ns = time_ns(1, [&] { world.sort_like<Transform, Velocity>(); });
+  const double sorted_ns = run_query();
+
+  world.restore(snap);
+  auto sort = world.begin_sort_like<Transform, Velocity>();
+  int steps = 0;
+  double step_max_ns = 0.0;
+  double step_total_ns = 0.0;
+  for (bool done = false; !done; ++steps) {
+    const double ns = time_ns(1, [&] { done = world.sort_step(sort, 2); });
+    step_max_ns = std::max(step_max_ns, ns);
+    step_total_ns += ns;
+  }
+  const double stepped_ns = run_query();
+
+  std::cout << "shuffled query\t" << shuffled_ns / 1e6 << " ms\n";
+  std::cout << "sort_like\t" << sort_ns / 1e6 << " ms\tquery " << sorted_ns / 1e6 << " ms\t"
+            << shuffled_ns / sorted_ns << "x\n";
+  std::cout << "sort_step(2)\t" << steps << " steps\tmax " << step_max_ns / 1e6 << " ms\ttotal "
+            << step_total_ns / 1e6 << " ms\tquery " << stepped_ns / 1e6 << " ms\n";
+}
+
+// Packed (owning) group vs per-type pools: iteration speed and add/remove cost.
+void bench_pack(std::size_t entities, int repeats) {
+  std::cout << "PackedGroup<Transform, Velocity, Collider> benchmark\n";
+  std::cout << "entities: " << entities << " (50% carry all three components)\n";
+
+  auto populate = [&](ecs_lab::World& world, std::vector<ecs_lab::Entity>& out) {
+    std::uint32_t rng = 0xC0FFEEu;
+    for (std::size_t i = 0; i < entities; ++i) {
+      auto e = world.create();
+      world.add<Transform>(e, static_cast<float>(i), 0.0f, 0.0f);
+      if (xorshift32(rng) % 2 == 0) {
+        world.add<Velocity>(e, 1.0f, 0.0f, 0.0f);
+        world.add<Collider>(e, 0.5f);
+      }
+      out.push_back(e);
+    }
+  };
+
+  ecs_lab::World plain;
+  std::vector<ecs_lab::Entity> plain_entities;
+  plain_entities.reserve(entities);
+  auto& group = plain.group<Transform, Velocity, Collider>();
+  populate(plain, plain_entities);
+
+  ecs_lab::World packed_world;
+  std::vector<ecs_lab::Entity> packed_entities;
+  packed_entities.reserve(entities);
+  auto& packed = packed_world.pack<Transform, Velocity, Collider>();
+  populate(packed_world, packed_entities);
+
+  volatile float sink = 0.0f;
+  auto kernel = [](Transform& t, Velocity& v, Collider& c) { t.x += v.vx * c.radius; };
+
+  const double query_ns = time_ns(repeats, [&] {
+    plain.query<Transform, Velocity, Collider>(
+        [&](ecs_lab::Entity, Transform& t, Velocity& v, Collider& c) { kernel(t, v, c); });
+  });
+  const double group_ns = time_ns(repeats, [&] {
+    group.each([&](ecs_lab::Entity, Transform& t, Velocity& v, Collider& c) { kernel(t, v, c); });
+  });
+  const double packed_ns = time_ns(repeats, [&] { packed.each(kernel); });
+
+  std::cout << "iterate ms\tquery " << query_ns / 1e6 << "\tgroup " << group_ns / 1e6 << "\tpacked "
+            << packed_ns / 1e6 << "\n";
+
+  // Toggle Velocity on 10% of entities (remove then re-add).
+  auto churn = [&](ecs_lab::World& world, std::vector<ecs_lab::Entity>& list) {
+    for (std::size_t i = 0; i < list.size(); i += 10) {
+      if (auto* v = world.try_get<Velocity>(list[i])) {
+        const Velocity saved = *v;
+        world.remove<Velocity>(list[i]);
+        world.add<Velocity>(list[i], saved);
+      }
+    }
+  };
+  const double plain_churn_ns = time_ns(repeats, [&] { churn(plain, plain_entities); });
+  const double packed_churn_ns = time_ns(repeats, [&] { churn(packed_world, packed_entities); });
+
+  std::cout << "churn ms\tgroup world " << plain_churn_ns / 1e6 << "\tpacked world " << packed_churn_ns / 1e6
+            << "\n";
+  sink = sink + static_cast<float>(packed.size());
+}
+
+void bench_chunk(std::size_t entities, int repeats) {
+  std::cout << "each vs each_chunk integrate (pos += vel * dt) benchmark\n";
+  std::cout << "entities: " << entities << ", component: " << sizeof(Motion) << " bytes\n";
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> list;
+  for (std::size_t i = 0; i < entities; ++i) {
+    auto e = world.create();
+    world.add<Motion>(e, Motion{static_cast<float>(i), 0.0f, 0.0f, 1.0f, 0.5f, -0.25f});
+    list.push_back(e);
+  }
+  // Some churn, so pool order is not arena order.
+  std::uint32_t rng = 0xBADC0DEu;
+  for (std::size_t i = 0; i < entities / 10; ++i) {
+    const auto e = list[xorshift32(rng) % list.size()];
+    if (world.has<Motion>(e)) {
+      const Motion m = world.get<Motion>(e);
+      world.remove<Motion>(e);
+      world.add<Motion>(e, m);
+    }
+  }
+
+  constexpr float dt = 1.0f / 60.0f;
+  const double each_ns = time_ns(repeats, [&] {
+    world.each<Motion>([&](ecs_lab::Entity, Motion& m) {
+      m.x += m.vx * dt;
+      m.y += m.vy * dt;
+      m.z += m.vz * dt;
+    });
+  });
+  const double each_data_ns = time_ns(repeats, [&] {
+    world.each<Motion>([&](Motion& m) {
+      m.x += m.vx * dt;
+      m.y += m.vy * dt;
+      m.z += m.vz * dt;
+    });
+  });
+  const double chunk_ns = time_ns(repeats, [&] {
+    world.each_chunk<Motion>([&](std::span<ecs_lab::Component<Motion>> rows) {
+      for (auto& row : rows) {
+        Motion& m = row.data;
+        m.x += m.vx * dt;
+        m.y += m.vy * dt;
+        m.z += m.vz * dt;
+      }
+    });
+  });
+
+  const double n = static_cast<double>(entities);
+  std::cout << "api\tms\tns/entity\n";
+  std::cout << "each(Entity, T&)\t" << each_ns / 1e6 << "\t" << each_ns / n << "\n";
+  std::cout << "each(T&)\t" << each_data_ns / 1e6 << "\t" << each_data_ns / n << "\n";
+  std::cout << "each_chunk\t" << chunk_ns / 1e6 << "\t" << chunk_ns / n << "\n";
+  std::cout << "speedup vs each(Entity, T&)\t" << each_ns / chunk_ns << "x\n";
+}
+
+void bench_soa(std::size_t entities, int repeats) {
+  std::cout << "AoS vs SoA integrate (pos += vel * dt) benchmark\n";
+  std::cout << "entities: " << entities << ", component: " << sizeof(Body) << " bytes, kernel uses 24 of them\n";
+
+  ecs_lab::World aos;
+  ecs_lab::World soa;
+  for (std::size_t i = 0; i < entities; ++i) {
+    Body b;
+    b.x = static_cast<float>(i);
+    b.vx = 1.0f;
+    b.vy = 0.5f;
+    b.vz = -0.25f;
+    aos.add<Body>(aos.create(), b);
+    soa.add<SoaBody>(soa.create(), SoaBody{b});
+  }
+
+  constexpr float dt = 1.0f / 60.0f;
+  const double aos_ns = time_ns(repeats, [&] {
+    aos.each<Body>([&](ecs_lab::Entity, Body& b) {
+      b.x += b.vx * dt;
+      b.y += b.vy * dt;
+      b.z += b.vz * dt;
+    });
+  });
+  const double soa_ns = time_ns(repeats, [&] {
+    soa.each_block<SoaBody>([&](ecs_lab::SoaBlock<SoaBody> block) {
+      auto x = block.field<&SoaBody::x>();
+      auto y = block.field<&SoaBody::y>();
+      auto z = block.field<&SoaBody::z>();
+      const auto vx = block.field<&SoaBody::vx>();
+      const auto vy = block.field<&SoaBody::vy>();
+      const auto vz = block.field<&SoaBody::vz>();
+      for (std::size_t i = 0; i < block.size(); ++i) {
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        z[i] += vz[i] * dt;
+      }
+    });
+  });
+
+  const double aos_mb = static_cast<double>(entities * sizeof(ecs_lab::Component<Body>)) / 1e6;
+  const double soa_mb = static_cast<double>(entities * 6 * sizeof(float)) / 1e6;
+  std::cout << "layout\tms\tns/entity\tMB touched\n";
+  std::cout << "AoS each\t" << aos_ns / 1e6 << "\t" << aos_ns / static_cast<double>(entities) << "\t" << aos_mb
+            << "\n";
+  std::cout << "SoA each_block\t" << soa_ns / 1e6 << "\t" << soa_ns / static_cast<double>(entities) << "\t"
+            << soa_mb << "\n";
+  std::cout << "speedup\t" << aos_ns / soa_ns << "x\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t entities = 400'000;
+  int repeats = 20;
+  bool run_driver = true;
+  bool run_group = true;
+  bool run_pack = true;
+  bool run_chunk = true;
+  bool run_soa = true;
+  bool run_filter = true;
+  bool run_changed = true;
+  bool run_hierarchy = true;
+  bool run_sort = true;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--driver") {
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--group") {
+      run_driver = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--pack") {
+      run_driver = false;
+      run_group = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--soa") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--chunk") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--filter") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_changed = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--changed") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_hierarchy = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--hierarchy") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_sort = false;
+      continue;
+    }
+    if (arg == "--sort") {
+      run_driver = false;
+      run_group = false;
+      run_pack = false;
+      run_chunk = false;
+      run_soa = false;
+      run_filter = false;
+      run_changed = false;
+      run_hierarchy = false;
+      continue;
+    }
+    if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0]))) {
+      entities = static_cast<std::size_t>(std::stoull(arg));
+    }
+  }
+
+  if (run_driver) {
+    bench_driver(entities, repeats);
+  }
+  if (run_group) {
+    bench_group(entities, repeats);
+  }
+  if (run_pack) {
+    bench_pack(entities, repeats);
+  }
+  if (run_chunk) {
+    bench_chunk(entities, repeats);
+  }
+  if (run_soa) {
+    bench_soa(entities, repeats);
+  }
+  if (run_filter) {
+    bench_filter(entities, repeats);
+  }
+  if (run_changed) {
+    bench_changed(entities, repeats);
+  }
+  if (run_hierarchy) {
+    // 1M nodes at the default size.
+    bench_hierarchy(entities * 5 / 2, repeats / 4);
+  }
+  if (run_sort) {
+    bench_sort(entities, repeats);
+  }
+  return 0;
+}
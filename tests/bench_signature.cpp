@@ -1,5 +1,7 @@
 #include "ecs_lab/signature.hpp"
+#include "ecs_lab/signature_match.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
 #include <cctype>
@@ -7,6 +9,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace {
 
@@ -19,19 +22,86 @@ std::uint32_t xorshift32(std::uint32_t& state) {
   return x;
 }
 
+// Matches `iterations` signatures in passes over an array of `count` (random 3-8 of the first 40
+// components each; ~1/4 match): per-row contains_all/intersects as World::query does it, then
+// match_signatures at each SIMD level this CPU has.
+void bench_batch(std::size_t count, std::size_t iterations, std::uint32_t& rng) {
+  std::vector<ecs_lab::Signature<>> sigs(count);
+  for (auto& sig : sigs) {
+    const std::uint32_t bits = 3 + xorshift32(rng) % 6;
+    for (std::uint32_t b = 0; b < bits; ++b) {
+      sig.set(static_cast<ecs_lab::ComponentId>(xorshift32(rng) % 40));
+    }
+    if (xorshift32(rng) % 2 == 0) {
+      sig.set(1);
+      sig.set(2);
+    }
+  }
+  ecs_lab::Signature<> required;
+  required.set(1);
+  required.set(2);
+  ecs_lab::Signature<> excluded;
+  excluded.set(3);
+
+  const std::size_t passes = std::max<std::size_t>(1, iterations / count);
+  const double total = static_cast<double>(passes * count);
+  std::vector<std::uint64_t> out((count + 63) / 64);
+  std::cout << "batch signature matching: " << count << " signatures x " << passes << " passes\n";
+
+  auto report = [&](const char* label, double ns, std::size_t matches) {
+    std::cout << label << "\t" << ns / total << " ns/sig\t" << total / ns << " Gsig/s\t(" << matches
+              << " matches)\n";
+  };
+
+  std::size_t matches = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (std::size_t p = 0; p < passes; ++p) {
+    for (const auto& sig : sigs) {
+      matches += sig.contains_all(required) && !sig.intersects(excluded) ? 1 : 0;
+    }
+  }
+  auto ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+  report("per-row", ns, matches);
+
+  const ecs_lab::SimdLevel levels[] = {ecs_lab::SimdLevel::kScalar, ecs_lab::SimdLevel::kAvx2,
+                                       ecs_lab::SimdLevel::kAvx512};
+  const char* names[] = {"batch scalar", "batch avx2", "batch avx512"};
+  for (std::size_t l = 0; l < 3; ++l) {
+    if (levels[l] > ecs_lab::cpu_simd_level()) {
+      std::cout << names[l] << "\tunsupported\n";
+      continue;
+    }
+    matches = 0;
+    start = std::chrono::high_resolution_clock::now();
+    for (std::size_t p = 0; p < passes; ++p) {
+      matches += ecs_lab::match_signatures(sigs.data(), count, required, excluded, out.data(), levels[l]);
+    }
+    ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+    report(names[l], ns, matches);
+  }
+}
+
 } // namespace
 
 int main(int argc, char** argv) {
   std::size_t iterations = 50'000'000;
   bool run_mem = true;
   bool run_pure = true;
+  bool run_batch = true;
   for (int i = 1; i < argc; ++i) {
     const std::string arg = argv[i];
     if (arg == "--pure") {
       run_mem = false;
+      run_batch = false;
       continue;
     }
     if (arg == "--mem") {
+      run_pure = false;
+      run_batch = false;
+      continue;
+    }
+    if (arg == "--batch") {
+      run_mem = false;
       run_pure = false;
       continue;
     }
@@ -113,5 +183,11 @@ int main(int argc, char** argv) {
     std::cout << "ns/call: " << per_call << "\n";
     std::cout << "sink: " << sink << "\n";
   }
+
+  if (run_batch) {
+    // One arena block's signature column (cache resident), then 1M entities' worth.
+    bench_batch(4096, iterations * 4, rng);
+    bench_batch(std::size_t{1} << 20, iterations, rng);
+  }
   return 0;
 }
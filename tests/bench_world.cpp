@@ -0,0 +1,794 @@
+#include "ecs_lab/ecs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct Position {
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+struct Velocity {
+  float vx = 0.0f;
+  float vy = 0.0f;
+};
+
+struct Health {
+  int hp = 0;
+};
+
+struct Faction {
+  int id = 0;
+};
+
+// Eight interchangeable components for entities with wider signatures.
+template <int N>
+struct Slot {
+  std::uint32_t value = 0;
+};
+
+// Same layout as Position, stored in a handle-stable pool.
+struct StablePosition {
+  float x = 0.0f;
+  float y = 0.0f;
+};
+
+// Same layout as Velocity, looked up through a sparse index.
+struct SparseVelocity {
+  float vx = 0.0f;
+  float vy = 0.0f;
+};
+
+} // namespace
+
+namespace ecs_lab {
+template <>
+struct stable_storage<StablePosition> : std::true_type {};
+template <>
+struct sparse_lookup<SparseVelocity> : std::true_type {};
+} // namespace ecs_lab
+
+namespace {
+
+using Clock = std::chrono::high_resolution_clock;
+
+double seconds_since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void report(const char* label, std::size_t count, double seconds) {
+  std::cout << label << "\t" << seconds * 1e3 << " ms\t" << static_cast<double>(count) / seconds / 1e6
+            << " M entities/s\n";
+}
+
+// Wave spawner: spawn `wave` entities, then kill them all, `frames` times.
+void bench_batch(std::size_t wave, int frames) {
+  const auto prefab = ecs_lab::make_prefab(Position{}, Velocity{1.0f, 0.0f}, Health{100}, Faction{2});
+  const std::size_t total = wave * static_cast<std::size_t>(frames);
+
+  std::cout << "Batch create/instantiate/destroy benchmark\n";
+  std::cout << "wave: " << wave << ", frames: " << frames << "\n";
+
+  {
+    ecs_lab::World world;
+    std::vector<ecs_lab::Entity> out(wave);
+    double create_s = 0.0;
+    double destroy_s = 0.0;
+    for (int f = 0; f < frames; ++f) {
+      auto start = Clock::now();
+      for (std::size_t i = 0; i < wave; ++i) {
+        out[i] = world.create();
+      }
+      create_s += seconds_since(start);
+      start = Clock::now();
+      for (const auto e : out) {
+        world.destroy(e);
+      }
+      destroy_s += seconds_since(start);
+    }
+    report("create", total, create_s);
+  }
+  {
+    ecs_lab::World world;
+    std::vector<ecs_lab::Entity> out(wave);
+    double create_s = 0.0;
+    for (int f = 0; f < frames; ++f) {
+      const auto start = Clock::now();
+      world.create_n(wave, out);
+      create_s += seconds_since(start);
+      world.destroy_batch(out);
+    }
+    report("create_n", total, create_s);
+  }
+
+  double single_destroy_s = 0.0;
+  {
+    ecs_lab::World world;
+    std::vector<ecs_lab::Entity> out(wave);
+    double spawn_s = 0.0;
+    for (int f = 0; f < frames; ++f) {
+      auto start = Clock::now();
+      for (std::size_t i = 0; i < wave; ++i) {
+        out[i] = world.instantiate(prefab);
+      }
+      spawn_s += seconds_since(start);
+      start = Clock::now();
+      for (const auto e : out) {
+        world.destroy(e);
+      }
+      single_destroy_s += seconds_since(start);
+    }
+    report("instantiate", total, spawn_s);
+  }
+  {
+    ecs_lab::World world;
+    std::vector<ecs_lab::Entity> out(wave);
+    double spawn_s = 0.0;
+    double destroy_s = 0.0;
+    for (int f = 0; f < frames; ++f) {
+      auto start = Clock::now();
+      world.instantiate_n(prefab, wave, out);
+      spawn_s += seconds_since(start);
+      start = Clock::now();
+      world.destroy_batch(out);
+      destroy_s += seconds_since(start);
+    }
+    report("instantiate_n", total, spawn_s);
+    report("destroy (4 comps)", total, single_destroy_s);
+    report("destroy_batch", total, destroy_s);
+  }
+}
+
+// Swap-erase vs handle-stable pool: remove/re-add churn, iteration with holes, compaction.
+template <typename P>
+void bench_stable_variant(const char* label, std::size_t entities, int frames) {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  world.create_n(entities, es);
+  for (const auto e : es) {
+    world.add<P>(e, 1.0f, 2.0f);
+    world.add<Velocity>(e, 1.0f, 0.0f);
+  }
+
+  // Each frame ~10% of the entities lose P (iterated while missing), then regain it.
+  std::uint32_t rng = 0x2545F491u;
+  std::vector<ecs_lab::Entity> churned;
+  double churn_s = 0.0;
+  double iterate_s = 0.0;
+  volatile float sink = 0.0f;
+  for (int f = 0; f < frames; ++f) {
+    churned.clear();
+    for (std::size_t i = 0; i < entities / 10; ++i) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      churned.push_back(es[rng % entities]);
+    }
+    auto start = Clock::now();
+    for (const auto e : churned) {
+      world.template remove<P>(e);
+    }
+    churn_s += seconds_since(start);
+
+    start = Clock::now();
+    float acc = 0.0f;
+    world.template each<P>([&](ecs_lab::Entity, P& p) { acc += p.x; });
+    iterate_s += seconds_since(start);
+    sink = sink + acc;
+
+    start = Clock::now();
+    for (const auto e : churned) {
+      if (!world.template has<P>(e)) {
+        world.template add<P>(e, 1.0f, 2.0f);
+      }
+    }
+    churn_s += seconds_since(start);
+  }
+
+  // Leave 10% holes and measure one compaction pass.
+  for (std::size_t i = 0; i < entities; i += 10) {
+    world.template remove<P>(es[i]);
+  }
+  const auto start = Clock::now();
+  world.template compact<P>();
+  const double compact_s = seconds_since(start);
+
+  std::cout << label << "\tchurn " << churn_s * 1e3 << " ms\titerate "  << iterate_s * 1e3
+            << " ms\tcompact " << compact_s * 1e3 << " ms\n";
+}
+
+void bench_stable(std::size_t entities, int frames) {
+  std::cout << "Swap-erase vs handle-stable pool benchmark\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+  bench_stable_variant<Position>("swap-erase", entities, frames);
+  bench_stable_variant<StablePosition>("stable", entities, frames);
+}
+
+// Random handle lookups of V on entities with 2-4 components (10% of handles stale), and the
+// add/remove churn that has to keep V's index up to date.
+template <typename V>
+void bench_sparse_variant(const char* label, std::size_t entities, int frames) {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  world.create_n(entities, es);
+  for (std::size_t i = 0; i < entities; ++i) {
+    world.add<Position>(es[i], static_cast<float>(i), 0.0f);
+    if (i % 2 == 0) {
+      world.add<Health>(es[i], 1);
+    }
+    world.template add<V>(es[i], 1.0f, 0.0f);
+    if (i % 3 == 0) {
+      world.add<Faction>(es[i], 1);
+    }
+  }
+  for (std::size_t i = 0; i < entities; i += 10) {
+    world.destroy(es[i]);
+  }
+
+  std::vector<ecs_lab::Entity> order(es);
+  std::uint32_t rng = 0x9E3779B9u;
+  for (std::size_t i = order.size(); i > 1; --i) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    std::swap(order[i - 1], order[rng % i]);
+  }
+
+  std::size_t hits = 0;
+  auto start = Clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (const auto e : order) {
+      if (auto* v = world.template try_get<V>(e)) {
+        v->vx += 1.0f;
+        ++hits;
+      }
+    }
+  }
+  const double lookup_ns = seconds_since(start) * 1e9 / (static_cast<double>(entities) * frames);
+
+  // A tenth of the live entities lose V, then regain it.
+  start = Clock::now();
+  for (std::size_t i = 1; i < entities; i += 10) {
+    world.template remove<V>(es[i]);
+  }
+  for (std::size_t i = 1; i < entities; i += 10) {
+    world.template add<V>(es[i], 1.0f, 0.0f);
+  }
+  const double churn_s = seconds_since(start);
+
+  std::cout << label << "\ttry_get " << lookup_ns << " ns\tchurn " << churn_s * 1e3 << " ms\t(" << hits
+            << " hits)\n";
+}
+
+void bench_sparse(std::size_t entities, int frames) {
+  std::cout << "Rank vs sparse-set lookup benchmark\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+  bench_sparse_variant<Velocity>("rank", entities, frames);
+  bench_sparse_variant<SparseVelocity>("sparse", entities, frames);
+}
+
+// Copy-on-write snapshots: take/restore cost, and the copy cost paid by the first writes after.
+void bench_snapshot(std::size_t entities, int frames) {
+  std::cout << "Copy-on-write snapshot benchmark\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  world.instantiate_n(ecs_lab::make_prefab(Position{}, Velocity{1.0f, 0.0f}, Health{100}, Faction{2}), entities,
+                      es);
+
+  // Rollback loop: snapshot, touch 1% of the entities, restore.
+  std::uint32_t rng = 0x2545F491u;
+  double snapshot_s = 0.0;
+  double write_s = 0.0;
+  double restore_s = 0.0;
+  for (int f = 0; f < frames; ++f) {
+    auto start = Clock::now();
+    auto snap = world.snapshot();
+    snapshot_s += seconds_since(start);
+
+    start = Clock::now();
+    for (std::size_t i = 0; i < entities / 100; ++i) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      world.get<Position>(es[rng % entities]).x += 1.0f;
+    }
+    write_s += seconds_since(start);
+
+    start = Clock::now();
+    world.restore(snap);
+    restore_s += seconds_since(start);
+  }
+  std::cout << "snapshot\t" << snapshot_s * 1e3 / frames << " ms/frame\n";
+  std::cout << "write 1%\t" << write_s * 1e3 / frames << " ms/frame\n";
+  std::cout << "restore\t" << restore_s * 1e3 / frames << " ms/frame\n";
+
+  // Writing every component after a snapshot copies every block: the old deep-copy cost, paid lazily.
+  auto snap = world.snapshot();
+  const auto start = Clock::now();
+  world.each<Position>([](ecs_lab::Entity, Position& p) { p.x += 1.0f; });
+  world.each<Velocity>([](ecs_lab::Entity, Velocity& v) { v.vx += 1.0f; });
+  world.each<Health>([](ecs_lab::Entity, Health& h) { ++h.hp; });
+  world.each<Faction>([](ecs_lab::Entity, Faction& fa) { ++fa.id; });
+  std::cout << "write all\t" << seconds_since(start) * 1e3 << " ms\n";
+}
+
+// Delta snapshots against one base: delta size and apply time vs a full restore at a given churn.
+void bench_delta_churn(std::size_t entities, double churn, int frames) {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  const auto prefab = ecs_lab::make_prefab(Position{}, Velocity{1.0f, 0.0f}, Health{100}, Faction{2});
+  world.instantiate_n(prefab, entities, es);
+  const auto base = world.snapshot();
+
+  // Each tick writes Position of `churn` of the entities and respawns a tenth of those.
+  std::uint32_t rng = 0x2545F491u;
+  const std::size_t touched = static_cast<std::size_t>(static_cast<double>(entities) * churn);
+  double delta_s = 0.0;
+  double apply_s = 0.0;
+  double restore_s = 0.0;
+  std::size_t delta_bytes = 0;
+  std::size_t dirty_blocks = 0;
+  for (int f = 0; f < frames; ++f) {
+    for (std::size_t i = 0; i < touched; ++i) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      auto& e = es[rng % entities];
+      if (i % 10 == 0) {
+        world.destroy(e);
+        e = world.instantiate(prefab);
+      } else {
+        world.get<Position>(e).x += 1.0f;
+      }
+    }
+    auto start = Clock::now();
+    const auto delta = world.snapshot_delta(base);
+    delta_s += seconds_since(start);
+    delta_bytes += delta.dirty_bytes();
+    dirty_blocks += delta.dirty_blocks();
+    const auto full = world.snapshot();
+
+    start = Clock::now();
+    world.restore_delta(base, delta);
+    apply_s += seconds_since(start);
+
+    // Keep the rebuilt state alive so the timed restore does not include freeing it.
+    const auto applied = world.snapshot();
+    start = Clock::now();
+    world.restore(full);
+    restore_s += seconds_since(start);
+  }
+  std::cout << churn * 100.0 << "% churn\tdelta " << static_cast<double>(delta_bytes) / frames / (1 << 20)
+            << " MB (" << dirty_blocks / static_cast<std::size_t>(frames) << " blocks)\tsnapshot_delta "
+            << delta_s * 1e3 / frames << " ms\trestore_delta " << apply_s * 1e3 / frames << " ms\trestore "
+            << restore_s * 1e3 / frames << " ms\n";
+}
+
+void bench_delta(std::size_t entities, int frames) {
+  std::cout << "Delta snapshot benchmark\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+  bench_delta_churn(entities, 0.01, frames);
+  bench_delta_churn(entities, 0.10, frames);
+}
+
+// Binary snapshot save/load throughput through a file (page cache, not the disk, for repeat runs).
+void bench_serialize(std::size_t entities, int frames) {
+  std::cout << "Snapshot serialization benchmark\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+  ecs_lab::register_component<Position>("bench.position");
+  ecs_lab::register_component<Velocity>("bench.velocity");
+  ecs_lab::register_component<Health>("bench.health");
+  ecs_lab::register_component<Faction>("bench.faction");
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  world.instantiate_n(ecs_lab::make_prefab(Position{}, Velocity{1.0f, 0.0f}, Health{100}, Faction{2}), entities,
+                      es);
+  auto snap = world.snapshot();
+  const std::string path = (std::filesystem::temp_directory_path() / "ecs_lab_bench.snap").string();
+
+  double save_s = 0.0;
+  double load_s = 0.0;
+  double map_s = 0.0;
+  double scan_s = 0.0;
+  volatile float sink = 0.0f;
+  for (int f = 0; f < frames; ++f) {
+    auto start = Clock::now();
+    if (!ecs_lab::save_snapshot(snap, path)) {
+      std::cout << "save failed\n";
+      return;
+    }
+    save_s += seconds_since(start);
+
+    ecs_lab::World::Snapshot loaded;
+    start = Clock::now();
+    if (!ecs_lab::load_snapshot(path, loaded)) {
+      std::cout << "load failed\n";
+      return;
+    }
+    load_s += seconds_since(start);
+
+    ecs_lab::World::Snapshot mapped;
+    start = Clock::now();
+    if (!ecs_lab::map_snapshot(path, mapped)) {
+      std::cout << "map failed\n";
+      return;
+    }
+    map_s += seconds_since(start);
+
+    // First read-only pass over the mapped rows (pages fault in from the page cache).
+    const auto& items =
+        static_cast<const ecs_lab::Pool<Position>&>(*mapped.pools[ecs_lab::component_id<Position>()]).items;
+    start = Clock::now();
+    float acc = 0.0f;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+      acc += items[i].data.x;
+    }
+    scan_s += seconds_since(start);
+    sink = sink + acc;
+  }
+  const double mb = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+  std::cout << "file\t" << mb << " MB\n";
+  std::cout << "save\t" << save_s * 1e3 / frames << " ms\t" << mb * frames / save_s << " MB/s\n";
+  std::cout << "load\t" << load_s * 1e3 / frames << " ms\t" << mb * frames / load_s << " MB/s\n";
+  std::cout << "map\t" << map_s * 1e3 / frames << " ms\t" << mb * frames / map_s << " MB/s\n";
+  std::cout << "scan mapped Position\t" << scan_s * 1e3 / frames << " ms\n";
+
+  // Tick thread during a background save: frame times vs the same frames without a save.
+  snap = ecs_lab::World::Snapshot();
+  const auto tick = [&world] {
+    const auto start = Clock::now();
+    world.each<Position>([](ecs_lab::Entity, Position& p) { p.x += 1.0f; });
+    world.each<Velocity>([](ecs_lab::Entity, Velocity& v) { v.vx += 1.0f; });
+    return seconds_since(start);
+  };
+  double idle_max = 0.0;
+  for (int f = 0; f < 10; ++f) {
+    idle_max = std::max(idle_max, tick());
+  }
+  auto start = Clock::now();
+  auto save = world.begin_async_save(path);
+  const double begin_s = seconds_since(start);
+  double busy_max = 0.0;
+  int busy_frames = 0;
+  while (!save.done()) {
+    busy_max = std::max(busy_max, tick());
+    ++busy_frames;
+  }
+  const bool ok = save.wait();
+  const double async_s = seconds_since(start);
+  std::remove(path.c_str());
+  std::cout << "async save\t" << (ok ? "" : "FAILED ") << async_s * 1e3 << " ms\tbegin " << begin_s * 1e3
+            << " ms\tframes " << busy_frames << "\tmax frame " << busy_max * 1e3 << " ms (idle " << idle_max * 1e3
+            << " ms)\tpeak extra " << static_cast<double>(save.peak_extra_bytes()) / (1 << 20) << " MB\n";
+}
+
+// Entity metadata: bytes per entity and random handle lookups (validate + signature + idx).
+void bench_meta(std::size_t entities, int frames) {
+  std::cout << "entity metadata: " << entities << " entities\n";
+
+  std::vector<ecs_lab::Entity> es(entities);
+  ecs_lab::World::Snapshot snap;
+  double lookup_ns = 0.0;
+  double has_ns = 0.0;
+  double alive_ns = 0.0;
+  double scan_ns = 0.0;
+  std::size_t hits = 0;
+  {
+    ecs_lab::World world;
+    world.create_n(entities, es);
+    for (std::size_t i = 0; i < entities; ++i) {
+      world.add<Position>(es[i], static_cast<float>(i), 0.0f);
+      if (i % 2 == 0) {
+        world.add<Velocity>(es[i], 1.0f, 0.0f);
+      }
+      if (i % 3 == 0) {
+        world.add<Health>(es[i], 1);
+      }
+    }
+    // A tenth of the handles go stale.
+    for (std::size_t i = 0; i < entities; i += 10) {
+      world.destroy(es[i]);
+    }
+
+    std::vector<ecs_lab::Entity> order(es);
+    std::uint32_t rng = 0x9E3779B9u;
+    for (std::size_t i = order.size(); i > 1; --i) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      std::swap(order[i - 1], order[rng % i]);
+    }
+
+    const double ops = static_cast<double>(entities) * frames;
+    auto start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      for (const auto e : order) {
+        if (auto* v = world.try_get<Velocity>(e)) {
+          v->vx += 1.0f;
+          ++hits;
+        }
+      }
+    }
+    lookup_ns = seconds_since(start) * 1e9 / ops;
+
+    start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      for (const auto e : order) {
+        hits += world.has<Health>(e) ? 1 : 0;
+      }
+    }
+    has_ns = seconds_since(start) * 1e9 / ops;
+
+    start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      for (const auto e : order) {
+        hits += world.is_alive(e) ? 1 : 0;
+      }
+    }
+    alive_ns = seconds_since(start) * 1e9 / ops;
+
+    start = Clock::now();
+    for (int f = 0; f < frames; ++f) {
+      for (const auto e : es) {
+        hits += world.is_alive(e) ? 1 : 0;
+      }
+    }
+    scan_ns = seconds_since(start) * 1e9 / ops;
+
+    snap = world.snapshot();
+  }
+  // The World is gone, so every arena block is now the snapshot's alone.
+  std::cout << "arena bytes/entity\t" << static_cast<double>(snap.arena.exclusive_bytes()) / static_cast<double>(entities)
+            << " (spilled idx tables excluded)\n";
+  std::cout << "bytes/slot\t" << ecs_lab::LinearArena::kSlotBytes << " (liveness/signature scans read "
+            << sizeof(std::uint32_t) + sizeof(ecs_lab::Signature<ecs_lab::kMaxComponents>) << ")\n";
+  std::cout << "random try_get<T>\t" << lookup_ns << " ns\n";
+  std::cout << "random has<T>\t" << has_ns << " ns\n";
+  std::cout << "random is_alive\t" << alive_ns << " ns\n";
+  std::cout << "sequential is_alive\t" << scan_ns << " ns\t(" << hits << " hits)\n";
+}
+
+// Adds Slot<7-k+1>..Slot<7>, highest first, so every add inserts at the front of the idx table.
+template <std::size_t... I>
+void add_slots(ecs_lab::World& world, ecs_lab::Entity e, std::size_t k, std::index_sequence<I...>) {
+  ((7 - I >= 8 - k ? (world.add<Slot<7 - I>>(e), 0) : 0), ...);
+}
+
+// Entities with 3-8 components: idx table build cost, size, and lookups through it.
+void bench_idx(std::size_t entities, int frames) {
+  std::cout << "idx tables: " << entities << " entities, 3-8 components\n";
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(entities);
+  auto start = Clock::now();
+  world.create_n(entities, es);
+  for (std::size_t i = 0; i < entities; ++i) {
+    add_slots(world, es[i], 3 + i % 6, std::make_index_sequence<8>{});
+  }
+  report("add 3-8 components", entities, seconds_since(start));
+
+  std::size_t heap = 0;
+  std::size_t spilled = 0;
+  {
+    const auto snap = world.snapshot();
+    for (std::uint32_t i = 0; i < snap.arena.size(); ++i) {
+      const std::size_t bytes = snap.arena.idx(i).heap_bytes();
+      heap += bytes;
+      spilled += bytes > 0 ? 1 : 0;
+    }
+  }
+  std::cout << "idx bytes/entity\t" << sizeof(ecs_lab::IdxTable) << " + "
+            << static_cast<double>(heap) / static_cast<double>(entities) << " heap (" << spilled << " spilled)\n";
+
+  std::vector<ecs_lab::Entity> order(es);
+  std::uint32_t rng = 0x2545F491u;
+  for (std::size_t i = order.size(); i > 1; --i) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    std::swap(order[i - 1], order[rng % i]);
+  }
+  std::size_t hits = 0;
+  start = Clock::now();
+  for (int f = 0; f < frames; ++f) {
+    for (const auto e : order) {
+      if (auto* s = world.try_get<Slot<7>>(e)) {
+        hits += s->value + 1;
+      }
+    }
+  }
+  std::cout << "random try_get<T>\t" << seconds_since(start) * 1e9 / (static_cast<double>(entities) * frames)
+            << " ns\t(" << hits << " hits)\n";
+}
+
+// Finding what was destroyed this frame: an O(N) pass over every tracked handle vs reading the
+// on_destroy stream, plus what the streams add to destroy itself.
+void bench_events_variant(const char* label, std::size_t entities, int frames, bool streams) {
+  ecs_lab::World world;
+  const auto prefab = ecs_lab::make_prefab(Position{}, Health{100}, Faction{1});
+  std::vector<ecs_lab::Entity> live(entities);
+  world.instantiate_n(prefab, entities, live);
+  ecs_lab::EventStream<ecs_lab::Entity>* destroyed = nullptr;
+  ecs_lab::EventCursor cursor;
+  ecs_lab::EventCursor health_cursor;
+  if (streams) {
+    destroyed = &world.on_destroy(entities / 50);
+    world.on_remove<Health>(entities / 50);
+    cursor = destroyed->cursor();
+    health_cursor = world.on_remove<Health>().cursor();
+  }
+
+  std::uint32_t rng = 0x9E3779B9u;
+  const std::size_t wave = entities / 100;
+  std::vector<std::size_t> slots(wave);
+  std::vector<ecs_lab::Entity> doomed(wave);
+  std::vector<std::uint64_t> found;
+  double destroy_s = 0.0;
+  double detect_s = 0.0;
+  std::size_t detected = 0;
+  for (int f = 0; f < frames; ++f) {
+    for (std::size_t i = 0; i < wave; ++i) {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      slots[i] = rng % entities;
+    }
+    auto start = Clock::now();
+    for (const std::size_t slot : slots) {
+      world.destroy(live[slot]);
+    }
+    destroy_s += seconds_since(start);
+
+    found.clear();
+    start = Clock::now();
+    if (streams) {
+      destroyed->read(cursor, [&](const ecs_lab::Entity& e) { found.push_back(e.entity_id); });
+      world.on_remove<Health>().read(health_cursor, [](const ecs_lab::Entity&) {});
+    } else {
+      for (const auto e : live) {
+        if (!world.is_alive(e)) {
+          found.push_back(e.entity_id);
+        }
+      }
+    }
+    detect_s += seconds_since(start);
+    detected += found.size();
+
+    for (const std::size_t slot : slots) {
+      if (!world.is_alive(live[slot])) {
+        live[slot] = world.instantiate(prefab);
+      }
+    }
+  }
+
+  std::cout << label << "	destroy " << destroy_s * 1e3 << " ms	detect " << detect_s * 1e3 << " ms	("
+            << detected << " found)\n";
+}
+
+void bench_events(std::size_t entities, int frames) {
+  std::cout << "Destroy detection benchmark (1% destroyed per frame)\n";
+  std::cout << "entities: " << entities << ", frames: " << frames << "\n";
+  bench_events_variant("diff pass", entities, frames, false);
+  bench_events_variant("on_destroy", entities, frames, true);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::size_t wave = 50'000;
+  int frames = 20;
+  bool run_batch = true;
+  bool run_stable = true;
+  bool run_snapshot = true;
+  bool run_serialize = true;
+  bool run_meta = true;
+  bool run_sparse = true;
+  bool run_events = true;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--batch") {
+      run_stable = false;
+      run_snapshot = false;
+      run_serialize = false;
+      run_meta = false;
+      run_sparse = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--stable") {
+      run_batch = false;
+      run_snapshot = false;
+      run_serialize = false;
+      run_meta = false;
+      run_sparse = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--snapshot") {
+      run_batch = false;
+      run_stable = false;
+      run_serialize = false;
+      run_meta = false;
+      run_sparse = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--serialize") {
+      run_batch = false;
+      run_stable = false;
+      run_snapshot = false;
+      run_meta = false;
+      run_sparse = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--meta") {
+      run_batch = false;
+      run_stable = false;
+      run_snapshot = false;
+      run_serialize = false;
+      run_sparse = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--sparse") {
+      run_batch = false;
+      run_stable = false;
+      run_snapshot = false;
+      run_serialize = false;
+      run_meta = false;
+      run_events = false;
+      continue;
+    }
+    if (arg == "--events") {
+      run_batch = false;
+      run_stable = false;
+      run_snapshot = false;
+      run_serialize = false;
+      run_meta = false;
+      run_sparse = false;
+      continue;
+    }
+    if (!arg.empty() && std::isdigit(static_cast<unsigned char>(arg[0]))) {
+      wave = static_cast<std::size_t>(std::stoull(arg));
+    }
+  }
+
+  if (run_batch) {
+    bench_batch(wave, frames);
+  }
+  if (run_stable) {
+    bench_stable(wave * 4, frames);
+  }
+  if (run_snapshot) {
+    bench_snapshot(wave * 20, frames);
+    bench_delta(wave * 20, frames / 4);
+  }
+  if (run_serialize) {
+    bench_serialize(wave * 20, frames / 4);
+  }
+  if (run_meta) {
+    bench_meta(wave * 20, frames / 4);
+    bench_idx(wave * 4, frames / 4);
+  }
+  if (run_sparse) {
+    bench_sparse(wave * 20, frames / 4);
+  }
+  if (run_events) {
+    bench_events(wave * 20, frames / 4);
+  }
+  return 0;
+}
@@ -3,6 +3,18 @@
 
 #include "ecs_lab/ecs.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace {
@@ -16,8 +28,59 @@ struct Health {
   int hp = 0;
 };
 
+struct Node {
+  int value = 0;
+};
+
+struct Label {
+  std::string text;
+};
+
+// No default constructor; holds a shared token so tests can count live copies.
+struct Ticket {
+  explicit Ticket(std::shared_ptr<int> owner) : owner(std::move(owner)) {}
+  std::shared_ptr<int> owner;
+};
+
+struct Particle {
+  float x = 0.0f;
+  float vx = 0.0f;
+  std::int32_t id = 0;
+};
+
+struct Target {
+  int id = 0;
+};
+
+template <int N>
+struct Wide {
+  int value = 0;
+};
+
+struct Score {
+  int value = 0;
+};
+
+struct Offset {
+  int local = 0;
+  int world = 0;
+};
+
 } // namespace
 
+namespace ecs_lab {
+template <>
+struct stable_storage<Node> : std::true_type {};
+template <>
+struct sparse_lookup<Target> : std::true_type {};
+template <>
+struct change_ticks<Score> : std::true_type {};
+template <>
+struct soa_fields<Particle> {
+  static constexpr auto members = std::make_tuple(&Particle::x, &Particle::vx, &Particle::id);
+};
+} // namespace ecs_lab
+
 TEST_CASE("ECS create/destroy lifecycle") {
   ecs_lab::World world;
   auto e = world.create();
@@ -252,6 +315,58 @@ TEST_CASE("Signature rank calculates correctly with multiple components") {
   CHECK(world.get<Velocity>(e).vx == 3.0f);
 }
 
+TEST_CASE("Batch signature matching agrees with per-row checks at every level") {
+  using Sig128 = ecs_lab::Signature<128>;
+  using Sig64 = ecs_lab::Signature<64>;
+  std::uint32_t rng = 0x9e3779b9u;
+
+  // Few components per signature so that both matches and misses are common.
+  std::vector<Sig128> sigs(1000);
+  for (auto& sig : sigs) {
+    for (int k = 0; k < 4; ++k) {
+      sig.set(static_cast<ecs_lab::ComponentId>(xorshift32(rng) % 8 + (k % 2) * 64));
+    }
+  }
+  Sig128 required;
+  required.set(1);
+  required.set(65);
+  Sig128 excluded;
+  excluded.set(3);
+  excluded.set(70);
+
+  for (const std::size_t count : {std::size_t{0}, std::size_t{1}, std::size_t{63}, std::size_t{64},
+                                  std::size_t{130}, std::size_t{1000}}) {
+    std::vector<std::uint64_t> expected((count + 63) / 64, 0);
+    std::size_t expected_matches = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+      if (sigs[i].contains_all(required) && !sigs[i].intersects(excluded)) {
+        expected[i / 64] |= std::uint64_t{1} << (i % 64);
+        ++expected_matches;
+      }
+    }
+    for (const auto level : {ecs_lab::SimdLevel::kScalar, ecs_lab::SimdLevel::kAvx2, ecs_lab::SimdLevel::kAvx512}) {
+      std::vector<std::uint64_t> out(expected.size(), ~std::uint64_t{0});
+      CHECK(ecs_lab::match_signatures(sigs.data(), count, required, excluded, out.data(), level) ==
+            expected_matches);
+      CHECK(out == expected);
+    }
+  }
+  CHECK(ecs_lab::match_signatures(sigs.data(), sigs.size(), Sig128{}, Sig128{},
+                                  std::vector<std::uint64_t>(16).data()) == sigs.size());
+
+  // Other sizes take the scalar loop whatever the level.
+  std::vector<Sig64> small(100);
+  for (std::size_t i = 0; i < small.size(); i += 3) {
+    small[i].set(5);
+  }
+  Sig64 want;
+  want.set(5);
+  std::vector<std::uint64_t> out(2);
+  CHECK(ecs_lab::match_signatures(small.data(), small.size(), want, Sig64{}, out.data(),
+                                  ecs_lab::SimdLevel::kAvx512) == 34);
+  CHECK(out[0] == 0x9249249249249249ull);
+}
+
 TEST_CASE("Component add/remove order independence") {
   ecs_lab::World world;
 
@@ -580,6 +695,330 @@ TEST_CASE("Multiple snapshots independent") {
   CHECK(world.get<Counter>(e).value == 2);
 }
 
+TEST_CASE("Snapshots share blocks copy-on-write") {
+  std::vector<ecs_lab::Entity> es(10000);
+  ecs_lab::World::Snapshot snap;
+  {
+    ecs_lab::World world;
+    world.instantiate_n(ecs_lab::make_prefab(Counter{7}, Health{1}), es.size(), es);
+    auto proxy = world.get_proxy(es[0]);
+    REQUIRE(proxy->try_get<Counter>() != nullptr);
+
+    snap = world.snapshot();
+    auto other = world.snapshot();
+
+    // Writes after the snapshot (through get, iteration and a proxy) leave the snapshots intact.
+    world.get<Counter>(es[9999]).value = 1;
+    world.each<Health>([](ecs_lab::Entity, Health& h) { h.hp = 2; });
+    proxy->get<Counter>().value = 3;
+    world.destroy(es[5000]);
+    world.add<Position>(world.create(), 1, 2);
+
+    world.restore(other);
+    CHECK(world.get<Counter>(es[0]).value == 7);
+    CHECK(world.get<Counter>(es[9999]).value == 7);
+    CHECK(world.get<Health>(es[42]).hp == 1);
+    CHECK(world.is_alive(es[5000]));
+    int positions = 0;
+    world.each<Position>([&](ecs_lab::Entity, Position&) { ++positions; });
+    CHECK(positions == 0);
+    CHECK(!proxy->is_alive());
+    CHECK(world.get_proxy(es[0])->get<Counter>().value == 7);
+  }
+
+  // The snapshot outlives its World and restores into another one.
+  ecs_lab::World fresh;
+  fresh.restore(snap);
+  long long sum = 0;
+  fresh.query<Counter, Health>([&](ecs_lab::Entity, Counter& c, Health& h) { sum += c.value + h.hp; });
+  CHECK(sum == 8 * 10000);
+  fresh.destroy(es[1]);
+  CHECK(fresh.is_alive(es[2]));
+  CHECK(fresh.get_proxy(es[3])->get<Health>().hp == 1);
+}
+
+TEST_CASE("Delta snapshots carry only dirty blocks and restore against their base") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(20000);
+  world.instantiate_n(ecs_lab::make_prefab(Counter{1}, Node{2}), es.size(), es);
+  const auto base = world.snapshot();
+
+  auto clean = world.snapshot_delta(base);
+  CHECK(clean.dirty_blocks() == 0);
+
+  // Tick 1: one write in the first block of Counter.
+  world.get<Counter>(es[0]).value = 10;
+  const auto tick1 = world.snapshot_delta(base);
+  CHECK(tick1.dirty_blocks() == 1);
+  CHECK(tick1.dirty_bytes() < 64); // one changed row, not the whole block
+
+  // Tick 2: structural churn (destroy, create, add, remove on a stable pool).
+  world.destroy(es[19999]);
+  auto spawned = world.create();
+  world.add<Health>(spawned, 5);
+  world.remove<Node>(es[1]);
+  const auto tick2 = world.snapshot_delta(base);
+  CHECK(tick2.dirty_blocks() < 10);
+  CHECK(tick2.dirty_bytes() > 0);
+
+  world.restore_delta(base, tick1);
+  CHECK(world.get<Counter>(es[0]).value == 10);
+  CHECK(world.is_alive(es[19999]));
+  CHECK(!world.is_alive(spawned));
+  CHECK(world.has<Node>(es[1]));
+
+  world.restore_delta(base, tick2);
+  CHECK(world.get<Counter>(es[0]).value == 10);
+  CHECK(!world.is_alive(es[19999]));
+  CHECK(world.get<Health>(spawned).hp == 5);
+  CHECK(!world.has<Node>(es[1]));
+  CHECK(world.get<Node>(es[2]).value == 2);
+  int nodes = 0;
+  world.each<Node>([&](ecs_lab::Entity, Node&) { ++nodes; });
+  CHECK(nodes == 19998);
+
+  // Writes after restore_delta leave the delta and the base untouched.
+  world.get<Counter>(es[0]).value = 99;
+  world.restore_delta(base, tick2);
+  CHECK(world.get<Counter>(es[0]).value == 10);
+  world.restore(base);
+  CHECK(world.get<Counter>(es[0]).value == 1);
+  CHECK(!world.has<Health>(spawned));
+}
+
+TEST_CASE("Snapshots round-trip through the binary format") {
+  ecs_lab::register_component<Position>("test.position");
+  ecs_lab::register_component<Health>("test.health");
+  ecs_lab::register_component<Node>("test.node");
+  ecs_lab::register_component<Label>(
+      "test.label",
+      [](ecs_lab::BinaryWriter& out, const Label& l) {
+        out.put(static_cast<std::uint32_t>(l.text.size()));
+        out.write(l.text.data(), l.text.size());
+      },
+      [](ecs_lab::BinaryReader& in, Label& l) {
+        std::uint32_t size = 0;
+        if (!in.get(size)) {
+          return false;
+        }
+        l.text.resize(size);
+        return in.read(l.text.data(), size);
+      });
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es;
+  for (int i = 0; i < 5000; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, -i);
+    if (i % 3 == 0) {
+      world.add<Health>(e, i * 2);
+    }
+    if (i % 5 == 0) {
+      world.add<Node>(e, i);
+    }
+    if (i % 7 == 0) {
+      world.add<Label>(e, "entity " + std::to_string(i));
+    }
+    es.push_back(e);
+  }
+  // Leave free slots and a tombstone in the stable pool.
+  world.destroy(es[1]);
+  world.destroy(es[2]);
+  world.remove<Node>(es[10]);
+
+  std::stringstream stream;
+  REQUIRE(ecs_lab::save_snapshot(world.snapshot(), stream));
+
+  ecs_lab::World::Snapshot loaded;
+  REQUIRE(ecs_lab::load_snapshot(stream, loaded));
+  ecs_lab::World copy;
+  copy.restore(loaded);
+
+  CHECK(!copy.is_alive(es[1]));
+  CHECK(!copy.has<Node>(es[10]));
+  for (int i = 0; i < 5000; ++i) {
+    if (i == 1 || i == 2) {
+      continue;
+    }
+    const auto e = es[i];
+    REQUIRE(copy.is_alive(e));
+    CHECK(copy.get<Position>(e).x == i);
+    CHECK(copy.has<Health>(e) == (i % 3 == 0));
+    if (i % 3 == 0) {
+      CHECK(copy.get<Health>(e).hp == i * 2);
+    }
+    if (i % 5 == 0 && i != 10) {
+      CHECK(copy.get<Node>(e).value == i);
+    }
+    if (i % 7 == 0) {
+      CHECK(copy.get<Label>(e).text == "entity " + std::to_string(i));
+    }
+  }
+
+  // The free list and id counter come back too: both worlds hand out the same next entity.
+  const auto a = world.create();
+  const auto b = copy.create();
+  CHECK(a.entity_id == b.entity_id);
+  CHECK(a.entity_idx == b.entity_idx);
+  CHECK(a.gen == b.gen);
+  copy.add<Node>(b, 7);
+  CHECK(copy.get<Node>(b).value == 7);
+
+  std::stringstream bad("XXXX");
+  CHECK(!ecs_lab::load_snapshot(bad, loaded));
+}
+
+TEST_CASE("Mapped snapshots adopt file blocks until written") {
+  ecs_lab::register_component<Position>("test.position");
+  ecs_lab::register_component<Node>("test.node");
+  const std::string path = (std::filesystem::temp_directory_path() / "ecs_lab_test_map.snap").string();
+
+  std::vector<ecs_lab::Entity> es(10000);
+  {
+    ecs_lab::World world;
+    world.instantiate_n(ecs_lab::make_prefab(Position{1, 2}, Node{3}), es.size(), es);
+    world.get<Position>(es[42]).x = 42;
+    world.remove<Node>(es[7]);
+    REQUIRE(ecs_lab::save_snapshot(world.snapshot(), path));
+  }
+
+  ecs_lab::World world;
+  {
+    ecs_lab::World::Snapshot snap;
+    REQUIRE(ecs_lab::map_snapshot(path, snap));
+    const auto& items =
+        static_cast<const ecs_lab::Pool<Position>&>(*snap.pools[ecs_lab::component_id<Position>()]).items;
+    CHECK(items.size() == es.size());
+    CHECK(items.is_shared(0));
+    world.restore(snap);
+  }
+  // The snapshot is gone; the world's blocks keep the mapping alive.
+  CHECK(world.get<Position>(es[42]).x == 42);
+  CHECK(!world.has<Node>(es[7]));
+  long long sum = 0;
+  world.query<Position, Node>([&](ecs_lab::Entity, Position& p, Node& n) { sum += p.y + n.value; });
+  CHECK(sum == 5 * 9999);
+
+  // Writes copy the block; the file is untouched.
+  world.get<Position>(es[0]).x = -1;
+  world.add<Node>(es[7], 9);
+  ecs_lab::World::Snapshot again;
+  REQUIRE(ecs_lab::load_snapshot(path, again));
+  ecs_lab::World reloaded;
+  reloaded.restore(again);
+  CHECK(reloaded.get<Position>(es[0]).x == 1);
+  CHECK(!reloaded.has<Node>(es[7]));
+  CHECK(world.get<Position>(es[0]).x == -1);
+  CHECK(world.get<Node>(es[7]).value == 9);
+
+  // Corrupt files are rejected rather than trusted: a block image without its external flag
+  // (the first write would land in the read-only mapping) and an idx entry past its pool.
+  std::vector<char> bytes(std::filesystem::file_size(path));
+  {
+    std::ifstream file(path, std::ios::binary);
+    REQUIRE(file.read(bytes.data(), static_cast<std::streamsize>(bytes.size())));
+  }
+  auto map_patched = [&](auto&& patch) {
+    std::vector<char> copy = bytes;
+    patch(copy);
+    {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      file.write(copy.data(), static_cast<std::streamsize>(copy.size()));
+    }
+    ecs_lab::World::Snapshot snap;
+    return ecs_lab::map_snapshot(path, snap);
+  };
+  ecs_lab::World::Snapshot corrupt;
+  CHECK(map_patched([](std::vector<char>&) {}));
+  using Items = decltype(ecs_lab::Pool<Position>::items);
+  std::vector<char> image_header(Items::block_image_offset());
+  static_cast<const ecs_lab::Pool<Position>&>(*again.pools[ecs_lab::component_id<Position>()])
+      .items.block_image_header(0, image_header.data());
+  const auto flag = std::find(image_header.begin(), image_header.end(), 1) - image_header.begin();
+  CHECK(!map_patched([&](std::vector<char>& b) {
+    auto at = std::search(b.begin(), b.end(), image_header.begin(), image_header.end());
+    REQUIRE(at != b.end());
+    at[flag] = 0;
+  }));
+  // Header, table ("test.position", "test.node") and padding: the arena section starts at 48.
+  std::uint32_t bump = 0;
+  std::memcpy(&bump, bytes.data() + 48, sizeof(bump));
+  REQUIRE(bump == es.size());
+  CHECK(!map_patched([&](std::vector<char>& b) {
+    const std::size_t record = 64 + bump * sizeof(ecs_lab::SnapshotMetaRecord);
+    const ecs_lab::DenseIndex past = 1u << 20;
+    std::memcpy(b.data() + record + offsetof(ecs_lab::SnapshotIdxRecord, dense_index), &past, sizeof(past));
+  }));
+  CHECK(!ecs_lab::load_snapshot(path, corrupt));
+
+  // A truncated file is rejected rather than adopted.
+  const auto size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size / 2);
+  ecs_lab::World::Snapshot truncated;
+  CHECK(!ecs_lab::map_snapshot(path, truncated));
+
+  // Rebuilding a sparse index on load reads the adopted blocks without copying them.
+  {
+    ecs_lab::register_component<Target>("test.target");
+    ecs_lab::World sparse;
+    std::vector<ecs_lab::Entity> targets(20000);
+    sparse.create_n(targets.size(), targets);
+    for (std::size_t i = 0; i < targets.size(); ++i) {
+      sparse.add<Target>(targets[i], static_cast<int>(i));
+      sparse.add<Position>(targets[i], static_cast<int>(i), 0);
+    }
+    REQUIRE(ecs_lab::save_snapshot(sparse.snapshot(), path));
+    ecs_lab::World::Snapshot snap;
+    REQUIRE(ecs_lab::map_snapshot(path, snap));
+    // The index pages themselves are built fresh; the rows must still be the file's.
+    const auto& rows = static_cast<const ecs_lab::Pool<Target>&>(*snap.pools[ecs_lab::component_id<Target>()]).items;
+    CHECK(rows.is_shared(0));
+    CHECK(rows.exclusive_bytes() == 0);
+    ecs_lab::World restored;
+    restored.restore(snap);
+    CHECK(restored.get<Target>(targets[12345]).id == 12345);
+  }
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Async save writes the frozen state while the world keeps changing") {
+  ecs_lab::register_component<Position>("test.position");
+  ecs_lab::register_component<Health>("test.health");
+  const std::string path = (std::filesystem::temp_directory_path() / "ecs_lab_test_async.snap").string();
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(50000);
+  world.instantiate_n(ecs_lab::make_prefab(Position{1, 2}, Health{10}), es.size(), es);
+
+  auto save = world.begin_async_save(path);
+  // Keep mutating while the writer runs: every block gets copied away from the snapshot.
+  for (int round = 0; round < 3; ++round) {
+    world.each<Position>([](ecs_lab::Entity, Position& p) { ++p.x; });
+    world.remove<Health>(es[static_cast<std::size_t>(round)]);
+    world.destroy(es[100 + static_cast<std::size_t>(round)]);
+    world.add<Health>(world.create(), 5);
+  }
+  REQUIRE(save.wait());
+  CHECK(save.done());
+  CHECK(save.progress() == 1.0);
+  CHECK(save.bytes_written() == std::filesystem::file_size(path));
+  CHECK(save.total_bytes() > 0);
+
+  ecs_lab::World::Snapshot snap;
+  REQUIRE(ecs_lab::load_snapshot(path, snap));
+  ecs_lab::World saved;
+  saved.restore(snap);
+  long long x = 0;
+  int health = 0;
+  saved.each<Position>([&](ecs_lab::Entity, Position& p) { x += p.x; });
+  saved.each<Health>([&](ecs_lab::Entity, Health&) { ++health; });
+  CHECK(x == 50000);
+  CHECK(health == 50000);
+  CHECK(saved.is_alive(es[100]));
+  CHECK(world.get<Position>(es[0]).x == 4);
+  std::filesystem::remove(path);
+}
+
 TEST_CASE("Destroy removes all components") {
   ecs_lab::World world;
   auto e = world.create();
@@ -901,6 +1340,7 @@ TEST_CASE("Stress: random add/remove/destroy and verify invariants") {
   CHECK(pos_count == exp_pos);
   CHECK(hp_count == exp_hp);
   CHECK(vel_count == exp_vel);
+  CHECK(world.verify_pools());
 }
 
 TEST_CASE("ECS query iterates entities with required components") {
@@ -958,3 +1398,1425 @@ TEST_CASE("ECS query driver pool missing does nothing") {
   world.query<Unused, Position>([&](ecs_lab::Entity, Unused&, Position&) { ++count; });
   CHECK(count == 0);
 }
+
+TEST_CASE("ECS query drives from the smallest pool and keeps argument order") {
+  ecs_lab::World world;
+
+  std::vector<ecs_lab::Entity> stunned;
+  for (int i = 0; i < 100; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, -i);
+    if (i % 10 == 3) {
+      world.add<Health>(e, 1000 + i);
+      stunned.push_back(e);
+    }
+  }
+
+  int count = 0;
+  world.query<Position, Health>([&](ecs_lab::Entity e, Position& p, Health& h) {
+    ++count;
+    CHECK(h.hp == 1000 + p.x);
+    CHECK(p.y == -p.x);
+    CHECK(world.get<Position>(e).x == p.x);
+  });
+  CHECK(count == static_cast<int>(stunned.size()));
+
+  int reversed = 0;
+  world.query<Health, Position>([&](ecs_lab::Entity, Health& h, Position& p) {
+    ++reversed;
+    CHECK(h.hp == 1000 + p.x);
+  });
+  CHECK(reversed == count);
+}
+
+TEST_CASE("Filtered query applies With, Without and Optional terms") {
+  struct Dead {};
+  struct Buff {
+    int power = 0;
+  };
+  struct Unused {};
+
+  ecs_lab::World world;
+  int expected = 0;
+  int expected_buffed = 0;
+  for (int i = 0; i < 200; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, 0);
+    if (i % 2 == 0) {
+      world.add<Velocity>(e, 1.0f, 0.0f);
+    }
+    if (i % 3 == 0) {
+      world.add<Dead>(e);
+    }
+    if (i % 5 == 0) {
+      world.add<Buff>(e, i);
+    }
+    if (i % 2 == 0 && i % 3 != 0) {
+      ++expected;
+      expected_buffed += i % 5 == 0 ? 1 : 0;
+    }
+  }
+
+  // Terms in any order; With and Optional arguments follow term order.
+  ecs_lab::QueryFilter<ecs_lab::Without<Dead>, ecs_lab::With<Velocity>, ecs_lab::Optional<Buff>,
+                       ecs_lab::With<Position>>
+      filter;
+  CHECK(filter.required.popcount() == 2);
+  CHECK(filter.excluded.popcount() == 1);
+  int count = 0;
+  int buffed = 0;
+  world.query(filter, [&](ecs_lab::Entity e, Velocity& v, Position& p, Buff* buff) {
+    ++count;
+    CHECK(p.x % 2 == 0);
+    CHECK(p.x % 3 != 0);
+    CHECK(v.vx == 1.0f);
+    CHECK(!world.has<Dead>(e));
+    CHECK((buff != nullptr) == (p.x % 5 == 0));
+    if (buff) {
+      CHECK(buff->power == p.x);
+      buff->power = -1;
+      ++buffed;
+    }
+  });
+  CHECK(count == expected);
+  CHECK(buffed == expected_buffed);
+  int written = 0;
+  world.each<Buff>([&](Buff& b) { written += b.power == -1 ? 1 : 0; });
+  CHECK(written == expected_buffed);
+
+  // Missing pools: Without/Optional are ignored, a missing With matches nothing.
+  int all = 0;
+  world.query(ecs_lab::QueryFilter<ecs_lab::With<Position>, ecs_lab::Without<Unused>>{},
+              [&](ecs_lab::Entity, Position&) { ++all; });
+  CHECK(all == 200);
+  int none = 0;
+  world.query(ecs_lab::QueryFilter<ecs_lab::With<Position, Unused>>{},
+              [&](ecs_lab::Entity, Position&, Unused&) { ++none; });
+  CHECK(none == 0);
+  int optional_missing = 0;
+  world.query(ecs_lab::QueryFilter<ecs_lab::With<Velocity>, ecs_lab::Optional<Unused>>{},
+              [&](ecs_lab::Entity, Velocity&, Unused* u) { optional_missing += u == nullptr ? 1 : 0; });
+  CHECK(optional_missing == 100);
+}
+
+TEST_CASE("Change ticks drive Changed and Added filters") {
+  using ecs_lab::Added;
+  using ecs_lab::Changed;
+  using ecs_lab::QueryFilter;
+  using ecs_lab::With;
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es;
+  // Several pool blocks, so most of them are skipped by their tick bound.
+  for (int i = 0; i < 10000; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, 0);
+    world.add<Score>(e, i);
+    es.push_back(e);
+  }
+  CHECK(world.try_get_component<Score>(es[7])->ticks.added == 1);
+
+  QueryFilter<Changed<Score>> changed;
+  QueryFilter<With<Position>, Added<Score>> added;
+  auto count = [&](auto& filter) {
+    int n = 0;
+    world.query(filter, [&](ecs_lab::Entity, auto&...) { ++n; });
+    return n;
+  };
+  CHECK(count(changed) == 10000);
+  changed.since = world.advance_tick();
+  added.since = changed.since;
+  CHECK(world.tick() == 2);
+  CHECK(count(changed) == 0);
+  CHECK(count(added) == 0);
+
+  // Mutable access stamps; const access and other components do not.
+  world.get<Score>(es[4321]).value = -1;
+  const ecs_lab::World& view = world;
+  CHECK(view.try_get<Score>(es[10])->value == 10);
+  world.get<Position>(es[11]).y = 1;
+  world.mark_changed<Score>(es[9000]);
+  world.mark_changed<Position>(es[12]);
+  std::vector<int> seen;
+  world.query(changed, [&](ecs_lab::Entity e) { seen.push_back(world.get<Position>(e).x); });
+  std::sort(seen.begin(), seen.end());
+  CHECK(seen == std::vector<int>{4321, 9000});
+
+  // Lookups never stamp, so Reads<> systems may use them without touching the pool's tick
+  // bookkeeping.
+  int missing = 0;
+  world.each<Position>([&](ecs_lab::Entity e, Position&) {
+    const Score* a = world.try_get<Score>(e);
+    const Score* b = world.try_get_idx_gen<Score>(e.entity_idx, e.gen);
+    const auto* c = world.try_get_component<Score>(e);
+    if (!a || a != b || a != &c->data) {
+      ++missing;
+    }
+  });
+  CHECK(missing == 0);
+  CHECK(count(changed) == 2);
+
+  // New rows count as both added and changed; swap-erase moves keep a row's ticks.
+  auto fresh = world.create();
+  world.add<Position>(fresh, -5, 0);
+  world.add<Score>(fresh, 5);
+  world.destroy(es[4321]);
+  world.remove<Score>(es[0]);
+  CHECK(world.verify_pools());
+  int added_rows = 0;
+  world.query(added, [&](ecs_lab::Entity e, Position& p) {
+    ++added_rows;
+    CHECK(e.entity_id == fresh.entity_id);
+    CHECK(p.x == -5);
+  });
+  CHECK(added_rows == 1);
+  CHECK(count(changed) == 2);
+
+  // Stamping iteration, then a restore that brings the old ticks back.
+  auto snap = world.snapshot();
+  changed.since = world.advance_tick();
+  world.each<Score>(ecs_lab::stamp_changed, [](Score& s) { s.value += 1; });
+  CHECK(count(changed) == 9999);
+  world.restore(snap);
+  CHECK(count(changed) == 0);
+  CHECK(world.tick() == 3);
+
+  QueryFilter<With<Position, Score>> both;
+  const ecs_lab::Tick before = world.advance_tick();
+  world.query(both, ecs_lab::stamp_changed, [](ecs_lab::Entity, Position& p, Score&) { p.y = 2; });
+  changed.since = before;
+  CHECK(count(changed) == 9999);
+  world.query<Position>(ecs_lab::stamp_changed, [](ecs_lab::Entity, Position&) {});
+  CHECK(world.try_get_component<Score>(fresh)->ticks.changed == 4);
+
+  // Ticks travel through save/load, and a World loading newer ticks catches up to them.
+  ecs_lab::register_component<Position>("test.position");
+  ecs_lab::register_component<Score>("test.score");
+  std::stringstream stream;
+  REQUIRE(ecs_lab::save_snapshot(world.snapshot(), stream));
+  ecs_lab::World::Snapshot loaded;
+  REQUIRE(ecs_lab::load_snapshot(stream, loaded));
+  ecs_lab::World copy;
+  CHECK(copy.tick() == 1);
+  copy.restore(loaded);
+  CHECK(copy.tick() == 4);
+  QueryFilter<Changed<Score>> copy_changed;
+  copy_changed.since = 3;
+  int copied = 0;
+  copy.query(copy_changed, [&](ecs_lab::Entity) { ++copied; });
+  CHECK(copied == 9999);
+}
+
+TEST_CASE("QueryGroup tracks structural changes") {
+  ecs_lab::World world;
+  auto& group = world.group<Position, Health>();
+  CHECK(&group == &world.group<Position, Health>());
+
+  auto a = world.create();
+  auto b = world.create();
+  auto c = world.create();
+  world.add<Position>(a, 1, 0);
+  world.add<Health>(a, 10);
+  world.add<Position>(b, 2, 0);
+  world.add<Health>(c, 30);
+  CHECK(group.size() == 1);
+
+  world.add<Health>(b, 20);
+  world.add<Position>(c, 3, 0);
+  CHECK(group.size() == 3);
+
+  // Swap-erase moves c's Health into a's old slot; the group must follow.
+  world.remove<Health>(a);
+  CHECK(group.size() == 2);
+
+  int sum = 0;
+  group.each([&](ecs_lab::Entity e, Position& p, Health& h) {
+    CHECK(h.hp == p.x * 10);
+    CHECK(world.get<Health>(e).hp == h.hp);
+    sum += p.x;
+  });
+  CHECK(sum == 5);
+
+  world.destroy(b);
+  CHECK(group.size() == 1);
+
+  auto d = world.instantiate(ecs_lab::make_prefab(Position{4, 0}, Health{40}));
+  auto e = world.create();
+  world.add<Position>(e, 5, 0);
+  world.add_missing_components(e, d);
+  CHECK(group.size() == 3);
+  CHECK(world.get<Health>(e).hp == 40);
+
+  world.remove<Position>(d);
+  sum = 0;
+  group.each([&](ecs_lab::Entity, Position& p, Health&) { sum += p.x; });
+  CHECK(sum == 8);
+}
+
+TEST_CASE("QueryGroup rebuilds after restore") {
+  ecs_lab::World world;
+  auto a = world.create();
+  world.add<Position>(a, 1, 0);
+  world.add<Health>(a, 10);
+
+  auto& group = world.group<Position, Health>();
+  CHECK(group.size() == 1);
+  auto snap = world.snapshot();
+
+  auto b = world.create();
+  world.add<Position>(b, 2, 0);
+  world.add<Health>(b, 20);
+  world.remove<Health>(a);
+  CHECK(group.size() == 1);
+
+  world.restore(snap);
+  CHECK(group.size() == 1);
+  int hp = 0;
+  group.each([&](ecs_lab::Entity e, Position&, Health& h) {
+    CHECK(e.entity_id == a.entity_id);
+    hp = h.hp;
+  });
+  CHECK(hp == 10);
+
+  CHECK(!world.is_alive(b));
+  auto c = world.create();
+  world.add<Health>(c, 30);
+  world.add<Position>(c, 3, 0);
+  CHECK(group.size() == 2);
+}
+
+TEST_CASE("PackedGroup keeps owned pools row-aligned") {
+  ecs_lab::World world;
+  auto& packed = world.pack<Position, Velocity>();
+  auto& view = world.group<Position, Velocity>();
+
+  std::vector<ecs_lab::Entity> entities;
+  for (int i = 0; i < 64; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, 0);
+    if (i % 3 != 0) {
+      auto& vel = world.add<Velocity>(e, static_cast<float>(i), 0.0f);
+      CHECK(vel.vx == static_cast<float>(i));
+    }
+    entities.push_back(e);
+  }
+  CHECK(packed.size() == view.size());
+
+  auto proxy = world.get_proxy(entities[5]);
+  REQUIRE(proxy->try_get<Velocity>() != nullptr);
+
+  for (int i = 0; i < 64; i += 4) {
+    world.remove<Velocity>(entities[i]);
+  }
+  world.destroy(entities[7]);
+  world.add<Velocity>(entities[9], 9.0f, 0.0f);
+  auto f = world.instantiate(ecs_lab::make_prefab(Velocity{100.0f, 0.0f}, Position{100, 0}));
+  CHECK(packed.size() == view.size());
+
+  int count = 0;
+  packed.each([&](ecs_lab::Entity e, Position& p, Velocity& v) {
+    CHECK(static_cast<float>(p.x) == v.vx);
+    CHECK(world.get<Position>(e).x == p.x);
+    ++count;
+  });
+  CHECK(count == static_cast<int>(view.size()));
+
+  float sum = 0.0f;
+  packed.each([&](Position&, Velocity& v) { sum += v.vx; });
+  float expected = 0.0f;
+  view.each([&](ecs_lab::Entity, Position&, Velocity& v) { expected += v.vx; });
+  CHECK(sum == expected);
+
+  CHECK(proxy->get<Velocity>().vx == 5.0f);
+  CHECK(world.get<Position>(f).x == 100);
+
+  int pos_count = 0;
+  world.each<Position>([&](ecs_lab::Entity e, Position& p) {
+    CHECK(world.get<Position>(e).x == p.x);
+    ++pos_count;
+  });
+  CHECK(pos_count == 64);
+}
+
+TEST_CASE("PackedGroup repacks after restore") {
+  ecs_lab::World world;
+  auto& packed = world.pack<Position, Health>();
+  std::vector<ecs_lab::Entity> entities;
+  for (int i = 0; i < 10; ++i) {
+    auto e = world.create();
+    world.add<Health>(e, i);
+    if (i % 2 == 0) {
+      world.add<Position>(e, i, 0);
+    }
+    entities.push_back(e);
+  }
+  auto snap = world.snapshot();
+  world.remove<Position>(entities[0]);
+  world.remove<Position>(entities[2]);
+  CHECK(packed.size() == 3);
+
+  world.restore(snap);
+  CHECK(packed.size() == 5);
+  packed.each([&](Position& p, Health& h) { CHECK(p.x == h.hp); });
+  world.remove<Health>(entities[4]);
+  CHECK(packed.size() == 4);
+  packed.each([&](Position& p, Health& h) { CHECK(p.x == h.hp); });
+}
+
+TEST_CASE("par_each and par_query visit every row once") {
+  ecs_lab::World world;
+  ecs_lab::ThreadPool threads(3);
+  constexpr int N = 10000;
+  std::vector<ecs_lab::Entity> entities;
+  for (int i = 0; i < N; ++i) {
+    auto e = world.create();
+    world.add<Counter>(e, i);
+    if (i % 5 == 0) {
+      world.add<Health>(e, i);
+    }
+    entities.push_back(e);
+  }
+  world.destroy(entities[1]);
+
+  std::atomic<long long> sum{0};
+  std::atomic<int> visits{0};
+  std::atomic<int> bad{0};
+  world.par_each<Counter>(threads, [&](ecs_lab::Entity e, Counter& c) {
+    if (e.entity_idx == entities[1].entity_idx) {
+      ++bad;
+    }
+    sum += c.value;
+    c.value += 1;
+    ++visits;
+  });
+  CHECK(visits == N - 1);
+  CHECK(sum == static_cast<long long>(N) * (N - 1) / 2 - 1);
+
+  std::atomic<int> matches{0};
+  world.par_query<Counter, Health>(threads, [&](ecs_lab::Entity, Counter& c, Health& h) {
+    if (c.value != h.hp + 1) {
+      ++bad;
+    }
+    h.hp = -1;
+    ++matches;
+  });
+  CHECK(bad == 0);
+  CHECK(matches == N / 5);
+  CHECK(world.get<Health>(entities[5]).hp == -1);
+
+  // With a snapshot alive, callbacks read other pools through a const World&: only the
+  // iterated pool is unshared, and const lookups never copy the shared blocks of the rest.
+  std::vector<ecs_lab::Entity> shuffled(entities.begin() + 2, entities.end());
+  for (std::size_t i = shuffled.size() - 1; i > 0; --i) {
+    std::swap(shuffled[i], shuffled[(i * 7919) % (i + 1)]);
+  }
+  for (const auto& e : shuffled) {
+    world.add<Position>(e, static_cast<int>(e.entity_idx), 0);
+  }
+  const auto snap = world.snapshot();
+  const ecs_lab::World& view = world;
+  std::atomic<long long> seen{0};
+  world.par_each<Counter>(threads, [&](ecs_lab::Entity e, Counter& c) {
+    if (const Position* p = view.try_get<Position>(e)) {
+      c.value = p->x;
+      seen += view.has<Health>(e) ? 1 : 0;
+    }
+  });
+  CHECK(seen == N / 5 - 1);
+  CHECK(world.get<Counter>(entities[4321]).value == 4321);
+  const auto& positions =
+      static_cast<const ecs_lab::Pool<Position>&>(*snap.pools[ecs_lab::component_id<Position>()]).items;
+  CHECK(positions.is_shared(0));
+}
+
+TEST_CASE("Scheduler orders conflicting systems and reports the critical path") {
+  ecs_lab::World world;
+  for (int i = 0; i < 100; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, 0);
+    world.add<Health>(e, 0);
+    world.add<Velocity>(e, 1.0f, 0.0f);
+  }
+
+  ecs_lab::ThreadPool threads(2);
+  ecs_lab::Scheduler scheduler(threads);
+  const auto move = scheduler.add_system<ecs_lab::Reads<Velocity>, ecs_lab::Writes<Position>>(
+      "move", [](ecs_lab::World& w) {
+        w.query<Position, Velocity>([](ecs_lab::Entity, Position& p, Velocity& v) {
+          p.x += static_cast<int>(v.vx);
+        });
+      });
+  const auto damage = scheduler.add_system<ecs_lab::Reads<Position>, ecs_lab::Writes<Health>>(
+      "damage", [](ecs_lab::World& w) {
+        w.query<Position, Health>([](ecs_lab::Entity, Position& p, Health& h) { h.hp = p.x; });
+      });
+  const auto spin = scheduler.add_system<ecs_lab::Reads<>, ecs_lab::Writes<Counter>>(
+      "counter", [](ecs_lab::World& w) { w.each<Counter>([](ecs_lab::Entity, Counter& c) { ++c.value; }); });
+  const auto drag = scheduler.add_system<ecs_lab::Reads<>, ecs_lab::Writes<Velocity>>(
+      "drag", [](ecs_lab::World& w) { w.each<Velocity>([](ecs_lab::Entity, Velocity& v) { v.vx *= 2.0f; }); });
+
+  CHECK(scheduler.depends_on(damage, move));
+  CHECK(!scheduler.depends_on(spin, move));
+  CHECK(!scheduler.depends_on(spin, damage));
+  CHECK(scheduler.depends_on(drag, move));
+  CHECK(!scheduler.depends_on(drag, damage));
+
+  for (int frame = 0; frame < 3; ++frame) {
+    scheduler.run(world);
+  }
+
+  int checked = 0;
+  world.query<Position, Health, Velocity>([&](ecs_lab::Entity, Position& p, Health& h, Velocity& v) {
+    // move ran with vx = 1, 2, 4; damage always observes the moved position.
+    CHECK(h.hp == p.x);
+    CHECK(v.vx == 8.0f);
+    ++checked;
+  });
+  CHECK(checked == 100);
+
+  const auto stats = scheduler.stats();
+  REQUIRE(stats.size() == 4);
+  CHECK(stats[damage].name == "damage");
+  CHECK(stats[damage].start_ms >= stats[move].start_ms + stats[move].duration_ms);
+  const auto path = scheduler.critical_path();
+  REQUIRE(!path.empty());
+  CHECK(path.front() == move);
+  CHECK(scheduler.critical_path_ms() <= scheduler.frame_ms() + 1e-3);
+}
+
+TEST_CASE("CommandBuffer defers structural changes made during iteration") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> entities;
+  for (int i = 0; i < 10; ++i) {
+    auto e = world.create();
+    world.add<Counter>(e, i);
+    entities.push_back(e);
+  }
+
+  ecs_lab::CommandBuffer cmd;
+  ecs_lab::Entity spawned{};
+  world.each<Counter>([&](ecs_lab::Entity e, Counter& c) {
+    if (c.value % 2 == 1) {
+      cmd.destroy(e);
+    } else {
+      cmd.add<Health>(e, c.value * 10);
+      cmd.remove<Counter>(e);
+    }
+    if (c.value == 4) {
+      spawned = cmd.create();
+      cmd.add<Position>(spawned, 4, 4);
+      cmd.add<Counter>(spawned, 100);
+    }
+  });
+  auto from_prefab = cmd.instantiate(ecs_lab::make_prefab(Health{7}));
+  cmd.add<Position>(from_prefab, 7, 7);
+  CHECK(ecs_lab::CommandBuffer::is_pending(spawned));
+  CHECK(cmd.size() == 20);
+
+  // Nothing applied yet.
+  int counters = 0;
+  world.each<Counter>([&](ecs_lab::Entity, Counter&) { ++counters; });
+  CHECK(counters == 10);
+
+  world.flush(cmd);
+  CHECK(cmd.empty());
+
+  for (int i = 0; i < 10; ++i) {
+    if (i % 2 == 1) {
+      CHECK(!world.is_alive(entities[i]));
+    } else {
+      CHECK(world.get<Health>(entities[i]).hp == i * 10);
+      CHECK(!world.has<Counter>(entities[i]));
+    }
+  }
+  auto real = cmd.resolve(spawned);
+  REQUIRE(world.is_alive(real));
+  CHECK(world.get<Position>(real).x == 4);
+  CHECK(world.get<Counter>(real).value == 100);
+  auto real_prefab = cmd.resolve(from_prefab);
+  REQUIRE(world.is_alive(real_prefab));
+  CHECK(world.get<Health>(real_prefab).hp == 7);
+  CHECK(world.get<Position>(real_prefab).x == 7);
+}
+
+TEST_CASE("CommandBuffer per-thread recording and replay order") {
+  ecs_lab::World world;
+  auto a = world.create();
+  auto b = world.create();
+
+  ecs_lab::CommandBuffer first;
+  ecs_lab::CommandBuffer second;
+  std::thread t1([&] {
+    first.add<Health>(a, 1);
+    first.remove<Health>(a);
+    first.add<Health>(a, 2);
+  });
+  std::thread t2([&] {
+    second.add<Position>(b, 1, 1);
+    second.destroy(b);
+    second.add<Position>(a, 3, 3);
+  });
+  t1.join();
+  t2.join();
+
+  world.flush(first);
+  world.flush(second);
+  CHECK(world.get<Health>(a).hp == 2);
+  CHECK(world.get<Position>(a).x == 3);
+  CHECK(!world.is_alive(b));
+
+  // Commands targeting an entity destroyed earlier are skipped.
+  ecs_lab::CommandBuffer late;
+  late.add<Health>(b, 5);
+  late.remove<Position>(b);
+  world.flush(late);
+  CHECK(!world.is_alive(b));
+
+  ecs_lab::CommandBuffer dropped;
+  dropped.add<Health>(a, 99);
+  dropped.clear();
+  world.flush(dropped);
+  CHECK(world.get<Health>(a).hp == 2);
+}
+
+TEST_CASE("Batch create, instantiate and destroy") {
+  ecs_lab::World world;
+  auto& group = world.group<Position, Health>();
+
+  std::vector<ecs_lab::Entity> plain(100);
+  world.create_n(plain.size(), plain);
+  for (std::size_t i = 0; i < plain.size(); ++i) {
+    CHECK(world.is_alive(plain[i]));
+    if (i > 0) {
+      CHECK(plain[i].entity_id > plain[i - 1].entity_id);
+    }
+  }
+
+  std::vector<ecs_lab::Entity> spawned(5000);
+  world.instantiate_n(ecs_lab::make_prefab(Health{5}, Position{1, 2}), spawned.size(), spawned);
+  CHECK(group.size() == 5000);
+  CHECK(world.get<Position>(spawned[4999]).y == 2);
+  CHECK(world.get<Health>(spawned[0]).hp == 5);
+
+  auto keep_proxy = world.get_proxy(spawned[4999]);
+  auto dead_proxy = world.get_proxy(spawned[0]);
+
+  // Every third entity, plus duplicates and a stale handle.
+  std::vector<ecs_lab::Entity> doomed;
+  for (std::size_t i = 0; i < spawned.size(); i += 3) {
+    doomed.push_back(spawned[i]);
+  }
+  doomed.push_back(spawned[0]);
+  doomed.push_back(plain[7]);
+  world.destroy(plain[7]);
+  world.destroy_batch(doomed);
+
+  CHECK(!dead_proxy->is_alive());
+  CHECK(keep_proxy->get<Position>().x == 1);
+  int alive = 0;
+  for (std::size_t i = 0; i < spawned.size(); ++i) {
+    const bool expect_alive = i % 3 != 0;
+    CHECK(world.is_alive(spawned[i]) == expect_alive);
+    if (expect_alive) {
+      ++alive;
+      CHECK(world.get<Health>(spawned[i]).hp == 5);
+    }
+  }
+  int rows = 0;
+  world.query<Position, Health>([&](ecs_lab::Entity e, Position& p, Health&) {
+    CHECK(world.is_alive(e));
+    CHECK(p.x == 1);
+    ++rows;
+  });
+  CHECK(rows == alive);
+  CHECK(group.size() == static_cast<std::size_t>(alive));
+
+  // Freed slots are reused.
+  auto again = world.create();
+  CHECK(again.entity_idx < 5100);
+}
+
+TEST_CASE("Event streams record adds, removals and destroys") {
+  ecs_lab::World world;
+  auto& added = world.on_add<Health>();
+  auto& removed = world.on_remove<Health>();
+  auto& labels = world.on_remove_value<Label>();
+  auto& destroyed = world.on_destroy();
+  CHECK(&world.on_add<Health>(16) == &added);
+  ecs_lab::EventCursor added_cursor;
+  ecs_lab::EventCursor removed_cursor;
+  ecs_lab::EventCursor label_cursor;
+  ecs_lab::EventCursor destroyed_cursor;
+
+  auto a = world.create();
+  auto b = world.create();
+  world.add<Health>(a, 1);
+  world.add<Position>(a, 1, 2);
+  world.add<Label>(b, std::string(64, 'b'));
+  auto c = world.instantiate(ecs_lab::make_prefab(Health{3}, Label{"c"}));
+  auto d = world.create();
+  world.add_missing_components(d, c);
+
+  std::vector<std::uint64_t> seen;
+  CHECK(added.read(added_cursor, [&](const ecs_lab::Entity& e) { seen.push_back(e.entity_id); }) == 3);
+  CHECK(seen == std::vector<std::uint64_t>{a.entity_id, c.entity_id, d.entity_id});
+  CHECK(added.pending(added_cursor) == 0);
+
+  // Unwatched components and missing components emit nothing.
+  world.remove<Position>(a);
+  world.remove<Label>(a);
+  CHECK(removed.pending(removed_cursor) == 0);
+  CHECK(labels.pending(label_cursor) == 0);
+
+  world.remove<Health>(a);
+  world.remove<Label>(b);
+  world.destroy(c);
+  std::vector<ecs_lab::Entity> gone = {d, b};
+  world.destroy_batch(gone);
+
+  seen.clear();
+  removed.read(removed_cursor, [&](const ecs_lab::Entity& e) { seen.push_back(e.entity_id); });
+  CHECK(seen == std::vector<std::uint64_t>{a.entity_id, c.entity_id, d.entity_id});
+  std::vector<std::pair<std::uint64_t, std::string>> values;
+  labels.read(label_cursor, [&](const ecs_lab::Removed<Label>& r) { values.emplace_back(r.entity.entity_id, r.value.text); });
+  REQUIRE(values.size() == 3);
+  CHECK(values[0] == std::make_pair(b.entity_id, std::string(64, 'b')));
+  CHECK(values[1] == std::make_pair(c.entity_id, std::string("c")));
+  CHECK(values[2] == std::make_pair(d.entity_id, std::string("c")));
+  seen.clear();
+  destroyed.read(destroyed_cursor, [&](const ecs_lab::Entity& e) { seen.push_back(e.entity_id); });
+  CHECK(seen == std::vector<std::uint64_t>{c.entity_id, d.entity_id, b.entity_id});
+  CHECK(!world.is_alive(c));
+
+  // A second reader sees the same events; a reader that joins late starts at the head.
+  ecs_lab::EventCursor second;
+  CHECK(destroyed.read(second, [](const ecs_lab::Entity&) {}) == 3);
+  auto late = destroyed.cursor();
+  CHECK(destroyed.read(late, [](const ecs_lab::Entity&) {}) == 0);
+
+  // Snapshots and restores emit nothing.
+  auto e = world.create();
+  world.add<Health>(e, 5);
+  const auto snap = world.snapshot();
+  world.destroy(e);
+  world.restore(snap);
+  CHECK(added.pending(added_cursor) == 1);
+  CHECK(destroyed.pending(destroyed_cursor) == 1);
+
+  // Bounded: a reader that falls behind loses the oldest events and is told how many.
+  ecs_lab::World small;
+  auto& ring = small.on_destroy(3);
+  CHECK(ring.capacity() == 4);
+  std::vector<ecs_lab::Entity> handles(10);
+  small.create_n(handles.size(), handles);
+  small.destroy_batch(handles);
+  ecs_lab::EventCursor behind;
+  seen.clear();
+  CHECK(ring.read(behind, [&](const ecs_lab::Entity& h) { seen.push_back(h.entity_id); }) == 4);
+  CHECK(behind.missed == 6);
+  CHECK(seen == std::vector<std::uint64_t>{7, 8, 9, 10});
+
+  // Readers share nothing, so they can run on several threads at once.
+  std::atomic<std::size_t> total{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&] {
+      ecs_lab::EventCursor mine;
+      std::size_t count = 0;
+      ring.read(mine, [&](const ecs_lab::Entity& h) { count += small.is_alive(h) ? 0 : 1; });
+      total += count;
+    });
+  }
+  for (auto& r : readers) {
+    r.join();
+  }
+  CHECK(total == 16);
+
+  // Slots start empty: value events need no default constructor, and a removed value lives in
+  // the ring until it is overwritten or the stream goes away.
+  static_assert(!std::is_default_constructible_v<ecs_lab::Removed<Ticket>>);
+  auto token = std::make_shared<int>(7);
+  {
+    ecs_lab::World owner;
+    auto& tickets = owner.on_remove_value<Ticket>(2);
+    CHECK(token.use_count() == 1);
+    std::vector<ecs_lab::Entity> holders(3);
+    owner.create_n(holders.size(), holders);
+    for (const auto& h : holders) {
+      owner.add<Ticket>(h, token);
+    }
+    owner.remove<Ticket>(holders[0]);
+    CHECK(token.use_count() == 4);  // two rows, one event
+    owner.destroy_batch(std::span<const ecs_lab::Entity>(holders.data() + 1, 2));
+    CHECK(token.use_count() == 3);  // the oldest event was overwritten
+    ecs_lab::EventCursor cursor;
+    CHECK(tickets.read(cursor, [&](const ecs_lab::Removed<Ticket>& r) { CHECK(*r.value.owner == 7); }) == 2);
+    CHECK(cursor.missed == 1);
+  }
+  CHECK(token.use_count() == 1);
+}
+
+TEST_CASE("Hierarchy links and depth-ordered propagation") {
+  ecs_lab::World world;
+  auto& order = world.hierarchy<Offset>();
+  // Created leaves first, so the pool starts in reverse depth order.
+  auto d = world.create();
+  auto c = world.create();
+  auto b = world.create();
+  auto a = world.create();
+  int local = 1;
+  for (auto e : {a, b, c, d}) {
+    world.add<Offset>(e, local, 0);
+    local *= 10;
+  }
+  CHECK(world.set_parent(b, a));
+  CHECK(world.set_parent(c, a));
+  CHECK(world.set_parent(d, b));
+  CHECK(!world.set_parent(a, a));
+  CHECK(!world.set_parent(a, d));
+  auto dead = world.create();
+  world.destroy(dead);
+  CHECK(!world.set_parent(dead, a));
+
+  CHECK(world.parent_of(d).entity_id == b.entity_id);
+  CHECK(world.parent_of(a).entity_id == 0);
+  std::vector<std::uint64_t> kids;
+  world.each_child(a, [&](ecs_lab::Entity e) { kids.push_back(e.entity_id); });
+  CHECK(kids == std::vector<std::uint64_t>{c.entity_id, b.entity_id});
+  CHECK(world.get<ecs_lab::Relationship>(d).depth() == 2);
+
+  // world = sum of local offsets up to the root; parents are always visited first.
+  auto propagate = [&] {
+    std::vector<const Offset*> visited;
+    order.each([&](Offset& node, const Offset* parent) {
+      if (parent) {
+        CHECK(std::find(visited.begin(), visited.end(), parent) != visited.end());
+      }
+      node.world = node.local + (parent ? parent->world : 0);
+      visited.push_back(&node);
+    });
+  };
+  propagate();
+  CHECK(order.size() == 4);
+  CHECK(world.get<Offset>(a).world == 1);
+  CHECK(world.get<Offset>(b).world == 11);
+  CHECK(world.get<Offset>(c).world == 101);
+  CHECK(world.get<Offset>(d).world == 1011);
+
+  // The new parent's row comes first: only the cached parent row changes.
+  CHECK(world.set_parent(d, c));
+  CHECK(!order.stale);
+  CHECK(!order.needs_sort());
+  propagate();
+  CHECK(world.get<Offset>(d).world == 1101);
+  // The new parent's row comes after the child's: the rows are re-sorted on next use.
+  CHECK(world.set_parent(b, d));
+  CHECK(order.needs_sort());
+  propagate();
+  CHECK(!order.needs_sort());
+  CHECK(world.get<ecs_lab::Relationship>(b).depth() == 3);
+  CHECK(world.get<Offset>(b).world == 1111);
+
+  // Destroying a node turns its children into roots.
+  const auto snap = world.snapshot();
+  world.destroy(d);
+  CHECK(world.parent_of(b).entity_id == 0);
+  CHECK(world.get<ecs_lab::Relationship>(b).depth() == 0);
+  kids.clear();
+  world.each_child(c, [&](ecs_lab::Entity e) { kids.push_back(e.entity_id); });
+  CHECK(kids.empty());
+  propagate();
+  CHECK(world.get<Offset>(b).world == 10);
+
+  // Restore brings the links back and re-sorts.
+  world.restore(snap);
+  propagate();
+  CHECK(world.get<Offset>(b).world == 1111);
+  CHECK(world.parent_of(d).entity_id == c.entity_id);
+
+  // Copies of a Relationship start as roots; removing one unlinks it.
+  auto copy = world.create();
+  world.add_missing_components(copy, d);
+  CHECK(world.parent_of(copy).entity_id == 0);
+  auto spawned = world.instantiate(ecs_lab::make_prefab(ecs_lab::Relationship{}, Offset{5, 0}));
+  CHECK(world.get<ecs_lab::Relationship>(spawned).depth() == 0);
+  world.remove<ecs_lab::Relationship>(d);
+  CHECK(world.parent_of(b).entity_id == 0);
+  kids.clear();
+  world.each_child(c, [&](ecs_lab::Entity e) { kids.push_back(e.entity_id); });
+  CHECK(kids.empty());
+
+  // Random forest under churn, checked against walking the parent links.
+  std::vector<ecs_lab::Entity> nodes;
+  std::uint32_t rng = 12345;
+  auto next = [&] {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  };
+  for (int i = 0; i < 2000; ++i) {
+    auto e = world.create();
+    if (next() % 8 != 0) {
+      world.add<Offset>(e, static_cast<int>(next() % 100), 0);
+    }
+    if (!nodes.empty() && next() % 10 != 0) {
+      world.set_parent(e, nodes[next() % nodes.size()]);
+    }
+    nodes.push_back(e);
+  }
+  for (int i = 0; i < 500; ++i) {
+    auto& e = nodes[next() % nodes.size()];
+    switch (next() % 4) {
+    case 0:
+      world.destroy(e);
+      e = world.create();
+      break;
+    case 1:
+      world.clear_parent(e);
+      break;
+    default:
+      world.set_parent(e, nodes[next() % nodes.size()]);
+      break;
+    }
+    if (i % 50 == 0) {
+      propagate();
+    }
+  }
+  propagate();
+  for (const auto e : nodes) {
+    const auto* node = world.try_get<Offset>(e);
+    if (!node || !world.has<ecs_lab::Relationship>(e)) {
+      continue;
+    }
+    const auto up = world.parent_of(e);
+    const auto* parent = up.entity_id != 0 ? world.try_get<Offset>(up) : nullptr;
+    CHECK(node->world == node->local + (parent ? parent->world : 0));
+    CHECK(world.get<ecs_lab::Relationship>(e).depth() ==
+          (up.entity_id != 0 ? world.get<ecs_lab::Relationship>(up).depth() + 1 : 0));
+  }
+  CHECK(world.verify_pools());
+}
+
+TEST_CASE("sort and sort_like reorder pools and patch their owners") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(3000);
+  world.create_n(es.size(), es);
+  std::uint32_t rng = 777;
+  auto next = [&] {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  };
+  // Added in shuffled order, so no pool follows the arena.
+  std::vector<std::size_t> shuffled(es.size());
+  for (std::size_t i = 0; i < shuffled.size(); ++i) {
+    shuffled[i] = i;
+  }
+  for (std::size_t i = shuffled.size(); i > 1; --i) {
+    std::swap(shuffled[i - 1], shuffled[next() % i]);
+  }
+  for (const std::size_t i : shuffled) {
+    world.add<Health>(es[i], static_cast<int>(next() % 500));
+    world.add<Score>(es[i], static_cast<int>(i));
+    if (i % 3 == 0) {
+      world.add<Target>(es[i], static_cast<int>(i));
+      world.add<Particle>(es[i], Particle{0.0f, 0.0f, static_cast<std::int32_t>(i)});
+    }
+  }
+  auto& group = world.group<Health, Target>();
+  auto proxy = world.get_proxy(es[42]);
+  const int proxied = proxy->get<Health>().hp;
+
+  world.sort<Health>([](const Health& a, const Health& b) { return a.hp < b.hp; });
+  int last = -1;
+  world.each<Health>([&](Health& h) {
+    CHECK(h.hp >= last);
+    last = h.hp;
+  });
+  CHECK(proxy->get<Health>().hp == proxied);
+  std::size_t members = 0;
+  group.each([&](ecs_lab::Entity e, Health& h, Target& t) {
+    CHECK(t.id == static_cast<int>(e.entity_idx));
+    CHECK(&h == world.try_get<Health>(e));
+    ++members;
+  });
+  CHECK(members == 1000);
+
+  // Score and Target follow Particle's order (Particle is SoA; the reference pool can be any kind).
+  world.sort_like<Target, Particle>();
+  world.sort_like<Score, Target>();
+  std::vector<std::uint32_t> particle_owners;
+  world.each_block<Particle>([&](ecs_lab::SoaBlock<Particle> block) {
+    particle_owners.insert(particle_owners.end(), block.entity_idx.begin(), block.entity_idx.end());
+  });
+  std::vector<std::uint32_t> target_owners;
+  world.each<Target>([&](ecs_lab::Entity e, Target&) { target_owners.push_back(e.entity_idx); });
+  CHECK(target_owners == particle_owners);
+  std::size_t row = 0;
+  world.each<Score>([&](ecs_lab::Entity e, Score& sc) {
+    CHECK(sc.value == static_cast<int>(e.entity_idx));
+    if (row < target_owners.size()) {
+      CHECK(e.entity_idx == target_owners[row]);
+    }
+    ++row;
+  });
+  for (const auto e : es) {
+    CHECK(world.get<Score>(e).value == static_cast<int>(e.entity_idx));
+  }
+  CHECK(world.verify_pools());
+
+  // Incremental, one block (4096 rows) per step.
+  std::vector<ecs_lab::Entity> more(6000);
+  world.create_n(more.size(), more);
+  for (const auto e : more) {
+    world.add<Health>(e, static_cast<int>(next() % 500));
+  }
+  auto hps = [&] {
+    std::vector<int> out;
+    world.each<Health>([&](Health& h) { out.push_back(h.hp); });
+    return out;
+  };
+  auto sort = world.begin_sort<Health>([](const Health& a, const Health& b) { return a.hp > b.hp; });
+  CHECK(sort.remaining() == 9000);
+  CHECK(!world.sort_step(sort));
+  CHECK(sort.remaining() == 9000 - 4096);
+  CHECK(!world.sort_step(sort));
+  CHECK(world.sort_step(sort));
+  auto sorted = hps();
+  CHECK(std::is_sorted(sorted.rbegin(), sorted.rend()));
+
+  // Structural changes between steps: rows placed later still come out in order.
+  sort = world.begin_sort<Health>([](const Health& a, const Health& b) { return a.hp < b.hp; });
+  world.sort_step(sort);
+  for (std::size_t i = 0; i < es.size(); i += 7) {
+    world.destroy(es[i]);
+  }
+  while (!world.sort_step(sort)) {
+  }
+  sorted = hps();
+  CHECK(std::is_sorted(sorted.begin() + 4096, sorted.end()));
+  CHECK(world.verify_pools());
+}
+
+TEST_CASE("Handle-stable pool keeps component addresses") {
+  ecs_lab::World world;
+  auto& group = world.group<Node, Health>();
+
+  std::vector<ecs_lab::Entity> es;
+  std::vector<Node*> ptrs;
+  for (int i = 0; i < 10; ++i) {
+    auto e = world.create();
+    world.add<Node>(e, i);
+    if (i % 2 == 0) {
+      world.add<Health>(e, i);
+    }
+    es.push_back(e);
+    ptrs.push_back(&world.get<Node>(e));
+  }
+  auto proxy = world.get_proxy(es[9]);
+  CHECK(group.size() == 5);
+
+  world.destroy(es[2]);
+  world.remove<Node>(es[5]);
+  for (int i = 0; i < 10; ++i) {
+    if (i == 2 || i == 5) {
+      continue;
+    }
+    CHECK(&world.get<Node>(es[i]) == ptrs[i]);
+    CHECK(world.get<Node>(es[i]).value == i);
+  }
+  CHECK(group.size() == 4);
+
+  int count = 0;
+  int sum = 0;
+  world.each<Node>([&](ecs_lab::Entity e, Node& n) {
+    CHECK(world.is_alive(e));
+    ++count;
+    sum += n.value;
+  });
+  CHECK(count == 8);
+  CHECK(sum == 45 - 2 - 5);
+
+  int joined = 0;
+  world.query<Node, Health>([&](ecs_lab::Entity, Node& n, Health& h) {
+    CHECK(n.value == h.hp);
+    ++joined;
+  });
+  CHECK(joined == 4);
+
+  // Holes are reused (most recent first).
+  auto fresh = world.create();
+  world.add<Node>(fresh, 100);
+  CHECK(&world.get<Node>(fresh) == ptrs[5]);
+
+  auto snap = world.snapshot();
+
+  // Open more holes, then close them all; indices, groups and proxies follow the moves.
+  for (int i = 0; i < 8; ++i) {
+    if (i != 2 && i != 5) {
+      world.destroy(es[i]);
+    }
+  }
+  world.compact();
+  CHECK(world.get<Node>(es[8]).value == 8);
+  CHECK(world.get<Node>(es[9]).value == 9);
+  CHECK(world.get<Node>(fresh).value == 100);
+  CHECK(proxy->get<Node>().value == 9);
+  CHECK(group.size() == 1);
+  group.each([&](ecs_lab::Entity e, Node& n, Health&) {
+    CHECK(e.entity_id == es[8].entity_id);
+    CHECK(n.value == 8);
+  });
+  count = 0;
+  world.each<Node>([&](ecs_lab::Entity, Node&) { ++count; });
+  CHECK(count == 3);
+
+  // Compacted rows are dense again; new components append.
+  auto tail = world.create();
+  world.add<Node>(tail, 7);
+  count = 0;
+  world.each<Node>([&](ecs_lab::Entity, Node&) { ++count; });
+  CHECK(count == 4);
+
+  world.restore(snap);
+  CHECK(world.get<Node>(es[0]).value == 0);
+  CHECK(world.get<Node>(fresh).value == 100);
+  CHECK(!world.has<Node>(es[5]));
+  CHECK(group.size() == 4);
+
+  // Many holes spanning several blocks: iteration skips empty blocks.
+  ecs_lab::World big;
+  std::vector<ecs_lab::Entity> many(10000);
+  big.instantiate_n(ecs_lab::make_prefab(Node{1}), many.size(), many);
+  std::vector<ecs_lab::Entity> doomed(many.begin(), many.begin() + 9000);
+  big.destroy_batch(doomed);
+  count = 0;
+  big.each<Node>([&](ecs_lab::Entity, Node& n) { count += n.value; });
+  CHECK(count == 1000);
+  big.compact<Node>();
+  count = 0;
+  big.par_each<Node>([&](ecs_lab::Entity, Node& n) { n.value = 2; });
+  big.each<Node>([&](ecs_lab::Entity, Node& n) { count += n.value; });
+  CHECK(count == 2000);
+  CHECK(big.get<Node>(many[9999]).value == 2);
+}
+
+TEST_CASE("Pools stay consistent with the arena across structural changes") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(3000);
+  world.create_n(es.size(), es);
+  for (std::size_t i = 0; i < es.size(); ++i) {
+    world.add<Position>(es[i], static_cast<int>(i), 0);
+    if (i % 3 == 0) {
+      world.add<Node>(es[i], 1);
+    }
+  }
+  auto snap = world.snapshot();
+  world.destroy_batch(std::span<const ecs_lab::Entity>(es.data(), 1000));
+  world.remove<Node>(es[1500]);
+  CHECK(world.verify_pools());
+  world.compact();
+  CHECK(world.verify_pools());
+
+  // The fn(T&) form never reads the arena.
+  int sum = 0;
+  world.each<Node>([&](Node& n) { sum += n.value; });
+  CHECK(sum == 665);
+  int rows = 0;
+  world.each<Position>([&](ecs_lab::Entity e, Position& p) {
+    CHECK(world.is_alive(e));
+    CHECK(&world.get<Position>(e) == &p);
+    ++rows;
+  });
+  CHECK(rows == 2000);
+
+  world.restore(snap);
+  CHECK(world.verify_pools());
+  sum = 0;
+  world.each<Node>([&](Node& n) { sum += n.value; });
+  CHECK(sum == 1000);
+}
+
+TEST_CASE("Entity metadata columns survive snapshots and deltas") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(5000);
+  world.create_n(es.size(), es);
+  for (std::size_t i = 0; i < es.size(); i += 2) {
+    world.add<Position>(es[i], static_cast<int>(i), 0);
+  }
+  const auto base = world.snapshot();
+
+  // One slot changes in each arena block; the rest stay shared with `base`.
+  world.add<Node>(es[10], 7);
+  world.destroy(es[4500]);
+  const auto reused = world.create();
+  CHECK(reused.entity_idx == es[4500].entity_idx);
+  CHECK(reused.gen != es[4500].gen);
+  const auto delta = world.snapshot_delta(base);
+
+  world.restore(base);
+  CHECK(!world.has<Node>(es[10]));
+  CHECK(world.is_alive(es[4500]));
+  CHECK(!world.is_alive(reused));
+  CHECK(world.get<Position>(es[4500]).x == 4500);
+
+  world.restore_delta(base, delta);
+  CHECK(world.has<Node>(es[10]));
+  CHECK(world.has<Position>(es[10]));
+  CHECK(world.try_get<Node>(es[10])->value == 7);
+  CHECK(!world.is_alive(es[4500]));
+  CHECK(world.is_alive(reused));
+  CHECK(world.try_get<Position>(reused) == nullptr);
+  CHECK(world.try_get_idx_gen<Position>(es[12].entity_idx, es[12].gen)->x == 12);
+  CHECK(world.try_get_idx_gen<Position>(es[13].entity_idx, es[13].gen) == nullptr);
+  CHECK(world.verify_pools());
+}
+
+template <std::size_t... I>
+void add_wide(ecs_lab::World& world, ecs_lab::Entity e, std::index_sequence<I...>) {
+  (world.add<Wide<static_cast<int>(I)>>(e, static_cast<int>(I) * 10), ...);
+}
+
+TEST_CASE("Idx tables spill past their inline slots") {
+  std::pmr::monotonic_buffer_resource resource;
+  ecs_lab::InlineIdxTable<2> t(&resource);
+  t.push_back(1);
+  t.insert(t.begin(), 0);
+  CHECK(t.heap_bytes() == 0);
+  t.insert(t.end(), 3);
+  t.insert(t.begin() + 2, 2);
+  CHECK(t.heap_bytes() > 0);
+  CHECK(t.size() == 4);
+  for (std::size_t i = 0; i < t.size(); ++i) {
+    CHECK(t[i] == i);
+  }
+  t.erase(t.begin());
+  CHECK(t.size() == 3);
+  CHECK(t[0] == 1);
+
+  const ecs_lab::InlineIdxTable<2> copy(t, &resource);
+  CHECK(copy == t);
+  ecs_lab::InlineIdxTable<2> moved(std::move(t));
+  CHECK(moved == copy);
+  CHECK(t.empty());
+  CHECK(t.heap_bytes() == 0);
+
+  // An entity with more components than kIdxInlineSlots.
+  ecs_lab::World world;
+  auto e = world.create();
+  auto other = world.create();
+  world.add<Wide<3>>(other, 1);
+  add_wide(world, e, std::make_index_sequence<ecs_lab::kIdxInlineSlots + 2>{});
+  CHECK(world.get<Wide<0>>(e).value == 0);
+  CHECK(world.get<Wide<9>>(e).value == 90);
+  world.remove<Wide<4>>(e);
+  CHECK(!world.has<Wide<4>>(e));
+  CHECK(world.get<Wide<3>>(e).value == 30);
+  CHECK(world.get<Wide<5>>(e).value == 50);
+  auto snap = world.snapshot();
+  world.destroy(e);
+  world.restore(snap);
+  CHECK(world.get<Wide<9>>(e).value == 90);
+  CHECK(world.get<Wide<3>>(other).value == 1);
+  CHECK(world.verify_pools());
+}
+
+TEST_CASE("Sparse-lookup pools find rows by entity index") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es(6000);
+  world.create_n(es.size(), es);
+  for (std::size_t i = 0; i < es.size(); ++i) {
+    world.add<Position>(es[i], static_cast<int>(i), 0);
+    if (i % 2 == 0) {
+      world.add<Target>(es[i], static_cast<int>(i));
+    }
+  }
+  // Swap-erase moves rows; the index follows them.
+  world.remove<Target>(es[0]);
+  world.remove<Target>(es[2]);
+  world.destroy_batch(std::span<const ecs_lab::Entity>(es.data() + 100, 100));
+  CHECK(world.verify_pools());
+  CHECK(!world.has<Target>(es[0]));
+  CHECK(!world.has<Target>(es[101]));
+  CHECK(world.try_get<Target>(es[100]) == nullptr);
+  CHECK(world.get<Target>(es[5998]).id == 5998);
+  CHECK(world.try_get_idx_gen<Target>(es[4].entity_idx, es[4].gen)->id == 4);
+
+  // A recycled slot is not reachable through the old handle.
+  const auto reused = world.create();
+  const auto stale = std::find_if(es.begin() + 100, es.begin() + 200,
+                                  [&](ecs_lab::Entity e) { return e.entity_idx == reused.entity_idx; });
+  REQUIRE(stale != es.begin() + 200);
+  world.add<Target>(reused, -1);
+  CHECK(world.try_get<Target>(*stale) == nullptr);
+  CHECK(world.get<Target>(reused).id == -1);
+
+  auto snap = world.snapshot();
+  world.remove<Target>(reused);
+  world.get<Target>(es[4]).id = 40;
+  const auto delta = world.snapshot_delta(snap);
+  world.restore(snap);
+  CHECK(world.get<Target>(reused).id == -1);
+  CHECK(world.get<Target>(es[4]).id == 4);
+  world.restore_delta(snap, delta);
+  CHECK(!world.has<Target>(reused));
+  CHECK(world.get<Target>(es[4]).id == 40);
+  CHECK(world.verify_pools());
+
+  // A handle from a timeline abandoned by restore can match a live (entity_idx, gen) under a
+  // different entity_id; it must not reach that entity's component.
+  {
+    ecs_lab::World branch;
+    const auto base = branch.snapshot();
+    branch.create();
+    const auto abandoned = branch.create();
+    branch.restore(base);
+    branch.destroy(branch.create());
+    branch.create();
+    const auto current = branch.create();
+    REQUIRE(current.entity_idx == abandoned.entity_idx);
+    REQUIRE(current.gen == abandoned.gen);
+    REQUIRE(current.entity_id != abandoned.entity_id);
+    branch.add<Target>(current, 7);
+    CHECK(!branch.is_alive(abandoned));
+    CHECK(!branch.has<Target>(abandoned));
+    CHECK(branch.try_get<Target>(abandoned) == nullptr);
+    CHECK(branch.try_get_component<Target>(abandoned) == nullptr);
+    CHECK(std::as_const(branch).try_get<Target>(abandoned) == nullptr);
+    CHECK(branch.has<Target>(current));
+  }
+
+  // Loading rebuilds the index from the rows.
+  ecs_lab::register_component<Position>("test.position");
+  ecs_lab::register_component<Target>("test.target");
+  std::stringstream stream;
+  REQUIRE(ecs_lab::save_snapshot(world.snapshot(), stream));
+  ecs_lab::World::Snapshot loaded;
+  REQUIRE(ecs_lab::load_snapshot(stream, loaded));
+  ecs_lab::World copy;
+  copy.restore(loaded);
+  CHECK(copy.verify_pools());
+  CHECK(copy.get<Target>(es[5998]).id == 5998);
+  CHECK(!copy.has<Target>(es[2]));
+}
+
+TEST_CASE("each_chunk hands out whole pool blocks") {
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es;
+  for (int i = 0; i < 10000; ++i) {
+    auto e = world.create();
+    world.add<Position>(e, i, 0);
+    if (i < 5000) {
+      world.add<Node>(e, 1);
+    }
+    es.push_back(e);
+  }
+  world.destroy(es[3]);
+  // Empty the first Node block; its tombstones are skipped whole.
+  for (int i = 0; i < 4096; ++i) {
+    world.remove<Node>(es[i]);
+  }
+
+  auto snap = world.snapshot();
+
+  std::size_t chunks = 0;
+  std::size_t rows = 0;
+  world.each_chunk<Position>([&](std::span<ecs_lab::Component<Position>> chunk) {
+    ++chunks;
+    rows += chunk.size();
+    for (auto& row : chunk) {
+      row.data.y = row.data.x * 2;
+    }
+  });
+  CHECK(chunks == 3);
+  CHECK(rows == 9999);
+  for (int i = 0; i < 10000; ++i) {
+    if (i != 3) {
+      CHECK(world.get<Position>(es[i]).y == i * 2);
+    }
+  }
+
+  int live = 0;
+  chunks = 0;
+  world.each_chunk<Node>([&](std::span<ecs_lab::Component<Node>> chunk) {
+    ++chunks;
+    for (const auto& row : chunk) {
+      if (row.gen != 0) {
+        live += row.data.value;
+        const auto owner = world.resolve_idx_gen(row.entity_idx, row.gen);
+        REQUIRE(world.is_alive(owner));
+        CHECK(&world.get<Node>(owner) == &row.data);
+      }
+    }
+  });
+  CHECK(chunks == 1);
+  CHECK(live == 5000 - 4096);
+
+  // Writes through a chunk copied the shared blocks; the snapshot still has the old rows.
+  world.restore(snap);
+  CHECK(world.get<Position>(es[9999]).y == 0);
+}
+
+TEST_CASE("SoA pools store fields in columns") {
+  ecs_lab::register_component<Particle>("test.particle");
+
+  ecs_lab::World world;
+  std::vector<ecs_lab::Entity> es;
+  for (int i = 0; i < 5000; ++i) {
+    auto e = world.create();
+    world.add<Particle>(e, static_cast<float>(i), 1.0f, i);
+    if (i % 2 == 0) {
+      world.add<Position>(e, i, i);
+    }
+    es.push_back(e);
+  }
+  CHECK(world.get<Particle>(es[42]).load().id == 42);
+  world.get<Particle>(es[42]).field<&Particle::vx>() = 2.0f;
+  world.get<Particle>(es[43]) = Particle{-1.0f, 0.0f, 43};
+  CHECK(world.add<Particle>(es[43]).field<&Particle::x>() == -1.0f);
+
+  // Swap-erase moves every column of the last row.
+  world.destroy(es[0]);
+  world.remove<Particle>(es[1]);
+  CHECK(!world.has<Particle>(es[1]));
+  CHECK(world.get<Particle>(es[4999]).load().x == 4999.0f);
+  CHECK(world.get<Particle>(es[4998]).load().id == 4998);
+
+  auto snap = world.snapshot();
+
+  std::size_t rows = 0;
+  world.each_block<Particle>([&](ecs_lab::SoaBlock<Particle> block) {
+    auto x = block.field<&Particle::x>();
+    const auto vx = block.field<&Particle::vx>();
+    const auto id = block.field<&Particle::id>();
+    for (std::size_t i = 0; i < block.size(); ++i) {
+      x[i] += vx[i];
+      CHECK(block.entity_idx[i] == es[static_cast<std::size_t>(id[i])].entity_idx);
+    }
+    rows += block.size();
+  });
+  CHECK(rows == 4998);
+  CHECK(world.get<Particle>(es[42]).load().x == 44.0f);
+  CHECK(world.get<Particle>(es[100]).load().x == 101.0f);
+
+  std::stringstream stream;
+  REQUIRE(ecs_lab::save_snapshot(world.snapshot(), stream));
+  ecs_lab::World::Snapshot loaded;
+  REQUIRE(ecs_lab::load_snapshot(stream, loaded));
+
+  // The snapshot kept the pre-integration columns.
+  world.restore(snap);
+  CHECK(world.get<Particle>(es[42]).load().x == 42.0f);
+  CHECK(world.get<Particle>(es[43]).load().x == -1.0f);
+
+  world.restore(loaded);
+  CHECK(world.get<Particle>(es[42]).load().x == 44.0f);
+  CHECK(world.get<Particle>(es[2000]).load().id == 2000);
+  CHECK(world.get<Position>(es[2000]).x == 2000);
+
+  auto copy = world.create();
+  world.add_missing_components(copy, es[7]);
+  CHECK(world.get<Particle>(copy).load().id == 7);
+}